@@ -28,4 +28,8 @@ macro(rg_setup_compile_options)
     if($ENV{ENABLE_NETPLAY})
         component_compile_options(-DENABLE_NETPLAY)
     endif()
+
+    if($ENV{ENABLE_DEBUG_LOG})
+        component_compile_options(-DRG_LOG_LEVEL_MAX=RG_LOG_DEBUG)
+    endif()
 endmacro()
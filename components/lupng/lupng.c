@@ -174,6 +174,7 @@ typedef struct
     uint8_t *previousScanline;
     uint8_t currentFilter;
     uint8_t interlacePass;
+    uint8_t aborted;
 
     /* used for constructing 16 bit deep pixels */
     int32_t tmpCount;
@@ -471,7 +472,13 @@ static LU_INLINE int parseIhdr(PngInfoStruct *info, PngChunk *chunk)
         return PNG_ERROR;
     }
 
-    info->img = luImageCreate(info->width, info->height,
+    if (info->userCtx->rowProc && info->interlace)
+    {
+        LUPNG_WARN(info, "interlaced images can't be streamed!");
+        return PNG_ERROR;
+    }
+
+    info->img = luImageCreate(info->width, info->userCtx->rowProc ? 1 : info->height,
                               info->channels, info->depth < 16 ? 8 : 16, NULL, info->userCtx);
     info->bytesPerPixel = MAX((info->channels * info->depth) >> 3, 1);
     info->scanlineBytes = info->width * info->bytesPerPixel;
@@ -555,7 +562,8 @@ static LU_INLINE int insertByte(PngInfoStruct *info, uint8_t byte)
     int advance = 0;
 
     /* for paletted images currentElem will always be 0 */
-    size_t idx = info->currentRow * info->width * info->channels
+    /* when streaming, the image only holds the current row */
+    size_t idx = (info->userCtx->rowProc ? 0 : info->currentRow) * info->width * info->channels
                     + info->currentCol * info->channels
                     + info->currentElem;
 
@@ -615,6 +623,10 @@ static LU_INLINE int insertByte(PngInfoStruct *info, uint8_t byte)
 
         if (info->currentCol >= info->width)
         {
+            if (info->userCtx->rowProc && info->userCtx->rowProc(info->cimg,
+                    info->currentRow, info->height, info->userCtx->rowProcUserPtr))
+                info->aborted = 1;
+
             uint8_t *tmp = info->currentScanline;
             info->currentScanline = info->previousScanline;
             info->previousScanline = tmp;
@@ -676,7 +688,8 @@ static LU_INLINE int parseIdat(PngInfoStruct *info, PngChunk *chunk)
         }
 
         for (i = 0;
-            i < decompressed && info->currentCol < info->width && info->currentRow < info->height;
+            i < decompressed && info->currentCol < info->width && info->currentRow < info->height
+                && !info->aborted;
             ++i)
         {
             if (info->currentCol < 0)
@@ -722,7 +735,14 @@ static LU_INLINE int parseIdat(PngInfoStruct *info, PngChunk *chunk)
             }
         }
     } while ((info->stream.avail_in > 0 || info->stream.avail_out == 0)
-            && info->currentCol < info->width && info->currentRow < info->height);
+            && info->currentCol < info->width && info->currentRow < info->height
+            && !info->aborted);
+
+    if (info->aborted)
+    {
+        LUPNG_WARN(info, "decoding aborted by rowProc");
+        return PNG_ERROR;
+    }
 
     return PNG_OK;
 }
@@ -1027,6 +1047,7 @@ static LU_INLINE int processPixels(PngInfoStruct *info)
     uint8_t *bestCandidate = (uint8_t *)info->userCtx->allocProc(info->scanlineBytes+1, info->userCtx->allocProcUserPtr);
     int status = MZ_OK;
     int is16bit = info->cimg->depth == 16;
+    int filterMask = info->userCtx->filterMask ? info->userCtx->filterMask : PNG_FILTER_MASK_ALL;
 
     if (!filterCandidate || !bestCandidate)
     {
@@ -1084,6 +1105,9 @@ static LU_INLINE int processPixels(PngInfoStruct *info)
             {
                 size_t curSum = 0, fc = 0;
 
+                if (!(filterMask & (1 << info->currentFilter)))
+                    continue;
+
                 filterCandidate[fc++] = info->currentFilter;
 
                 for (info->currentByte = 0; info->currentByte < info->scanlineBytes;)
@@ -1110,7 +1134,17 @@ static LU_INLINE int processPixels(PngInfoStruct *info)
                     }
 
                     filterCandidate[fc++] = val;
-                    curSum += val;
+                    curSum += absi((int8_t)val); /* small differences, either sign, compress best */
+
+                    if (is16bit)
+                    {
+                        if (info->currentByte%2)
+                            --info->currentByte;
+                        else
+                            info->currentByte+=3;
+                    }
+                    else
+                        ++info->currentByte;
                 }
 
                 if (curSum < minSum)
@@ -1120,16 +1154,6 @@ static LU_INLINE int processPixels(PngInfoStruct *info)
                     filterCandidate = tmp;
                     minSum = curSum;
                 }
-
-                if (is16bit)
-                {
-                    if (info->currentByte%2)
-                        --info->currentByte;
-                    else
-                        info->currentByte+=3;
-                }
-                else
-                    ++info->currentByte;
             }
 
             info->stream.avail_in = (unsigned int)info->scanlineBytes+1;
@@ -1192,7 +1216,7 @@ int luPngWriteUC(const LuUserContext *userCtx, const LuImage *img)
     }
 
     // Try using a palette if possible
-    if (img->channels == 3 && img->depth == 8)
+    if (img->channels == 3 && img->depth == 8 && userCtx->buildPalette)
         buildPalette(info);
 
     if ((status = writeHeader(info)) != PNG_OK)
@@ -1355,6 +1379,8 @@ void luUserContextInitDefault(LuUserContext *userCtx)
     userCtx->writeProc=NULL;
     userCtx->writeProcUserPtr=NULL;
     userCtx->compressionLevel=MZ_DEFAULT_COMPRESSION;
+    userCtx->filterMask=PNG_FILTER_MASK_ALL;
+    userCtx->buildPalette=1;
 
     userCtx->allocProc=internalMalloc;
     userCtx->allocProcUserPtr=NULL;
@@ -1365,4 +1391,7 @@ void luUserContextInitDefault(LuUserContext *userCtx)
     userCtx->warnProcUserPtr=(void*)stderr;
 
     userCtx->overrideImage=NULL;
+
+    userCtx->rowProc=NULL;
+    userCtx->rowProcUserPtr=NULL;
 }
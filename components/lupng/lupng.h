@@ -57,11 +57,22 @@ typedef enum {
     PNG_ERROR = -1,
 } LuPngErr;
 
+/* filters tried on every scanline by the writer */
+typedef enum {
+    PNG_FILTER_MASK_NONE = 0x01,
+    PNG_FILTER_MASK_SUB = 0x02,
+    PNG_FILTER_MASK_UP = 0x04,
+    PNG_FILTER_MASK_AVERAGE = 0x08,
+    PNG_FILTER_MASK_PAETH = 0x10,
+    PNG_FILTER_MASK_ALL = 0x1F,
+} LuPngFilterMask;
+
 typedef size_t (*PngReadProc)(void *outPtr, size_t size, size_t count, void *userPtr);
 typedef size_t (*PngWriteProc)(const void *inPtr, size_t size, size_t count, void *userPtr);
 typedef void*  (*PngAllocProc)(size_t size, void *userPtr);
 typedef void   (*PngFreeProc)(void *ptr, void *userPtr);
 typedef void   (*PngWarnProc)(void *userPtr, const char *fmt, ...);
+typedef int    (*PngRowProc)(const LuImage *row, int32_t y, int32_t height, void *userPtr);
 
 typedef struct {
     /* loader */
@@ -73,6 +84,8 @@ typedef struct {
     PngWriteProc writeProc;
     void *writeProcUserPtr;
     int compressionLevel;
+    int filterMask; /* LuPngFilterMask */
+    int buildPalette; /* try to store RGB images with a palette, this is slow */
 
     /* memory allocation */
     PngAllocProc allocProc;
@@ -87,6 +100,12 @@ typedef struct {
     /* special case: avoid allocating a LuImage when loading or creating
      * an image, just use this one */
     LuImage *overrideImage;
+
+    /* streaming loader: when set, the LuImage only holds one scanline and
+     * rowProc is called every time it is complete. Returning non-zero
+     * aborts the decoding. Interlaced images are not supported. */
+    PngRowProc rowProc;
+    void *rowProcUserPtr;
 } LuUserContext;
 
 /**
@@ -134,6 +134,8 @@ void rg_audio_submit(short *stereoAudioBuffer, size_t frameCount)
         return;
     }
 
+    rg_golden_audio(stereoAudioBuffer, sampleCount);
+
     if (audioFilter)
     {
         filter_samples(stereoAudioBuffer, bufferSize);
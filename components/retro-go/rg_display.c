@@ -29,6 +29,16 @@ static QueueHandle_t spi_buffers_queue;
 static QueueHandle_t spi_queue;
 static QueueHandle_t video_task_queue;
 
+// Frames are captured on the caller's task but encoded and written by save_frame_task
+typedef struct
+{
+    char *filename;
+    rg_image_t *img;
+} save_frame_job_t;
+
+static QueueHandle_t save_frame_queue;
+static SemaphoreHandle_t save_frame_slot; // Taken while a frame is in flight
+
 static rg_display_t display;
 
 static const char *SETTING_BACKLIGHT = "Backlight";
@@ -867,6 +877,50 @@ display_backlight_t rg_display_get_backlight(void)
     return display.config.backlight;
 }
 
+static bool save_frame_write(const char *filename, rg_image_t *img)
+{
+    bool status = rg_image_save_to_file(filename, img, RG_IMAGE_SAVE_FAST);
+
+    if (!status)
+        RG_LOGE("rg_image_save_to_file() failed for '%s'!\n", filename);
+
+    return status;
+}
+
+static void save_frame_task(void *arg)
+{
+    save_frame_job_t job;
+
+    while (xQueueReceive(save_frame_queue, &job, portMAX_DELAY) == pdTRUE)
+    {
+        int64_t start = esp_timer_get_time();
+
+        if (save_frame_write(job.filename, job.img))
+            RG_LOGI("Saved '%s' in %dms.\n", job.filename, (int)((esp_timer_get_time() - start) / 1000));
+
+        rg_image_free(job.img);
+        free(job.filename);
+        xSemaphoreGive(save_frame_slot);
+    }
+
+    vTaskDelete(NULL);
+}
+
+bool rg_display_wait_saved_frames(int timeout_ms)
+{
+    if (!save_frame_slot)
+        return true;
+
+    if (xSemaphoreTake(save_frame_slot, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+    {
+        RG_LOGW("Timed out waiting for frames to be saved!\n");
+        return false;
+    }
+
+    xSemaphoreGive(save_frame_slot);
+    return true;
+}
+
 bool rg_display_save_frame(const char *filename, rg_video_frame_t *frame, int width, int height)
 {
     if (width <= 0 && height <= 0)
@@ -914,11 +968,29 @@ bool rg_display_save_frame(const char *filename, rg_video_frame_t *frame, int wi
         }
     }
 
-    bool status = rg_image_save_to_file(filename, img, 0);
-    rg_image_free(img);
+    if (!save_frame_queue)
+    {
+        save_frame_slot = xSemaphoreCreateBinary();
+        save_frame_queue = xQueueCreate(1, sizeof(save_frame_job_t));
+        xSemaphoreGive(save_frame_slot);
+        // Same core as the display tasks but lower priority, the emulator can resume right away
+        xTaskCreatePinnedToCore(&save_frame_task, "save_frame", 4096, NULL, 1, NULL, 1);
+    }
 
-    if (!status)
-        RG_LOGE("rg_image_write_file() failed!\n");
+    // The copy above is all we need from the frame, the encoding happens in the background.
+    // Only one frame is in flight at a time to bound memory use.
+    save_frame_job_t job = {strdup(filename), img};
+
+    if (job.filename && xSemaphoreTake(save_frame_slot, pdMS_TO_TICKS(5000)) == pdTRUE)
+    {
+        if (xQueueSend(save_frame_queue, &job, 0) == pdTRUE)
+            return true;
+        xSemaphoreGive(save_frame_slot);
+    }
+
+    bool status = save_frame_write(filename, img);
+    rg_image_free(img);
+    free(job.filename);
 
     return status;
 }
@@ -931,6 +1003,8 @@ rg_update_t rg_display_queue_update(rg_video_frame_t *frame, rg_video_frame_t *p
     if (!frame)
         return RG_UPDATE_ERROR;
 
+    rg_golden_video(frame);
+
     if (frame->width != display.source.width || frame->height != display.source.height)
     {
         display.changed = true;
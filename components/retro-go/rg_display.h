@@ -117,6 +117,7 @@ void rg_display_clear(uint16_t colorLE);
 void rg_display_load_config(void);
 void rg_display_show_info(const char *text, int timeout_ms);
 bool rg_display_save_frame(const char *filename, rg_video_frame_t *frame, int width, int height);
+bool rg_display_wait_saved_frames(int timeout_ms);
 rg_update_t rg_display_queue_update(rg_video_frame_t *frame, rg_video_frame_t *previousFrame);
 const rg_display_t *rg_display_get_status(void);
 
@@ -0,0 +1,400 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+
+#include "rg_system.h"
+#include "rg_golden.h"
+
+// Golden-output regression runs.
+//
+// A run is started when an input script exists for the loaded ROM. The script drives the gamepad
+// frame by frame, and every video frame and audio block produced by the core is hashed with crc32.
+// The first run records the hashes to the golden file, subsequent runs compare against it and
+// report the first divergent frame. Only frames rendered in both runs are compared, because
+// frame skipping depends on timing.
+//
+// Script format, one step per line, the keys are held until the next step:
+//   # comment
+//   0     -
+//   120   START
+//   130   A+RIGHT
+//   3600  END
+
+#define GOLDEN_MAGIC       0x444C4F47 // "GOLD"
+#define GOLDEN_VERSION     1
+#define GOLDEN_MAX_STEPS   1024
+#define GOLDEN_MAX_RECORDS (60 * 60 * 5) // 5 minutes at 60Hz
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frames;
+    uint32_t blocks;
+} golden_header_t;
+
+typedef struct
+{
+    uint32_t tick;
+    uint32_t crc;
+} golden_frame_t;
+
+typedef struct
+{
+    uint32_t tick;
+    gamepad_state_t state;
+} golden_step_t;
+
+static const struct {const char *name; gamepad_state_t key;} key_names[] = {
+    {"UP", GAMEPAD_KEY_UP},
+    {"RIGHT", GAMEPAD_KEY_RIGHT},
+    {"DOWN", GAMEPAD_KEY_DOWN},
+    {"LEFT", GAMEPAD_KEY_LEFT},
+    {"SELECT", GAMEPAD_KEY_SELECT},
+    {"START", GAMEPAD_KEY_START},
+    {"A", GAMEPAD_KEY_A},
+    {"B", GAMEPAD_KEY_B},
+};
+static const size_t key_names_count = sizeof(key_names) / sizeof(key_names[0]);
+
+static rg_golden_status_t status = {.mode = RG_GOLDEN_OFF, .firstBadFrame = -1, .firstBadBlock = -1};
+static golden_step_t *steps;
+static size_t steps_count, steps_pos;
+static uint32_t end_tick;
+static golden_frame_t *frames;      // Recorded frames (RECORD) or golden frames (VERIFY)
+static uint32_t *blocks;            // Recorded blocks (RECORD) or golden blocks (VERIFY)
+static size_t frames_count, blocks_count, frames_pos;
+static char *golden_path;
+static volatile bool report_pending; // Set by rg_golden_finish, see rg_golden_report
+
+
+static bool parse_keys(char *str, gamepad_state_t *out)
+{
+    gamepad_state_t state = 0;
+
+    for (char *token = strtok(str, "+|, \t\r\n"); token; token = strtok(NULL, "+|, \t\r\n"))
+    {
+        if (strcmp(token, "-") == 0)
+            continue;
+
+        if (isdigit((int)token[0]))
+        {
+            state |= strtoul(token, NULL, 0);
+            continue;
+        }
+
+        size_t i = 0;
+        while (i < key_names_count && strcasecmp(token, key_names[i].name) != 0)
+            i++;
+
+        if (i == key_names_count)
+            return false;
+
+        state |= key_names[i].key;
+    }
+
+    *out = state;
+    return true;
+}
+
+static bool load_script(const char *filename)
+{
+    char line[128];
+    int lineno = 0;
+
+    FILE *fp = fopen(filename, "r");
+    if (!fp)
+        return false;
+
+    steps = rg_alloc(GOLDEN_MAX_STEPS * sizeof(golden_step_t), MEM_SLOW);
+    steps_count = steps_pos = 0;
+    end_tick = 0;
+
+    while (fgets(line, sizeof(line), fp) && steps_count < GOLDEN_MAX_STEPS)
+    {
+        char *keys = line;
+        lineno++;
+
+        while (isspace((int)*keys))
+            keys++;
+
+        if (*keys == '#' || *keys == 0)
+            continue;
+
+        uint32_t tick = strtoul(keys, &keys, 10);
+
+        if (strncasecmp(keys + strspn(keys, " \t"), "END", 3) == 0)
+        {
+            end_tick = tick;
+            break;
+        }
+
+        if (!parse_keys(keys, &steps[steps_count].state))
+        {
+            RG_LOGE("Syntax error at line %d of '%s'\n", lineno, filename);
+            fclose(fp);
+            return false;
+        }
+
+        steps[steps_count++].tick = tick;
+    }
+
+    fclose(fp);
+
+    if (end_tick == 0)
+    {
+        end_tick = GOLDEN_MAX_RECORDS;
+        RG_LOGW("Script has no END step, stopping after %d frames.\n", end_tick);
+    }
+
+    RG_LOGI("Loaded %d steps from '%s'.\n", steps_count, filename);
+
+    return true;
+}
+
+static bool load_golden(const char *filename)
+{
+    golden_header_t header;
+    bool success = false;
+
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return false;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1
+        || header.magic != GOLDEN_MAGIC || header.version != GOLDEN_VERSION
+        || header.frames > GOLDEN_MAX_RECORDS || header.blocks > GOLDEN_MAX_RECORDS)
+    {
+        RG_LOGE("Invalid golden file '%s'.\n", filename);
+    }
+    else if (fread(frames, sizeof(golden_frame_t), header.frames, fp) != header.frames
+        || fread(blocks, sizeof(uint32_t), header.blocks, fp) != header.blocks)
+    {
+        RG_LOGE("Golden file '%s' is truncated.\n", filename);
+    }
+    else
+    {
+        frames_count = header.frames;
+        blocks_count = header.blocks;
+        success = true;
+    }
+
+    fclose(fp);
+
+    return success;
+}
+
+static bool save_golden(const char *filename)
+{
+    golden_header_t header = {GOLDEN_MAGIC, GOLDEN_VERSION, frames_count, blocks_count};
+    bool success = false;
+
+    rg_mkdir(rg_dirname(filename));
+
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
+        return false;
+
+    success = fwrite(&header, sizeof(header), 1, fp)
+        && fwrite(frames, sizeof(golden_frame_t), frames_count, fp) == frames_count
+        && fwrite(blocks, sizeof(uint32_t), blocks_count, fp) == blocks_count;
+
+    fclose(fp);
+
+    return success;
+}
+
+static void report_mismatch(const char *type, uint32_t index, uint32_t crc, uint32_t expected)
+{
+    if (status.mismatches++ == 0)
+    {
+        RG_LOGW("First divergence: %s %d (crc %08X, expected %08X)\n", type, index, crc, expected);
+    }
+}
+
+bool rg_golden_init(const char *romPath)
+{
+    char *script_path = rg_emu_get_path(RG_PATH_GOLDEN_SCRIPT, romPath);
+
+    golden_path = rg_emu_get_path(RG_PATH_GOLDEN_DATA, romPath);
+
+    if (!load_script(script_path))
+    {
+        free(script_path);
+        free(golden_path);
+        free(steps);
+        golden_path = NULL;
+        steps = NULL;
+        return false;
+    }
+
+    frames = rg_alloc(GOLDEN_MAX_RECORDS * sizeof(golden_frame_t), MEM_SLOW);
+    blocks = rg_alloc(GOLDEN_MAX_RECORDS * sizeof(uint32_t), MEM_SLOW);
+    frames_count = blocks_count = frames_pos = 0;
+
+    status = (rg_golden_status_t){
+        .mode = load_golden(golden_path) ? RG_GOLDEN_VERIFY : RG_GOLDEN_RECORD,
+        .firstBadFrame = -1,
+        .firstBadBlock = -1,
+    };
+
+    RG_LOGI("Golden run started. mode=%s, script='%s'\n",
+        status.mode == RG_GOLDEN_VERIFY ? "verify" : "record", script_path);
+
+    free(script_path);
+
+    return true;
+}
+
+// Only flags the run as done: we may be called from an input read in the middle of an emulated
+// instruction, the results are written and shown later by rg_golden_report.
+IRAM_ATTR void rg_golden_finish(void)
+{
+    if (status.mode == RG_GOLDEN_OFF || status.finished)
+        return;
+
+    status.finished = true;
+    report_pending = true;
+}
+
+// Called between frames by rg_system_tick
+void rg_golden_report(void)
+{
+    char message[128];
+
+    if (!report_pending)
+        return;
+
+    report_pending = false;
+
+    if (status.mode == RG_GOLDEN_RECORD)
+    {
+        if (status.ticks < end_tick)
+            snprintf(message, sizeof(message), "Run aborted at frame %d.\nNothing recorded.", status.ticks);
+        else if (save_golden(golden_path))
+            snprintf(message, sizeof(message), "Recorded %d frames and %d audio blocks.", frames_count, blocks_count);
+        else
+            snprintf(message, sizeof(message), "Failed to write golden file!");
+    }
+    else if (status.mismatches == 0)
+    {
+        snprintf(message, sizeof(message), "PASS\n%d frames compared.", status.compared);
+    }
+    else
+    {
+        snprintf(message, sizeof(message), "FAIL\nFirst bad frame: %d\nFirst bad audio block: %d\nMismatches: %d/%d",
+            status.firstBadFrame, status.firstBadBlock, status.mismatches, status.compared);
+    }
+
+    RG_LOGI("Golden run finished at frame %d: %s\n", status.ticks, message);
+
+    rg_gui_alert("Golden run", message);
+}
+
+IRAM_ATTR void rg_golden_tick(void)
+{
+    if (status.mode == RG_GOLDEN_OFF || status.finished)
+        return;
+
+    if (++status.ticks >= end_tick)
+        rg_golden_finish();
+}
+
+IRAM_ATTR void rg_golden_video(const rg_video_frame_t *frame)
+{
+    if (status.mode == RG_GOLDEN_OFF || status.finished)
+        return;
+
+    size_t line_width = frame->width * ((frame->flags & RG_PIXEL_PAL) ? 1 : 2);
+    uint32_t crc = 0;
+
+    for (size_t y = 0; y < frame->height; ++y)
+    {
+        crc = crc32_le(crc, (uint8_t *)frame->buffer + y * frame->stride, line_width);
+    }
+
+    if ((frame->flags & RG_PIXEL_PAL) && frame->palette)
+    {
+        crc = crc32_le(crc, frame->palette, (frame->pixel_mask + 1) * 2);
+    }
+
+    if (status.mode == RG_GOLDEN_RECORD)
+    {
+        if (frames_count < GOLDEN_MAX_RECORDS)
+            frames[frames_count++] = (golden_frame_t){status.ticks, crc};
+    }
+    else
+    {
+        // Frames are sorted by tick, skip the ones we didn't render this time around
+        while (frames_pos < frames_count && frames[frames_pos].tick < status.ticks)
+            frames_pos++;
+
+        if (frames_pos < frames_count && frames[frames_pos].tick == status.ticks)
+        {
+            if (frames[frames_pos].crc != crc)
+            {
+                if (status.firstBadFrame < 0)
+                    status.firstBadFrame = status.ticks;
+                report_mismatch("frame", status.ticks, crc, frames[frames_pos].crc);
+            }
+            status.compared++;
+        }
+    }
+
+    status.frames++;
+}
+
+IRAM_ATTR void rg_golden_audio(const int16_t *samples, size_t count)
+{
+    if (status.mode == RG_GOLDEN_OFF || status.finished)
+        return;
+
+    uint32_t crc = crc32_le(0, (const uint8_t *)samples, count * sizeof(int16_t));
+
+    if (status.mode == RG_GOLDEN_RECORD)
+    {
+        if (blocks_count < GOLDEN_MAX_RECORDS)
+            blocks[blocks_count++] = crc;
+    }
+    else if (status.blocks < blocks_count)
+    {
+        if (blocks[status.blocks] != crc)
+        {
+            if (status.firstBadBlock < 0)
+                status.firstBadBlock = status.blocks;
+            report_mismatch("audio block", status.blocks, crc, blocks[status.blocks]);
+        }
+        status.compared++;
+    }
+
+    status.blocks++;
+}
+
+IRAM_ATTR bool rg_golden_input(gamepad_state_t *state)
+{
+    if (status.mode == RG_GOLDEN_OFF || status.finished)
+        return false;
+
+    // The menu key aborts the run and gives control back to the user
+    if (*state & GAMEPAD_KEY_MENU)
+    {
+        rg_golden_finish();
+        return false;
+    }
+
+    while (steps_pos + 1 < steps_count && steps[steps_pos + 1].tick <= status.ticks)
+        steps_pos++;
+
+    if (steps_count > 0 && steps[steps_pos].tick <= status.ticks)
+        *state = steps[steps_pos].state;
+    else
+        *state = 0;
+
+    return true;
+}
+
+rg_golden_status_t rg_golden_get_status(void)
+{
+    return status;
+}
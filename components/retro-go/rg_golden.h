@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rg_display.h"
+#include "rg_input.h"
+
+typedef enum
+{
+    RG_GOLDEN_OFF = 0,
+    RG_GOLDEN_RECORD,   // No golden file yet, it will be written when the script ends
+    RG_GOLDEN_VERIFY,   // Every frame and audio block is compared against the golden file
+} rg_golden_mode_t;
+
+typedef struct
+{
+    rg_golden_mode_t mode;
+    uint32_t ticks;         // Emulated frames since the start of the script
+    uint32_t frames;        // Video frames hashed
+    uint32_t blocks;        // Audio blocks hashed
+    uint32_t compared;      // Frames/blocks that had a golden counterpart
+    uint32_t mismatches;
+    int32_t firstBadFrame;  // Tick of the first divergent video frame, -1 if none
+    int32_t firstBadBlock;  // Index of the first divergent audio block, -1 if none
+    bool finished;
+} rg_golden_status_t;
+
+bool rg_golden_init(const char *romPath);
+void rg_golden_finish(void);
+void rg_golden_report(void);
+void rg_golden_tick(void);
+void rg_golden_video(const rg_video_frame_t *frame);
+void rg_golden_audio(const int16_t *samples, size_t count);
+bool rg_golden_input(gamepad_state_t *state);
+rg_golden_status_t rg_golden_get_status(void);
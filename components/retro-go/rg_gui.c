@@ -14,6 +14,23 @@
 
 static uint16_t *overlay_buffer = NULL;
 
+// Compose surface: while composing, drawing primitives write to a screen-sized canvas instead of
+// the display and only the pixels that differ from what the canvas last sent are flushed. Every
+// row tracks the span that changed since the last flush (dirty) and the span known to match the
+// panel (valid). Spans are inclusive, empty when right < left.
+typedef struct
+{
+    int16_t left, right;
+} span_t;
+
+static struct
+{
+    uint16_t *buffer;
+    span_t dirty[RG_SCREEN_HEIGHT];
+    span_t valid[RG_SCREEN_HEIGHT];
+    int depth;
+} surface;
+
 static const dialog_theme_t default_theme = {
     .box_background = C_NAVY,
     .box_header = C_WHITE,
@@ -37,6 +54,197 @@ void rg_gui_init(void)
     rg_gui_set_theme(&default_theme);
 }
 
+static inline bool span_empty(span_t span)
+{
+    return span.right < span.left;
+}
+
+static inline span_t span_merge(span_t a, span_t b)
+{
+    // The union is only usable if it is contiguous, otherwise keep the first span
+    if (span_empty(a))
+        return b;
+    if (span_empty(b) || b.left > a.right + 1 || b.right < a.left - 1)
+        return a;
+    return (span_t){RG_MIN(a.left, b.left), RG_MAX(a.right, b.right)};
+}
+
+void rg_gui_compose_invalidate(void)
+{
+    for (int y = 0; y < RG_SCREEN_HEIGHT; y++)
+        surface.valid[y] = (span_t){0, -1};
+}
+
+void rg_gui_compose_begin(void)
+{
+    if (surface.depth++ > 0)
+        return;
+
+    if (!surface.buffer)
+    {
+        // Not critical, we just draw directly to the display if there isn't enough memory
+        surface.buffer = heap_caps_malloc(RG_SCREEN_WIDTH * RG_SCREEN_HEIGHT * 2, MALLOC_CAP_SPIRAM);
+        if (!surface.buffer)
+            RG_LOGW("Not enough memory for the compose surface, drawing directly.\n");
+        for (int y = 0; y < RG_SCREEN_HEIGHT; y++)
+            surface.dirty[y] = (span_t){0, -1};
+        rg_gui_compose_invalidate();
+    }
+}
+
+void rg_gui_compose_flush(void)
+{
+    if (!surface.buffer)
+        return;
+
+    for (int y = 0; y < RG_SCREEN_HEIGHT;)
+    {
+        if (span_empty(surface.dirty[y]))
+        {
+            y++;
+            continue;
+        }
+
+        // Grow a band of consecutive rows sent in a single write. The band's span must only cover
+        // pixels that are either dirty or valid on every row, anything else is stale canvas.
+        span_t band = surface.dirty[y];
+        span_t cover = span_merge(surface.dirty[y], surface.valid[y]);
+        int height = 1;
+
+        while (y + height < RG_SCREEN_HEIGHT && !span_empty(surface.dirty[y + height]))
+        {
+            span_t dirty = surface.dirty[y + height];
+            span_t row_cover = span_merge(dirty, surface.valid[y + height]);
+            span_t new_band = {RG_MIN(band.left, dirty.left), RG_MAX(band.right, dirty.right)};
+            span_t new_cover = {RG_MAX(cover.left, row_cover.left), RG_MIN(cover.right, row_cover.right)};
+
+            if (new_band.left < new_cover.left || new_band.right > new_cover.right)
+                break;
+
+            band = new_band;
+            cover = new_cover;
+            height++;
+        }
+
+        rg_display_write(band.left, y, band.right - band.left + 1, height, RG_SCREEN_WIDTH * 2,
+                         surface.buffer + y * RG_SCREEN_WIDTH + band.left);
+
+        for (int end = y + height; y < end; y++)
+        {
+            surface.valid[y] = span_merge(surface.dirty[y], surface.valid[y]);
+            surface.dirty[y] = (span_t){0, -1};
+        }
+    }
+}
+
+void rg_gui_compose_end(void)
+{
+    RG_ASSERT(surface.depth > 0, "Unbalanced rg_gui_compose_end");
+
+    if (--surface.depth == 0)
+        rg_gui_compose_flush();
+}
+
+static void surface_put_row(int x, int y, int width, const uint16_t *src, uint16_t color)
+{
+    uint16_t *dst = surface.buffer + y * RG_SCREEN_WIDTH;
+    span_t valid = surface.valid[y];
+    int first = -1, last = -1;
+
+    for (int i = x; i < x + width; i++)
+    {
+        uint16_t pixel = src ? src[i - x] : color;
+        if (dst[i] != pixel || i < valid.left || i > valid.right)
+        {
+            dst[i] = pixel;
+            if (first < 0)
+                first = i;
+            last = i;
+        }
+    }
+
+    if (first >= 0)
+    {
+        span_t *dirty = &surface.dirty[y];
+        if (span_empty(*dirty))
+            *dirty = (span_t){first, last};
+        else
+            *dirty = (span_t){RG_MIN(dirty->left, first), RG_MAX(dirty->right, last)};
+    }
+}
+
+// Central drawing helpers: everything goes through here so that composing is transparent
+static void gui_write(int x_pos, int y_pos, int width, int height, int stride, const uint16_t *buffer)
+{
+    if (stride < width * 2)
+        stride = width * 2;
+
+    if (x_pos < 0)
+    {
+        buffer -= x_pos;
+        width += x_pos;
+        x_pos = 0;
+    }
+    if (y_pos < 0)
+    {
+        buffer = (void *)buffer - y_pos * stride;
+        height += y_pos;
+        y_pos = 0;
+    }
+
+    width = RG_MIN(width, RG_SCREEN_WIDTH - x_pos);
+    height = RG_MIN(height, RG_SCREEN_HEIGHT - y_pos);
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (surface.depth > 0 && surface.buffer)
+    {
+        for (int y = 0; y < height; y++)
+            surface_put_row(x_pos, y_pos + y, width, (void *)buffer + y * stride, 0);
+    }
+    else
+    {
+        rg_display_write(x_pos, y_pos, width, height, stride, buffer);
+    }
+}
+
+static void gui_fill(int x_pos, int y_pos, int width, int height, uint16_t color)
+{
+    if (x_pos < 0)
+    {
+        width += x_pos;
+        x_pos = 0;
+    }
+    if (y_pos < 0)
+    {
+        height += y_pos;
+        y_pos = 0;
+    }
+
+    width = RG_MIN(width, RG_SCREEN_WIDTH - x_pos);
+    height = RG_MIN(height, RG_SCREEN_HEIGHT - y_pos);
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (surface.depth > 0 && surface.buffer)
+    {
+        for (int y = 0; y < height; y++)
+            surface_put_row(x_pos, y_pos + y, width, NULL, color);
+    }
+    else
+    {
+        int lines = RG_MIN(height, (RG_SCREEN_WIDTH * 32) / width);
+
+        for (int p = width * lines - 1; p >= 0; --p)
+            overlay_buffer[p] = color;
+
+        for (int y_end = y_pos + height; y_pos < y_end; y_pos += lines)
+            rg_display_write(x_pos, y_pos, width, RG_MIN(lines, y_end - y_pos), 0, overlay_buffer);
+    }
+}
+
 bool rg_gui_set_theme(const dialog_theme_t *new_theme)
 {
     if (!new_theme)
@@ -241,7 +449,7 @@ rg_rect_t rg_gui_draw_text(int x_pos, int y_pos, int width, const char *text,
         }
 
         if (!(flags & RG_TEXT_DUMMY_DRAW))
-            rg_display_write(x_pos, y_pos + y_offset, draw_width, font_height, 0, overlay_buffer);
+            gui_write(x_pos, y_pos + y_offset, draw_width, font_height, 0, overlay_buffer);
 
         y_offset += font_height;
 
@@ -260,13 +468,10 @@ void rg_gui_draw_rect(int x_pos, int y_pos, int width, int height, int border, u
     if (x_pos < 0) x_pos += RG_SCREEN_WIDTH;
     if (y_pos < 0) y_pos += RG_SCREEN_HEIGHT;
 
-    for (int p = border * RG_MAX(width, height); p >= 0; --p)
-        overlay_buffer[p] = color;
-
-    rg_display_write(x_pos, y_pos, width, border, 0, overlay_buffer); // T
-    rg_display_write(x_pos, y_pos + height - border, width, border, 0, overlay_buffer); // B
-    rg_display_write(x_pos, y_pos, border, height, 0, overlay_buffer); // L
-    rg_display_write(x_pos + width - border, y_pos, border, height, 0, overlay_buffer); // R
+    gui_fill(x_pos, y_pos, width, border, color); // T
+    gui_fill(x_pos, y_pos + height - border, width, border, color); // B
+    gui_fill(x_pos, y_pos, border, height, color); // L
+    gui_fill(x_pos + width - border, y_pos, border, height, color); // R
 }
 
 void rg_gui_draw_fill_rect(int x_pos, int y_pos, int width, int height, uint16_t color)
@@ -277,14 +482,7 @@ void rg_gui_draw_fill_rect(int x_pos, int y_pos, int width, int height, uint16_t
     if (x_pos < 0) x_pos += RG_SCREEN_WIDTH;
     if (y_pos < 0) y_pos += RG_SCREEN_HEIGHT;
 
-    for (int p = width * 16; p >= 0; --p)
-        overlay_buffer[p] = color;
-
-    for (int y_end = y_pos + height; y_pos < y_end; y_pos += 16)
-    {
-        int thickness = (y_end - y_pos >= 16) ? 16 : (y_end - y_pos);
-        rg_display_write(x_pos, y_pos, width, thickness, 0, overlay_buffer);
-    }
+    gui_fill(x_pos, y_pos, width, height, color);
 }
 
 void rg_gui_draw_image(int x_pos, int y_pos, int width, int height, const rg_image_t *img)
@@ -296,7 +494,7 @@ void rg_gui_draw_image(int x_pos, int y_pos, int width, int height, const rg_ima
     {
         width = RG_MIN(width > 0 ? width : img->width, RG_SCREEN_WIDTH);
         height = RG_MIN(height > 0 ? height : img->height, RG_SCREEN_HEIGHT);
-        rg_display_write(x_pos, y_pos, width, height, img->width * 2, img->data);
+        gui_write(x_pos, y_pos, width, height, img->width * 2, img->data);
     }
 }
 
@@ -325,7 +523,7 @@ void rg_gui_draw_battery(int x_pos, int y_pos)
 
 void rg_gui_draw_hourglass(void)
 {
-    rg_display_write((RG_SCREEN_WIDTH / 2) - (image_hourglass.width / 2),
+    gui_write((RG_SCREEN_WIDTH / 2) - (image_hourglass.width / 2),
         (RG_SCREEN_HEIGHT / 2) - (image_hourglass.height / 2),
         image_hourglass.width,
         image_hourglass.height,
@@ -402,6 +600,8 @@ void rg_gui_draw_dialog(const char *header, const dialog_option_t *options, int
     const int box_x = (RG_SCREEN_WIDTH - box_width) / 2;
     const int box_y = (RG_SCREEN_HEIGHT - box_height) / 2;
 
+    rg_gui_compose_begin();
+
     int x = box_x + box_padding;
     int y = box_y + box_padding;
 
@@ -494,6 +694,8 @@ void rg_gui_draw_dialog(const char *header, const dialog_option_t *options, int
         rg_gui_draw_fill_rect(x + 6, y, 3, 3, theme.scrollbar);
         rg_gui_draw_fill_rect(x + 12, y, 3, 3, theme.scrollbar);
     }
+
+    rg_gui_compose_end();
 }
 
 int rg_gui_dialog(const char *header, const dialog_option_t *options_const, int selected)
@@ -529,6 +731,7 @@ int rg_gui_dialog(const char *header, const dialog_option_t *options_const, int
     }
 
     rg_input_wait_for_key(GAMEPAD_KEY_ALL, false);
+    rg_gui_compose_invalidate();
     rg_gui_draw_dialog(header, options, sel);
 
     while (1)
@@ -616,6 +819,9 @@ int rg_gui_dialog(const char *header, const dialog_option_t *options_const, int
                 if (sel >= options_count)
                     sel = 0;
             }
+            // Callbacks may have drawn behind our back (nested dialogs, display settings, etc)
+            if (sel_old < 0)
+                rg_gui_compose_invalidate();
             rg_gui_draw_dialog(header, options, sel);
             sel_old = sel;
         }
@@ -778,7 +984,65 @@ static dialog_return_t speedup_update_cb(dialog_option_t *option, dialog_event_t
     if (event == RG_DIALOG_PREV && --app->speedupEnabled < 0) app->speedupEnabled = 2;
     if (event == RG_DIALOG_NEXT && ++app->speedupEnabled > 2) app->speedupEnabled = 0;
 
-    sprintf(option->value, "%dx", app->speedupEnabled + 1);
+    const char *modes[] = {"Off", "On", "Max"};
+    strcpy(option->value, modes[app->speedupEnabled % 3]);
+
+    return RG_DIALOG_IGNORE;
+}
+
+static dialog_return_t poll_rate_update_cb(dialog_option_t *option, dialog_event_t event)
+{
+    const int rates[] = {60, 100, 250, 500, 1000};
+    const int count = sizeof(rates) / sizeof(rates[0]);
+    int rate = rg_input_get_poll_rate();
+
+    // The stored rate may not be one of ours, step to its neighbours and show it as it is
+    if (event == RG_DIALOG_PREV)
+    {
+        int pos = count - 1;
+        while (pos > 0 && rates[pos] >= rate)
+            pos--;
+        rg_input_set_poll_rate(rates[pos] < rate ? rates[pos] : rates[count - 1]);
+    }
+    else if (event == RG_DIALOG_NEXT)
+    {
+        int pos = 0;
+        while (pos < count - 1 && rates[pos] <= rate)
+            pos++;
+        rg_input_set_poll_rate(rates[pos] > rate ? rates[pos] : rates[0]);
+    }
+
+    sprintf(option->value, "%dHz", rg_input_get_poll_rate());
+
+    return RG_DIALOG_IGNORE;
+}
+
+static dialog_return_t late_latch_update_cb(dialog_option_t *option, dialog_event_t event)
+{
+    bool enabled = rg_input_get_late_latch();
+
+    if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
+    {
+        enabled = !enabled;
+        rg_input_set_late_latch(enabled);
+    }
+
+    strcpy(option->value, enabled ? "On " : "Off");
+
+    return RG_DIALOG_IGNORE;
+}
+
+static dialog_return_t rewind_update_cb(dialog_option_t *option, dialog_event_t event)
+{
+    bool enabled = rg_rewind_get_enabled();
+
+    if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
+    {
+        enabled = !enabled;
+        rg_rewind_set_enabled(enabled);
+    }
+
+    strcpy(option->value, enabled ? "On " : "Off");
 
     return RG_DIALOG_IGNORE;
 }
@@ -797,7 +1061,10 @@ int rg_gui_settings_menu(const dialog_option_t *extra_options)
         *opt++ = (dialog_option_t){0, "Scaling", "Full", 1, &scaling_update_cb};
         *opt++ = (dialog_option_t){0, "Filter", "None", 1, &filter_update_cb};
         *opt++ = (dialog_option_t){0, "Update", "Partial", 1, &update_mode_update_cb};
-        *opt++ = (dialog_option_t){0, "Speed", "1x", 1, &speedup_update_cb};
+        *opt++ = (dialog_option_t){0, "Turbo", "Off", 1, &speedup_update_cb};
+        *opt++ = (dialog_option_t){0, "Input poll", "100Hz", 1, &poll_rate_update_cb};
+        *opt++ = (dialog_option_t){0, "Late latch", "Off", 1, &late_latch_update_cb};
+        *opt++ = (dialog_option_t){0, "Rewind", "Off", 1, &rewind_update_cb};
     }
 
     while (extra_options && (*extra_options).flags != RG_DIALOG_FLAG_LAST)
@@ -818,17 +1085,24 @@ int rg_gui_about_menu(const dialog_option_t *extra_options)
 {
     char build_ver[32], build_date[32], build_user[32];
 
-    const dialog_option_t options[] = {
-        {0, "Ver.", build_ver, 1, NULL},
-        {0, "Date", build_date, 1, NULL},
-        {0, "By", build_user, 1, NULL},
-        RG_DIALOG_SEPARATOR,
-        {1000, "Reboot to firmware", NULL, 1, NULL},
-        {2000, "Reset settings", NULL, 1, NULL},
-        {4000, "Debug", NULL, 1, NULL},
-        {0000, "Close", NULL, 1, NULL},
-        RG_DIALOG_CHOICE_LAST
-    };
+    dialog_option_t options[16 + get_dialog_items_count(extra_options)];
+    dialog_option_t *opt = &options[0];
+
+    *opt++ = (dialog_option_t){0, "Ver.", build_ver, 1, NULL};
+    *opt++ = (dialog_option_t){0, "Date", build_date, 1, NULL};
+    *opt++ = (dialog_option_t){0, "By", build_user, 1, NULL};
+    *opt++ = (dialog_option_t)RG_DIALOG_SEPARATOR;
+    *opt++ = (dialog_option_t){1000, "Reboot to firmware", NULL, 1, NULL};
+    *opt++ = (dialog_option_t){2000, "Reset settings", NULL, 1, NULL};
+
+    while (extra_options && (*extra_options).flags != RG_DIALOG_FLAG_LAST)
+    {
+        *opt++ = *extra_options++;
+    }
+
+    *opt++ = (dialog_option_t){4000, "Debug", NULL, 1, NULL};
+    *opt++ = (dialog_option_t){0000, "Close", NULL, 1, NULL};
+    *opt++ = (dialog_option_t)RG_DIALOG_CHOICE_LAST;
 
     const rg_app_desc_t *app = rg_system_get_app();
 
@@ -867,11 +1141,42 @@ int rg_gui_about_menu(const dialog_option_t *extra_options)
     return sel;
 }
 
+static void show_memory_map(void)
+{
+    dialog_option_t options[16];
+    char values[15][24];
+    uint32_t fallbacks = 0;
+    size_t count = 0;
+
+    const rg_alloc_stats_t *stats = rg_alloc_get_stats(&count);
+
+    for (size_t i = 0; i < count; i++)
+        fallbacks += stats[i].fallbacks;
+
+    // The dialog is limited to 16 items, the full map is in the trace
+    count = RG_MIN(count, 14);
+
+    sprintf(values[0], "%d", fallbacks);
+    options[0] = (dialog_option_t){0, "Fast->Slow", values[0], 1, NULL};
+
+    // Tags that suffered a MEM_FAST fallback are greyed out
+    for (size_t i = 0; i < count; i++)
+    {
+        snprintf(values[i + 1], 24, "%dK+%dK", stats[i].internal / 1024, stats[i].external / 1024);
+        options[i + 1] = (dialog_option_t){0, stats[i].tag, values[i + 1], stats[i].fallbacks ? 0 : 1, NULL};
+    }
+
+    options[count + 1] = (dialog_option_t)RG_DIALOG_CHOICE_LAST;
+
+    rg_gui_dialog("Allocated since boot", options, 0);
+}
+
 int rg_gui_debug_menu(const dialog_option_t *extra_options)
 {
     char screen_res[20], game_res[20], scaled_res[20];
     char stack_hwm[20], heap_free[20], block_free[20];
-    char system_rtc[20], uptime[20];
+    char system_rtc[20], uptime[20], input_lat[20];
+    char rewind[20], file_cache[20], bus_wait[24];
 
     const dialog_option_t options[] = {
         {0, "Screen Res", screen_res, 1, NULL},
@@ -882,11 +1187,17 @@ int rg_gui_debug_menu(const dialog_option_t *extra_options)
         {0, "Block free", block_free, 1, NULL},
         {0, "System RTC", system_rtc, 1, NULL},
         {0, "Uptime    ", uptime, 1, NULL},
+        {0, "Input lat.", input_lat, 1, NULL},
+        {0, "Rewind    ", rewind, 1, NULL},
+        {0, "File cache", file_cache, 1, NULL},
+        {0, "Bus wait  ", bus_wait, 1, NULL},
         RG_DIALOG_SEPARATOR,
         {1000, "Save screenshot", NULL, 1, NULL},
         {2000, "Save trace", NULL, 1, NULL},
         {3000, "Cheats", NULL, 1, NULL},
         {4000, "Crash", NULL, 1, NULL},
+        {5000, "Memory map", NULL, 1, NULL},
+        {6000, "SD benchmark", NULL, 1, NULL},
         RG_DIALOG_CHOICE_LAST
     };
 
@@ -902,6 +1213,13 @@ int rg_gui_debug_menu(const dialog_option_t *extra_options)
     sprintf(heap_free, "%d+%d", stats.freeMemoryInt, stats.freeMemoryExt);
     sprintf(block_free, "%d+%d", stats.freeBlockInt, stats.freeBlockExt);
     sprintf(uptime, "%ds", (int)(get_elapsed_time() / 1000 / 1000));
+    sprintf(input_lat, "%.1f/%.1fms", stats.inputLatency, stats.inputLatencyMax);
+    sprintf(rewind, "%.0fus %ds", stats.rewindTime, rg_rewind_get_status().depth / 60);
+    const rg_file_stats_t fstats = rg_file_get_stats();
+    sprintf(file_cache, "%d%% %dKB", (int)(fstats.hits * 100ull / RG_MAX(fstats.hits + fstats.misses, 1u)), fstats.bytes / 1024);
+    const rg_spi_lock_stats_t sd_wait = rg_spi_lock_get_stats(SPI_LOCK_SDCARD);
+    const rg_spi_lock_stats_t lcd_wait = rg_spi_lock_get_stats(SPI_LOCK_DISPLAY);
+    sprintf(bus_wait, "SD %.1f LCD %.1fms", sd_wait.maxWaitTime / 1000.f, lcd_wait.maxWaitTime / 1000.f);
 
     int sel = rg_gui_dialog("Debugging", options, 0);
 
@@ -917,6 +1235,18 @@ int rg_gui_debug_menu(const dialog_option_t *extra_options)
     {
         RG_PANIC("Crash test!");
     }
+    else if (sel == 5000)
+    {
+        show_memory_map();
+    }
+    else if (sel == 6000)
+    {
+        char message[64];
+        rg_gui_draw_hourglass();
+        float speed = rg_sdcard_benchmark(4 * 1024 * 1024);
+        sprintf(message, "Read: %.2f MB/s\nClock: %d kHz", speed, rg_sdcard_get_freq());
+        rg_gui_alert("SD Card", message);
+    }
 
     return sel;
 }
@@ -958,6 +1288,15 @@ int rg_gui_game_settings_menu(const dialog_option_t *extra_options)
     return sel;
 }
 
+static volatile bool save_failed = false;
+
+static void save_state_done_cb(int slot, bool success)
+{
+    // We're on the writer task, the alert waits for the menu's next opening
+    if (!success)
+        save_failed = true;
+}
+
 int rg_gui_game_menu(void)
 {
     const dialog_option_t choices[] = {
@@ -982,6 +1321,12 @@ int rg_gui_game_menu(void)
     rg_audio_set_mute(true);
     draw_game_status_bar();
 
+    if (save_failed)
+    {
+        save_failed = false;
+        rg_gui_alert("Save failed", NULL);
+    }
+
     int sel = rg_gui_dialog("Retro-Go", choices, 0);
 
     if (sel == 3000)
@@ -991,7 +1336,7 @@ int rg_gui_game_menu(void)
 
     switch (sel)
     {
-        case 1000: rg_emu_save_state(0); break;
+        case 1000: rg_emu_save_state_async(0, &save_state_done_cb); break;
         case 2000: rg_emu_save_state(0); rg_system_switch_app(RG_APP_LAUNCHER); break;
         case 3001: rg_emu_load_state(0); break; // esp_restart();
         case 3002: rg_emu_reset(false); break;
@@ -109,6 +109,11 @@ void rg_gui_draw_dialog(const char *header, const dialog_option_t *options, int
 void rg_gui_draw_image(int x_pos, int y_pos, int width, int height, const rg_image_t *img);
 void rg_gui_draw_hourglass(void);
 
+void rg_gui_compose_begin(void);
+void rg_gui_compose_flush(void);
+void rg_gui_compose_end(void);
+void rg_gui_compose_invalidate(void);
+
 int  rg_gui_dialog(const char *header, const dialog_option_t *options, int selected_initial);
 bool rg_gui_confirm(const char *title, const char *message, bool yes_selected);
 void rg_gui_alert(const char *title, const char *message);
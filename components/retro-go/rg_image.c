@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <lupng.h>
 // #include <gifdec.h>
 // #include <gifenc.h>
@@ -35,11 +36,188 @@ static inline void copy_rgb888_to_rgb565(uint16_t *dest, const uint8_t *src, siz
     }
 }
 
-rg_image_t *rg_image_load_from_file(const char *filename, uint32_t flags)
+#define STREAM_DISPLAY_LINES 8
+
+typedef struct
+{
+    rg_image_t *img;        // Output image, NULL when the lines go straight to the display
+    uint16_t *lines;        // Lines waiting to be sent to the display
+    size_t lines_count;
+    size_t max_width, max_height;
+    size_t width, height;   // Output size, known once the first row has been decoded
+    size_t next_row;        // Next output row
+    int x_pos, y_pos;
+} png_stream_t;
+
+static void fit_size(size_t *width, size_t *height, size_t max_width, size_t max_height)
+{
+    size_t w = *width, h = *height;
+
+    if (max_width && w > max_width)
+    {
+        h = RG_MAX(1, h * max_width / w);
+        w = max_width;
+    }
+    if (max_height && h > max_height)
+    {
+        w = RG_MAX(1, w * max_height / h);
+        h = max_height;
+    }
+
+    *width = w;
+    *height = h;
+}
+
+static void copy_row_to_rgb565(uint16_t *dest, size_t width, const LuImage *row)
+{
+    uint32_t step = (row->width << 16) / width;
+    size_t channels = row->channels;
+
+    for (size_t x = 0, pos = 0; x < width; ++x, pos += step)
+    {
+        size_t idx = (pos >> 16) * channels;
+        uint8_t r, g, b;
+
+        if (row->depth == 16) // Keep the most significant byte only
+        {
+            const uint16_t *src = (const uint16_t *)row->data + idx;
+            r = src[0] >> 8;
+            g = src[channels >= 3 ? 1 : 0] >> 8;
+            b = src[channels >= 3 ? 2 : 0] >> 8;
+        }
+        else
+        {
+            const uint8_t *src = row->data + idx;
+            r = src[0];
+            g = src[channels >= 3 ? 1 : 0];
+            b = src[channels >= 3 ? 2 : 0];
+        }
+
+        dest[x] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+    }
+}
+
+static void png_stream_flush(png_stream_t *stream)
+{
+    if (stream->lines_count > 0)
+    {
+        size_t top = stream->y_pos + stream->next_row - stream->lines_count;
+        rg_display_write(stream->x_pos, top, stream->width, stream->lines_count,
+                         stream->width * 2, stream->lines);
+        stream->lines_count = 0;
+    }
+}
+
+static int png_stream_row(const LuImage *row, int32_t y, int32_t height, void *arg)
+{
+    png_stream_t *stream = arg;
+
+    if (y == 0)
+    {
+        stream->width = row->width;
+        stream->height = height;
+        fit_size(&stream->width, &stream->height, stream->max_width, stream->max_height);
+
+        if (stream->lines)
+        {
+            // Negative positions align the image with the right/bottom edge of the screen
+            if (stream->x_pos < 0) stream->x_pos = RG_MAX(0, RG_SCREEN_WIDTH - (int)stream->width);
+            if (stream->y_pos < 0) stream->y_pos = RG_MAX(0, RG_SCREEN_HEIGHT - (int)stream->height);
+        }
+        else if (!(stream->img = rg_image_alloc(stream->width, stream->height)))
+        {
+            return -1;
+        }
+    }
+
+    // Nearest neighbor: every output row picks the closest source row, most source rows are skipped
+    while (stream->next_row < stream->height && stream->next_row * height / stream->height == y)
+    {
+        if (stream->img)
+        {
+            copy_row_to_rgb565(stream->img->data + stream->next_row * stream->width, stream->width, row);
+            stream->next_row++;
+        }
+        else
+        {
+            copy_row_to_rgb565(stream->lines + stream->lines_count * stream->width, stream->width, row);
+            stream->lines_count++;
+            stream->next_row++;
+
+            if (stream->lines_count == STREAM_DISPLAY_LINES || stream->next_row == stream->height)
+                png_stream_flush(stream);
+
+        }
+    }
+
+    return 0;
+}
+
+static size_t png_stream_read(void *ptr, size_t size, size_t count, void *arg)
+{
+    return fread(ptr, size, count, (FILE *)arg);
+}
+
+// Decodes one scanline at a time, neither the file nor the full size image are ever held in memory
+static bool png_stream_file(const char *filename, png_stream_t *stream)
+{
+    LuUserContext userCtx;
+    LuImage *png = NULL;
+
+    FILE *fp = rg_file_open(filename, "rb", 0);
+    if (!fp)
+        return false;
+
+    luUserContextInitDefault(&userCtx);
+    userCtx.readProc = png_stream_read;
+    userCtx.readProcUserPtr = fp;
+    userCtx.rowProc = png_stream_row;
+    userCtx.rowProcUserPtr = stream;
+
+    png = luPngReadUC(&userCtx);
+    fclose(fp);
+
+    if (png)
+        luImageRelease(png, &userCtx);
+
+    return png != NULL;
+}
+
+static bool is_png_file(const char *filename)
+{
+    char header[4] = {0};
+
+    FILE *fp = rg_file_open(filename, "rb", 0);
+    if (!fp)
+        return false;
+
+    fread(header, 4, 1, fp);
+    fclose(fp);
+
+    return memcmp(header, "\x89PNG", 4) == 0;
+}
+
+static rg_image_t *load_file(const char *filename, size_t max_width, size_t max_height, uint32_t flags)
 {
     RG_ASSERT(filename, "bad param");
 
-    FILE *fp = fopen(filename, "rb");
+    if (is_png_file(filename))
+    {
+        png_stream_t stream = {.max_width = max_width, .max_height = max_height};
+
+        if (png_stream_file(filename, &stream))
+            return stream.img;
+
+        // Interlaced images can't be streamed, they go through the regular loader
+        if (stream.img || stream.height)
+        {
+            RG_LOGE("PNG parsing failed!\n");
+            rg_image_free(stream.img);
+            return NULL;
+        }
+    }
+
+    FILE *fp = rg_file_open(filename, "rb", 0);
     if (!fp)
     {
         RG_LOGE("Unable to open image file '%s'!\n", filename);
@@ -64,9 +242,74 @@ rg_image_t *rg_image_load_from_file(const char *filename, uint32_t flags)
     rg_image_t *img = rg_image_load_from_memory(data, data_len, flags);
     free(data);
 
+    size_t width = img ? img->width : 0, height = img ? img->height : 0;
+    fit_size(&width, &height, max_width, max_height);
+
+    if (img && (width != img->width || height != img->height))
+    {
+        rg_image_t *resized = rg_image_copy_resized(img, width, height);
+        rg_image_free(img);
+        img = resized;
+    }
+
     return img;
 }
 
+rg_image_t *rg_image_load_from_file(const char *filename, uint32_t flags)
+{
+    return load_file(filename, 0, 0, flags);
+}
+
+rg_image_t *rg_image_load_scaled(const char *filename, size_t max_width, size_t max_height)
+{
+    return load_file(filename, max_width, max_height, 0);
+}
+
+bool rg_image_draw_from_file(const char *filename, int x_pos, int y_pos, size_t max_width, size_t max_height)
+{
+    RG_ASSERT(filename, "bad param");
+
+    // The image is shrunk to fit on screen if necessary
+    size_t screen_width = RG_SCREEN_WIDTH - RG_MAX(x_pos, 0);
+    max_width = max_width ? RG_MIN(max_width, screen_width) : screen_width;
+    size_t screen_height = RG_SCREEN_HEIGHT - RG_MAX(y_pos, 0);
+    max_height = max_height ? RG_MIN(max_height, screen_height) : screen_height;
+
+    if (is_png_file(filename))
+    {
+        png_stream_t stream = {
+            .lines = malloc(RG_SCREEN_WIDTH * STREAM_DISPLAY_LINES * 2),
+            .max_width = max_width,
+            .max_height = max_height,
+            .x_pos = x_pos,
+            .y_pos = y_pos,
+        };
+
+        if (!stream.lines)
+            return false;
+
+        bool success = png_stream_file(filename, &stream);
+        png_stream_flush(&stream);
+        free(stream.lines);
+
+        if (success || stream.height)
+            return success;
+    }
+
+    // Not a PNG or not streamable
+    rg_image_t *img = rg_image_load_scaled(filename, max_width, max_height);
+    if (!img)
+        return false;
+
+    if (x_pos < 0) x_pos = RG_MAX(0, RG_SCREEN_WIDTH - img->width);
+    if (y_pos < 0) y_pos = RG_MAX(0, RG_SCREEN_HEIGHT - img->height);
+
+    rg_display_write(x_pos, y_pos, img->width, img->height, img->width * 2, img->data);
+    rg_image_free(img);
+
+    return true;
+}
+
 rg_image_t *rg_image_load_from_memory(const uint8_t *data, size_t data_len, uint32_t flags)
 {
     if (!data || data_len < 16)
@@ -134,10 +377,26 @@ rg_image_t *rg_image_load_from_memory(const uint8_t *data, size_t data_len, uint
     return NULL;
 }
 
+static size_t png_file_write(const void *ptr, size_t size, size_t count, void *arg)
+{
+    return fwrite(ptr, size, count, (FILE *)arg);
+}
+
 bool rg_image_save_to_file(const char *filename, const rg_image_t *img, uint32_t flags)
 {
     RG_ASSERT(filename && img, "bad param");
 
+    LuUserContext userCtx;
+    luUserContextInitDefault(&userCtx);
+
+    if (flags & RG_IMAGE_SAVE_FAST)
+    {
+        // Sub and Up do most of the work on emulator frames, Average/Paeth and a palette only shave a few %
+        userCtx.compressionLevel = 1;
+        userCtx.filterMask = PNG_FILTER_MASK_SUB | PNG_FILTER_MASK_UP;
+        userCtx.buildPalette = 0;
+    }
+
     LuImage *png = luImageCreate(img->width, img->height, 3, 8, 0, 0);
     if (!png)
     {
@@ -147,14 +406,30 @@ bool rg_image_save_to_file(const char *filename, const rg_image_t *img, uint32_t
 
     copy_rgb565_to_rgb888(png->data, img->data, img->width * img->height);
 
-    if (luPngWriteFile(filename, png))
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
     {
+        RG_LOGE("Unable to open '%s'!\n", filename);
         luImageRelease(png, 0);
-        return true;
+        return false;
     }
 
+    // Full buffering, the encoder emits small writes (chunk headers, CRCs)
+    setvbuf(fp, NULL, _IOFBF, 8192);
+
+    userCtx.writeProc = png_file_write;
+    userCtx.writeProcUserPtr = fp;
+
+    int status = luPngWriteUC(&userCtx, png);
     luImageRelease(png, 0);
-    return false;
+
+    if (fclose(fp) != 0 || status != PNG_OK)
+    {
+        unlink(filename);
+        return false;
+    }
+
+    return true;
 }
 
 rg_image_t *rg_image_alloc(size_t width, size_t height)
@@ -170,6 +445,32 @@ rg_image_t *rg_image_alloc(size_t width, size_t height)
     return img;
 }
 
+// Nearest neighbor, meant for thumbnails
+rg_image_t *rg_image_copy_resized(const rg_image_t *img, size_t new_width, size_t new_height)
+{
+    RG_ASSERT(img && new_width && new_height, "bad param");
+
+    rg_image_t *new_img = rg_image_alloc(new_width, new_height);
+    if (!new_img)
+        return NULL;
+
+    uint32_t step_x = (img->width << 16) / new_width;
+    uint32_t step_y = (img->height << 16) / new_height;
+
+    for (size_t y = 0; y < new_height; ++y)
+    {
+        const uint16_t *src = img->data + ((y * step_y) >> 16) * img->width;
+        uint16_t *dest = new_img->data + y * new_width;
+
+        for (size_t x = 0, pos = 0; x < new_width; ++x, pos += step_x)
+        {
+            dest[x] = src[pos >> 16];
+        }
+    }
+
+    return new_img;
+}
+
 void rg_image_free(rg_image_t *img)
 {
     free(img);
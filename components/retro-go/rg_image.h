@@ -29,9 +29,17 @@ typedef struct
 } rg_palette_t;
 
 
+enum
+{
+    RG_IMAGE_SAVE_FAST = (1 << 0), // Favor speed over size, for screenshots
+};
+
 rg_image_t *rg_image_load_from_file(const char *filename, uint32_t flags);
+rg_image_t *rg_image_load_scaled(const char *filename, size_t max_width, size_t max_height);
 rg_image_t *rg_image_load_from_memory(const uint8_t *data, size_t data_len, uint32_t flags);
 rg_image_t *rg_image_alloc(size_t width, size_t height);
+rg_image_t *rg_image_copy_resized(const rg_image_t *img, size_t new_width, size_t new_height);
+bool rg_image_draw_from_file(const char *filename, int x_pos, int y_pos, size_t max_width, size_t max_height);
 bool rg_image_build_palette(rg_palette_t *out, const rg_image_t *img);
 bool rg_image_save_to_file(const char *filename, const rg_image_t *img, uint32_t flags);
 bool rg_image_save_to_memory(const uint8_t *data, size_t data_len, const rg_image_t *img, uint32_t flags);
@@ -1,8 +1,10 @@
 #include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_adc_cal.h>
 #include <driver/gpio.h>
 #include <driver/adc.h>
 #include <driver/i2c.h>
+#include <esp_timer.h>
 #include <string.h>
 
 #include "rg_system.h"
@@ -12,6 +14,24 @@
 static bool input_initialized = false;
 static int64_t last_gamepad_read = 0;
 static gamepad_state_t gamepad_state;
+static TaskHandle_t input_task_handle;
+static esp_timer_handle_t poll_timer;
+static int poll_rate = RG_INPUT_POLL_RATE_DEFAULT;
+static bool late_latch = false;
+
+// The debounce state is shared between the polling task and late-latch reads
+static portMUX_TYPE input_lock = portMUX_INITIALIZER_UNLOCKED;
+// Serializes whole samples (the pad read may block on I2C, so it can't be in input_lock)
+static SemaphoreHandle_t sample_lock;
+static uint8_t debounce[GAMEPAD_KEY_COUNT];
+static uint32_t previous_raw = 0;
+static int64_t raw_edge_time[GAMEPAD_KEY_COUNT];
+static int64_t pending_edge_time = 0; // Oldest physical edge not yet seen by a reader
+static int64_t last_sample_time = 0;
+static rg_input_latency_t latency;
+
+static const char *SETTING_POLL_RATE = "InputPollRate";
+static const char *SETTING_LATE_LATCH = "InputLateLatch";
 
 
 static inline uint32_t gamepad_read(void)
@@ -50,37 +70,95 @@ static inline uint32_t gamepad_read(void)
     return state;
 }
 
-static void input_task(void *arg)
+static void update_state(uint32_t raw, int64_t now)
 {
-    uint8_t debounce[GAMEPAD_KEY_COUNT];
     const uint8_t debounce_level = 0x03;
-    gamepad_state_t input_state = 0;
 
-    // Initialize debounce state
-    memset(debounce, 0xFF, sizeof(debounce));
+    portENTER_CRITICAL(&input_lock);
 
-    while (input_initialized)
+    gamepad_state_t input_state = gamepad_state;
+    uint32_t changed = raw ^ previous_raw;
+
+    for (int i = 0; i < GAMEPAD_KEY_COUNT; ++i)
     {
-        uint32_t state = gamepad_read();
+        if (changed & (1 << i))
+        {
+            raw_edge_time[i] = now;
+        }
+
+        debounce[i] = ((debounce[i] << 1) | ((raw >> i) & 1));
+        debounce[i] &= debounce_level;
 
-        for (int i = 0; i < GAMEPAD_KEY_COUNT; ++i)
+        if (debounce[i] == debounce_level) // Pressed
+        {
+            input_state |= (1 << i);
+        }
+        else if (debounce[i] == 0x00) // Released
         {
-            debounce[i] = ((debounce[i] << 1) | ((state >> i) & 1));
-            debounce[i] &= debounce_level;
-
-            if (debounce[i] == debounce_level) // Pressed
-            {
-                input_state |= (1 << i);
-            }
-            else if (debounce[i] == 0x00) // Released
-            {
-                input_state &= ~(1 << i);
-            }
+            input_state &= ~(1 << i);
         }
 
-        gamepad_state = input_state;
+        if (((input_state ^ gamepad_state) & (1 << i)) && !pending_edge_time)
+        {
+            pending_edge_time = raw_edge_time[i] ?: now;
+        }
+    }
+
+    previous_raw = raw;
+    gamepad_state = input_state;
+    last_sample_time = now;
+
+    portEXIT_CRITICAL(&input_lock);
+}
+
+// Reads the pad and updates the debounced state. Returns false if another context is sampling
+// right now and timeout expired, that sample will be just as fresh as ours.
+static bool sample_gamepad(TickType_t timeout)
+{
+    if (!xSemaphoreTake(sample_lock, timeout))
+        return false;
+    update_state(gamepad_read(), get_elapsed_time());
+    xSemaphoreGive(sample_lock);
+    return true;
+}
+
+static gamepad_state_t deliver_state(void)
+{
+    int64_t now = get_elapsed_time();
+    gamepad_state_t state;
+
+    portENTER_CRITICAL(&input_lock);
+
+    state = gamepad_state;
+
+    if (pending_edge_time)
+    {
+        uint32_t elapsed = now - pending_edge_time;
+        latency.count++;
+        latency.total += elapsed;
+        latency.max = RG_MAX(latency.max, elapsed);
+        pending_edge_time = 0;
+    }
+
+    portEXIT_CRITICAL(&input_lock);
 
-        vTaskDelay(pdMS_TO_TICKS(10));
+    last_gamepad_read = now;
+
+    return state;
+}
+
+static void poll_timer_cb(void *arg)
+{
+    xTaskNotifyGive(input_task_handle);
+}
+
+static void input_task(void *arg)
+{
+    while (input_initialized)
+    {
+        // The timeout is only there so that we notice rg_input_deinit
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        sample_gamepad(portMAX_DELAY);
     }
 
     vTaskDelete(NULL);
@@ -124,20 +202,75 @@ void rg_input_init(void)
 
 #endif
 
-    // Start background polling
-    xTaskCreatePinnedToCore(&input_task, "input_task", 1024, NULL, 5, NULL, 1);
+    // Initialize debounce state
+    memset(debounce, 0xFF, sizeof(debounce));
+
+    poll_rate = rg_settings_get_int32(SETTING_POLL_RATE, RG_INPUT_POLL_RATE_DEFAULT);
+    late_latch = rg_settings_get_int32(SETTING_LATE_LATCH, 0);
 
+    sample_lock = xSemaphoreCreateMutex();
     input_initialized = true;
 
+    // Start background polling. A timer paces the task because FreeRTOS ticks are too coarse
+    xTaskCreatePinnedToCore(&input_task, "input_task", 1024, NULL, 5, &input_task_handle, 1);
+    esp_timer_create(&(esp_timer_create_args_t){.callback = &poll_timer_cb, .name = "input_poll"}, &poll_timer);
+    rg_input_set_poll_rate(poll_rate);
+
     RG_LOGI("Input ready.\n");
 }
 
 void rg_input_deinit(void)
 {
+    if (poll_timer)
+    {
+        esp_timer_stop(poll_timer);
+        esp_timer_delete(poll_timer);
+        poll_timer = NULL;
+    }
     RG_LOGI("Input terminated.\n");
     input_initialized = false;
 }
 
+void rg_input_set_poll_rate(int rate)
+{
+    poll_rate = RG_MIN(RG_MAX(rate, RG_INPUT_POLL_RATE_MIN), RG_INPUT_POLL_RATE_MAX);
+    rg_settings_set_int32(SETTING_POLL_RATE, poll_rate);
+
+    if (poll_timer)
+    {
+        esp_timer_stop(poll_timer);
+        esp_timer_start_periodic(poll_timer, 1000000 / poll_rate);
+    }
+
+    RG_LOGI("Input poll rate set to %dHz\n", poll_rate);
+}
+
+int rg_input_get_poll_rate(void)
+{
+    return poll_rate;
+}
+
+void rg_input_set_late_latch(bool enable)
+{
+    late_latch = enable;
+    rg_settings_set_int32(SETTING_LATE_LATCH, late_latch);
+}
+
+bool rg_input_get_late_latch(void)
+{
+    return late_latch;
+}
+
+rg_input_latency_t rg_input_get_latency(bool reset)
+{
+    portENTER_CRITICAL(&input_lock);
+    rg_input_latency_t ret = latency;
+    if (reset)
+        memset(&latency, 0, sizeof(latency));
+    portEXIT_CRITICAL(&input_lock);
+    return ret;
+}
+
 long rg_input_gamepad_last_read(void)
 {
     if (!last_gamepad_read)
@@ -146,10 +279,34 @@ long rg_input_gamepad_last_read(void)
     return get_elapsed_time_since(last_gamepad_read);
 }
 
-gamepad_state_t rg_input_read_gamepad(void)
+IRAM_ATTR gamepad_state_t rg_input_read_gamepad(void)
 {
-    last_gamepad_read = get_elapsed_time();
-    return gamepad_state;
+    return deliver_state();
+}
+
+IRAM_ATTR gamepad_state_t rg_input_read_frame(void)
+{
+    gamepad_state_t state = deliver_state();
+    rg_golden_input(&state);
+    rg_rewind_input(&state, true);
+    return state;
+}
+
+IRAM_ATTR gamepad_state_t rg_input_latch_gamepad(void)
+{
+    if (late_latch && input_initialized)
+    {
+        // Games may latch several times per frame, sampling more than once per ms is pointless
+        if (get_elapsed_time() - last_sample_time >= 1000)
+        {
+            sample_gamepad(0);
+        }
+    }
+
+    gamepad_state_t state = deliver_state();
+    rg_golden_input(&state);
+    rg_rewind_input(&state, false);
+    return state;
 }
 
 bool rg_input_key_is_pressed(gamepad_key_t key)
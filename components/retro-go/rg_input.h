@@ -21,6 +21,10 @@ typedef enum
 
 #define GAMEPAD_KEY_COUNT 16
 
+#define RG_INPUT_POLL_RATE_DEFAULT 100
+#define RG_INPUT_POLL_RATE_MIN     50
+#define RG_INPUT_POLL_RATE_MAX     1000
+
 typedef uint32_t gamepad_state_t;
 
 typedef struct
@@ -29,10 +33,24 @@ typedef struct
     int percentage;
 } battery_state_t;
 
+typedef struct
+{
+    uint32_t count;     // Key edges seen by a reader
+    uint32_t total;     // Sum of edge-to-read latencies, in us
+    uint32_t max;       // Worst edge-to-read latency, in us
+} rg_input_latency_t;
+
 void rg_input_init(void);
 void rg_input_deinit(void);
 long rg_input_gamepad_last_read(void);
 bool rg_input_key_is_pressed(gamepad_key_t key);
 void rg_input_wait_for_key(gamepad_key_t key, bool pressed);
 gamepad_state_t rg_input_read_gamepad(void);
+gamepad_state_t rg_input_read_frame(void); // The emulator's once per frame read, scripted during golden runs and filtered by rewind
+gamepad_state_t rg_input_latch_gamepad(void);
+void rg_input_set_poll_rate(int rate);
+int  rg_input_get_poll_rate(void);
+void rg_input_set_late_latch(bool enable);
+bool rg_input_get_late_latch(void);
+rg_input_latency_t rg_input_get_latency(bool reset);
 battery_state_t rg_input_read_battery(void);
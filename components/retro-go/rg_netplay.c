@@ -419,6 +419,8 @@ bool rg_netplay_quick_start(void)
         if (screen_msg != status_msg)
         {
             rg_display_clear(0);
+            // The clear went straight to the display, the GUI's canvas no longer matches it
+            rg_gui_compose_invalidate();
             rg_gui_draw_dialog(status_msg, NULL, 0);
             screen_msg = status_msg;
         }
@@ -0,0 +1,380 @@
+#include <esp_heap_caps.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rg_system.h"
+#include "rg_rewind.h"
+
+// Rewind history.
+//
+// Every RG_REWIND_INTERVAL frames the core serializes itself to RAM with saveStateMem. Only the
+// latest snapshot is kept whole: the previous one is XORed against it, which turns everything
+// that didn't change into zeros, and the result is run-length encoded into a ring in PSRAM.
+// Stepping back applies the newest delta to the latest snapshot, giving the one before it.
+// When the ring is full the oldest deltas are dropped.
+//
+// Delta payload, counted in 32bit words and repeated until the end of the state:
+//   varint zero words, varint literal words, literal words (old ^ new)
+// Ring entry:
+//   uint32 payload length, uint32 length of the older state, payload, uint32 payload length
+// The trailing length lets us walk back from the head, the leading one forward from the tail.
+
+#define ENTRY_OVERHEAD (3 * sizeof(uint32_t))
+#define CHUNK_WORDS    64
+
+typedef struct
+{
+    size_t pos;
+    size_t length;
+    size_t limit;
+} ring_io_t;
+
+static struct
+{
+    uint8_t *ring;
+    size_t ring_size;
+    size_t head;        // Where the next entry will be written
+    size_t used;
+    uint32_t count;
+    uint32_t *current;  // Latest snapshot, whole
+    uint32_t *scratch;  // Snapshot being taken
+    size_t capacity;    // Size of current and scratch, in bytes, multiple of 4
+    size_t limit;       // Worst case size of an encoded delta
+    size_t current_len;
+    bool have_current;
+    bool loaded;        // current is what's being played back, the next step pops a delta
+    bool held;
+    bool enabled;
+    bool failed;        // Don't retry allocating on every frame
+    int frames;         // Since the last snapshot
+} rw;
+
+static const char *SETTING_REWIND = "Rewind";
+
+
+static void ring_write(size_t pos, const void *data, size_t length)
+{
+    pos %= rw.ring_size;
+    size_t first = RG_MIN(length, rw.ring_size - pos);
+    memcpy(rw.ring + pos, data, first);
+    memcpy(rw.ring, (const uint8_t *)data + first, length - first);
+}
+
+static void ring_read(size_t pos, void *data, size_t length)
+{
+    pos %= rw.ring_size;
+    size_t first = RG_MIN(length, rw.ring_size - pos);
+    memcpy(data, rw.ring + pos, first);
+    memcpy((uint8_t *)data + first, rw.ring, length - first);
+}
+
+static bool io_put(ring_io_t *io, const void *data, size_t length)
+{
+    if (io->length + length > io->limit)
+        return false;
+    ring_write(io->pos + io->length, data, length);
+    io->length += length;
+    return true;
+}
+
+static bool io_put_varint(ring_io_t *io, uint32_t value)
+{
+    uint8_t buffer[5];
+    size_t length = 0;
+
+    do {
+        buffer[length++] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
+
+    return io_put(io, buffer, length);
+}
+
+static void io_get(ring_io_t *io, void *data, size_t length)
+{
+    ring_read(io->pos + io->length, data, length);
+    io->length += length;
+}
+
+static uint32_t io_get_varint(ring_io_t *io)
+{
+    uint32_t value = 0;
+    uint8_t byte;
+
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        io_get(io, &byte, 1);
+        value |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+
+    return value;
+}
+
+static void drop_oldest(void)
+{
+    size_t tail = rw.head + rw.ring_size - rw.used;
+    uint32_t length;
+
+    ring_read(tail, &length, sizeof(length));
+    rw.used -= length + ENTRY_OVERHEAD;
+    rw.count--;
+}
+
+static bool encode_delta(ring_io_t *io, const uint32_t *older, const uint32_t *newer, size_t words)
+{
+    uint32_t chunk[CHUNK_WORDS];
+    size_t i = 0;
+
+    while (i < words)
+    {
+        size_t zeros = i;
+        while (i < words && older[i] == newer[i])
+            i++;
+        zeros = i - zeros;
+
+        // A literal run only stops at two equal words in a row, a lone one costs less inline
+        size_t start = i;
+        while (i < words && (older[i] != newer[i] || (i + 1 < words && older[i + 1] != newer[i + 1])))
+            i++;
+
+        if (!io_put_varint(io, zeros) || !io_put_varint(io, i - start))
+            return false;
+
+        for (size_t pos = start; pos < i; pos += CHUNK_WORDS)
+        {
+            size_t count = RG_MIN((size_t)CHUNK_WORDS, i - pos);
+            for (size_t j = 0; j < count; j++)
+                chunk[j] = older[pos + j] ^ newer[pos + j];
+            if (!io_put(io, chunk, count * 4))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static void apply_delta(ring_io_t *io, uint32_t *state, size_t words)
+{
+    uint32_t chunk[CHUNK_WORDS];
+    size_t i = 0;
+
+    while (i < words && io->length < io->limit)
+    {
+        i += io_get_varint(io);
+
+        size_t literals = RG_MIN((size_t)io_get_varint(io), words - RG_MIN(i, words));
+
+        while (literals > 0)
+        {
+            size_t count = RG_MIN((size_t)CHUNK_WORDS, literals);
+            io_get(io, chunk, count * 4);
+            for (size_t j = 0; j < count; j++)
+                state[i + j] ^= chunk[j];
+            literals -= count;
+            i += count;
+        }
+    }
+}
+
+static bool rewind_alloc(void)
+{
+    size_t size = rg_emu_get_state_size();
+
+    if (size == 0)
+    {
+        RG_LOGW("The emulator can't save its state to memory, rewind disabled.\n");
+        return false;
+    }
+
+    // Some cores' states grow a little (mapper blocks, etc), leave some room
+    rw.capacity = (size + size / 8 + 3) & ~3;
+    rw.limit = rw.capacity + rw.capacity / 4 + 16;
+    rw.ring_size = RG_REWIND_RING_SIZE;
+    rw.current = heap_caps_calloc(1, rw.capacity, MALLOC_CAP_SPIRAM);
+    rw.scratch = heap_caps_calloc(1, rw.capacity, MALLOC_CAP_SPIRAM);
+    rw.ring = heap_caps_malloc(rw.ring_size, MALLOC_CAP_SPIRAM);
+
+    if (!rw.current || !rw.scratch || !rw.ring || rw.ring_size < (rw.limit + ENTRY_OVERHEAD) * 2)
+    {
+        RG_LOGW("Not enough memory for rewind (state is %d bytes).\n", size);
+        rg_rewind_deinit();
+        return false;
+    }
+
+    RG_LOGI("Rewind ready: state=%d bytes, ring=%d bytes.\n", size, rw.ring_size);
+
+    return true;
+}
+
+static void take_snapshot(void)
+{
+    size_t length = rw.capacity;
+
+    rw.frames = 0;
+    rw.loaded = false;
+
+    if (!rg_emu_save_state_mem(rw.scratch, &length))
+    {
+        RG_LOGW("Snapshot failed (%d bytes).\n", length);
+        return;
+    }
+
+    memset((uint8_t *)rw.scratch + length, 0, rw.capacity - length);
+
+    if (rw.have_current)
+    {
+        // Make sure the worst case fits, the encoder is bounded so it can't overrun the tail
+        while (rw.count > 0 && rw.used + rw.limit + ENTRY_OVERHEAD > rw.ring_size)
+            drop_oldest();
+
+        ring_io_t io = {rw.head + 2 * sizeof(uint32_t), 0, rw.limit};
+
+        if (encode_delta(&io, rw.current, rw.scratch, rw.capacity / 4))
+        {
+            uint32_t header[2] = {io.length, rw.current_len};
+            uint32_t trailer = io.length;
+
+            ring_write(rw.head, header, sizeof(header));
+            ring_write(io.pos + io.length, &trailer, sizeof(trailer));
+
+            rw.head = (rw.head + io.length + ENTRY_OVERHEAD) % rw.ring_size;
+            rw.used += io.length + ENTRY_OVERHEAD;
+            rw.count++;
+        }
+        else
+        {
+            // Should never happen, but the chain is broken if it does
+            RG_LOGE("Delta too large, history cleared.\n");
+            rw.used = rw.count = 0;
+        }
+    }
+
+    uint32_t *temp = rw.current;
+    rw.current = rw.scratch;
+    rw.scratch = temp;
+    rw.current_len = length;
+    rw.have_current = true;
+}
+
+static void step_back(void)
+{
+    if (!rw.have_current)
+        return;
+
+    // The first step returns to the latest snapshot, the following ones go through the deltas.
+    // Once we run out we stay on the oldest snapshot.
+    if (rw.loaded && rw.count > 0)
+    {
+        uint32_t trailer, header[2];
+        size_t entry = rw.head + rw.ring_size - sizeof(trailer);
+
+        ring_read(entry, &trailer, sizeof(trailer));
+        entry = rw.head + rw.ring_size - trailer - ENTRY_OVERHEAD;
+        ring_read(entry, header, sizeof(header));
+
+        ring_io_t io = {entry + sizeof(header), 0, header[0]};
+        apply_delta(&io, rw.current, rw.capacity / 4);
+
+        rw.head = entry % rw.ring_size;
+        rw.used -= trailer + ENTRY_OVERHEAD;
+        rw.count--;
+        rw.current_len = header[1];
+    }
+
+    if (!rg_emu_load_state_mem(rw.current, rw.current_len))
+    {
+        RG_LOGE("Failed to restore snapshot, history cleared.\n");
+        rw.used = rw.count = 0;
+        rw.have_current = false;
+    }
+
+    rw.loaded = true;
+    rw.frames = 0;
+}
+
+void rg_rewind_init(void)
+{
+    rg_rewind_deinit();
+    rw.enabled = rg_settings_get_app_int32(SETTING_REWIND, 0);
+}
+
+void rg_rewind_deinit(void)
+{
+    free(rw.current);
+    free(rw.scratch);
+    free(rw.ring);
+    memset(&rw, 0, sizeof(rw));
+}
+
+void rg_rewind_set_enabled(bool enabled)
+{
+    rg_settings_set_app_int32(SETTING_REWIND, enabled);
+    rg_rewind_init();
+}
+
+bool rg_rewind_get_enabled(void)
+{
+    return rw.enabled;
+}
+
+IRAM_ATTR int rg_rewind_tick(void)
+{
+    if (!rw.enabled || rw.failed || rg_golden_get_status().mode != RG_GOLDEN_OFF)
+        return 0;
+
+    if (!rw.held && ++rw.frames < RG_REWIND_INTERVAL)
+        return 0;
+
+    int64_t startTime = get_elapsed_time();
+
+    if (!rw.ring && !rewind_alloc())
+    {
+        rw.failed = true;
+        return 0;
+    }
+
+    if (rw.held)
+        step_back();
+    else
+        take_snapshot();
+
+    return get_elapsed_time_since(startTime);
+}
+
+// Only the once per frame read decides whether we rewind, the late-latch reads made during that
+// frame just hide the keys from the game. Menu reads don't go through here at all.
+IRAM_ATTR void rg_rewind_input(gamepad_state_t *state, bool frame)
+{
+    if (!rw.enabled)
+        return;
+
+    if (!frame)
+    {
+        if (rw.held)
+            *state &= ~RG_REWIND_KEYS;
+        return;
+    }
+
+    bool held = (*state & RG_REWIND_KEYS) == RG_REWIND_KEYS;
+
+    if (held)
+        *state &= ~RG_REWIND_KEYS;
+    else if (rw.held)
+        rw.loaded = false; // Resume from the snapshot we stopped on
+
+    rw.held = held;
+}
+
+rg_rewind_status_t rg_rewind_get_status(void)
+{
+    return (rg_rewind_status_t){
+        .enabled = rw.enabled,
+        .rewinding = rw.held,
+        .stateSize = rw.current_len,
+        .used = rw.used,
+        .snapshots = rw.count,
+        .depth = (rw.count + rw.have_current) * RG_REWIND_INTERVAL,
+    };
+}
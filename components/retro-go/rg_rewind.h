@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rg_input.h"
+
+// Holding these keys steps the game back in time, they are hidden from the emulator meanwhile
+#define RG_REWIND_KEYS (GAMEPAD_KEY_SELECT | GAMEPAD_KEY_LEFT)
+
+#define RG_REWIND_INTERVAL   3               // Frames between snapshots
+#define RG_REWIND_RING_SIZE  (1024 * 1024)   // Bytes of PSRAM for the deltas
+
+typedef struct
+{
+    bool enabled;
+    bool rewinding;
+    size_t stateSize;       // Bytes of a full snapshot
+    size_t used;            // Bytes of the ring holding deltas
+    uint32_t snapshots;     // Deltas in the ring
+    uint32_t depth;         // Frames of history available
+} rg_rewind_status_t;
+
+void rg_rewind_init(void);
+void rg_rewind_deinit(void);
+void rg_rewind_set_enabled(bool enabled);
+bool rg_rewind_get_enabled(void);
+int  rg_rewind_tick(void);
+void rg_rewind_input(gamepad_state_t *state, bool frame);
+rg_rewind_status_t rg_rewind_get_status(void);
@@ -0,0 +1,243 @@
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <esp_heap_caps.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "rg_system.h"
+#include "rg_rom.h"
+
+// ROM staging.
+//
+// Cores normally copy the ROM (or its banks) to the heap. With staging enabled the launcher
+// writes the ROM to a flash data partition first, and the core maps it through the flash cache
+// instead: no heap is used and bank switches are pointer updates. Flash is slow to write and
+// wears out, so nothing is written when the same ROM is already staged, and otherwise only the
+// 64KB blocks that differ from the partition's content are erased and rewritten.
+//
+// Partition layout:
+//   0x00000 rom_header_t, alone in its sector, written last
+//   0x10000 ROM data, mappings must start on a 64KB boundary
+
+#define ROM_MAGIC       0x4D4F5252 // "RROM"
+#define ROM_VERSION     1
+#define ROM_DATA_OFFSET 0x10000
+#define ROM_BLOCK_SIZE  0x10000
+#define ROM_HEADER_SIZE 0x1000
+
+#define SETTING_ROM_STAGING "RomStaging"
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t crc;           // The launcher's checksum of the file, 0 if it wasn't known
+    int64_t mtime;
+    char path[256];
+} rom_header_t;
+
+static spi_flash_mmap_handle_t mapping;
+static bool mapped;
+
+
+static const esp_partition_t *rom_partition(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, RG_ROM_PARTITION);
+}
+
+static bool rom_read_header(const esp_partition_t *part, rom_header_t *header)
+{
+    if (esp_partition_read(part, 0, header, sizeof(rom_header_t)) != ESP_OK)
+        return false;
+
+    header->path[sizeof(header->path) - 1] = 0;
+
+    return header->magic == ROM_MAGIC && header->version == ROM_VERSION;
+}
+
+static bool rom_write_header(const esp_partition_t *part, const rom_header_t *header)
+{
+    if (esp_partition_erase_range(part, 0, ROM_HEADER_SIZE) != ESP_OK)
+        return false;
+
+    return header == NULL || esp_partition_write(part, 0, header, sizeof(rom_header_t)) == ESP_OK;
+}
+
+// Returns true if the block was rewritten
+static bool rom_write_block(const esp_partition_t *part, size_t offset, const uint8_t *data, size_t length, bool *error)
+{
+    uint8_t current[512];
+
+    for (size_t pos = 0; pos < length; pos += sizeof(current))
+    {
+        size_t len = RG_MIN(length - pos, sizeof(current));
+        if (esp_partition_read(part, offset + pos, current, len) != ESP_OK || memcmp(current, data + pos, len) != 0)
+        {
+            *error = esp_partition_erase_range(part, offset, ROM_BLOCK_SIZE) != ESP_OK
+                  || esp_partition_write(part, offset, data, length) != ESP_OK;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool rg_rom_stage(const char *path, uint32_t crc)
+{
+    const esp_partition_t *part = rom_partition();
+    size_t written = 0, pos = 0;
+    rom_header_t header;
+    uint8_t *buffer;
+    bool error = false;
+    struct stat st;
+    FILE *fp;
+
+    if (!part)
+    {
+        RG_LOGW("No '%s' partition, ROM staging is unavailable.\n", RG_ROM_PARTITION);
+        return false;
+    }
+
+    if (!path || stat(path, &st) != 0)
+        return false;
+
+    if (st.st_size > ((part->size - ROM_DATA_OFFSET) & ~(ROM_BLOCK_SIZE - 1)) || strlen(path) >= sizeof(header.path))
+    {
+        RG_LOGW("'%s' doesn't fit in the staging partition.\n", path);
+        return false;
+    }
+
+    if (rom_read_header(part, &header) && header.size == st.st_size)
+    {
+        if (header.mtime == st.st_mtime && strcmp(header.path, path) == 0)
+        {
+            RG_LOGI("'%s' is already staged.\n", path);
+            return true;
+        }
+
+        // Same ROM from another file (a copy, a renamed file), only the header changes
+        if (crc && header.crc == crc)
+        {
+            strcpy(header.path, path);
+            header.mtime = st.st_mtime;
+            RG_LOGI("'%s' is already staged (crc=%08X).\n", path, crc);
+            return rom_write_header(part, &header);
+        }
+    }
+
+    if (!(fp = fopen(path, "rb")))
+        return false;
+
+    if (!(buffer = heap_caps_malloc(ROM_BLOCK_SIZE, MALLOC_CAP_SPIRAM) ?: malloc(ROM_BLOCK_SIZE)))
+    {
+        fclose(fp);
+        return false;
+    }
+
+    RG_LOGI("Staging '%s' (%d bytes)...\n", path, (int)st.st_size);
+
+    int64_t start = get_elapsed_time();
+
+    // Until the header is back, the partition content doesn't belong to anyone
+    error = !rom_write_header(part, NULL);
+
+    while (!error && pos < st.st_size)
+    {
+        size_t length = rg_file_read(fp, buffer, RG_MIN(st.st_size - pos, (size_t)ROM_BLOCK_SIZE));
+        if (length == 0)
+        {
+            error = true;
+            break;
+        }
+        // Cores may read a little past the end (rounding to their bank size), it should be zeros
+        // like in a freshly allocated buffer, not what the previous ROM left there
+        memset(buffer + length, 0, ROM_BLOCK_SIZE - length);
+        written += rom_write_block(part, ROM_DATA_OFFSET + pos, buffer, ROM_BLOCK_SIZE, &error);
+        pos += length;
+    }
+
+    fclose(fp);
+    free(buffer);
+
+    if (!error)
+    {
+        header = (rom_header_t){ROM_MAGIC, ROM_VERSION, st.st_size, crc, st.st_mtime, {0}};
+        strcpy(header.path, path);
+        error = !rom_write_header(part, &header);
+    }
+
+    if (error)
+    {
+        RG_LOGE("ROM staging failed at offset %d!\n", pos);
+        return false;
+    }
+
+    RG_LOGI("ROM staged, %d/%d blocks rewritten in %dms.\n", written,
+        (int)((st.st_size + ROM_BLOCK_SIZE - 1) / ROM_BLOCK_SIZE), (int)(get_elapsed_time_since(start) / 1000));
+
+    return true;
+}
+
+const void *rg_rom_map(const char *path, size_t *size)
+{
+    const esp_partition_t *part = rom_partition();
+    const void *ptr = NULL;
+    rom_header_t header;
+    struct stat st;
+
+    rg_rom_unmap();
+
+    if (!part || !path || !rg_rom_get_staging())
+        return NULL;
+
+    if (!rom_read_header(part, &header) || strcmp(header.path, path) != 0)
+        return NULL;
+
+    // The file was modified since it was staged
+    if (stat(path, &st) != 0 || st.st_size != header.size || st.st_mtime != header.mtime)
+    {
+        RG_LOGW("Staged copy of '%s' is outdated, not using it.\n", path);
+        return NULL;
+    }
+
+    size_t map_size = (header.size + ROM_BLOCK_SIZE - 1) & ~(ROM_BLOCK_SIZE - 1);
+
+    // The data cache can only map a few MB and the app's own rodata takes some of it
+    if (esp_partition_mmap(part, ROM_DATA_OFFSET, RG_MAX(map_size, (size_t)ROM_BLOCK_SIZE),
+            SPI_FLASH_MMAP_DATA, &ptr, &mapping) != ESP_OK)
+    {
+        RG_LOGW("Unable to map %d bytes of staged ROM, the data window is too small. The core will load it to RAM.\n", map_size);
+        return NULL;
+    }
+
+    RG_LOGI("Mapped staged ROM '%s' at %p (%d bytes).\n", path, ptr, header.size);
+
+    mapped = true;
+
+    if (size)
+        *size = header.size;
+
+    return ptr;
+}
+
+void rg_rom_unmap(void)
+{
+    if (mapped)
+    {
+        spi_flash_munmap(mapping);
+        mapped = false;
+    }
+}
+
+void rg_rom_set_staging(bool enable)
+{
+    rg_settings_set_int32(SETTING_ROM_STAGING, enable);
+}
+
+bool rg_rom_get_staging(void)
+{
+    return rg_settings_get_int32(SETTING_ROM_STAGING, false) && rom_partition() != NULL;
+}
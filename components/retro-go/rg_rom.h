@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RG_ROM_PARTITION "romcache"
+
+bool rg_rom_stage(const char *path, uint32_t crc);
+const void *rg_rom_map(const char *path, size_t *size);
+void rg_rom_unmap(void);
+void rg_rom_set_staging(bool enable);
+bool rg_rom_get_staging(void);
@@ -1,18 +1,43 @@
+#define _GNU_SOURCE // fopencookie
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_vfs_fat.h>
 #include <esp_event.h>
+#include <esp_heap_caps.h>
+#include <driver/sdmmc_defs.h>
+#include <soc/soc_memory_layout.h>
+#include <sdmmc_cmd.h>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "rg_system.h"
 
 #define SETTING_DISK_ACTIVITY "DiskActivity"
 
+// Longest read done in one go. The SD card and the LCD share the bus, a 16KB bank takes over 6ms
+// to transfer and the display would have to wait for all of it.
+#define SDCARD_READ_CHUNK_BLOCKS 8
+
+// Transfer test done on each candidate clock, and repeated to catch intermittent errors
+#define SDCARD_PROBE_SECTORS 32
+#define SDCARD_PROBE_PASSES  2
+
 static sdmmc_card_t *card = NULL;
+static int cardFreq = 0;
 static int diskActivity = -1;
 
+static RTC_NOINIT_ATTR struct
+{
+    uint32_t magic;
+    uint32_t serial;
+    int freq_khz;
+} probedClock;
+
 
 void rg_sdcard_set_enable_activity_led(bool enable)
 {
@@ -27,10 +52,47 @@ bool rg_sdcard_get_enable_activity_led(void)
     return diskActivity;
 }
 
+static esp_err_t sdcard_do_chunked_read(int slot, sdmmc_command_t *cmdinfo)
+{
+    // SDHC/SDXC cards are addressed in blocks, older ones in bytes
+    size_t unit = (card->ocr & SD_OCR_SDHC_CAP) ? 1 : cmdinfo->blklen;
+    size_t chunk_size = SDCARD_READ_CHUNK_BLOCKS * cmdinfo->blklen;
+    esp_err_t ret = ESP_OK;
+
+    // Each chunk is a complete multiple block read, the lock is released between them
+    for (size_t pos = 0; pos < cmdinfo->datalen && ret == ESP_OK; pos += chunk_size)
+    {
+        sdmmc_command_t chunk = *cmdinfo;
+        chunk.data = (uint8_t *)cmdinfo->data + pos;
+        chunk.datalen = RG_MIN(cmdinfo->datalen - pos, chunk_size);
+        chunk.arg = cmdinfo->arg + (pos / cmdinfo->blklen) * unit;
+
+        rg_spi_lock_acquire(SPI_LOCK_SDCARD);
+        ret = sdspi_host_do_transaction(slot, &chunk);
+        rg_spi_lock_release(SPI_LOCK_SDCARD);
+
+        memcpy(cmdinfo->response, chunk.response, sizeof(cmdinfo->response));
+        cmdinfo->error = chunk.error;
+    }
+
+    return ret;
+}
+
 static esp_err_t sdcard_do_transaction(int slot, sdmmc_command_t *cmdinfo)
 {
     bool use_led = (rg_sdcard_get_enable_activity_led() && !rg_system_get_led());
 
+    if (card && cmdinfo->opcode == MMC_READ_BLOCK_MULTIPLE && cmdinfo->blklen > 0
+        && cmdinfo->datalen > SDCARD_READ_CHUNK_BLOCKS * cmdinfo->blklen)
+    {
+        if (use_led)
+            rg_system_set_led(1);
+        esp_err_t ret = sdcard_do_chunked_read(slot, cmdinfo);
+        if (use_led)
+            rg_system_set_led(0);
+        return ret;
+    }
+
     rg_spi_lock_acquire(SPI_LOCK_SDCARD);
 
     if (use_led)
@@ -46,7 +108,7 @@ static esp_err_t sdcard_do_transaction(int slot, sdmmc_command_t *cmdinfo)
     return ret;
 }
 
-bool rg_sdcard_mount(void)
+static bool sdcard_mount_at(int freq_khz)
 {
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,
@@ -60,7 +122,7 @@ bool rg_sdcard_mount(void)
 
     sdmmc_host_t host_config = SDSPI_HOST_DEFAULT();
     host_config.slot = HSPI_HOST;
-    host_config.max_freq_khz = SDMMC_FREQ_DEFAULT; // SDMMC_FREQ_26M;
+    host_config.max_freq_khz = freq_khz;
     host_config.do_transaction = &sdcard_do_transaction;
 
     sdspi_slot_config_t slot_config = SDSPI_SLOT_CONFIG_DEFAULT();
@@ -73,7 +135,7 @@ bool rg_sdcard_mount(void)
 
     sdmmc_host_t host_config = SDMMC_HOST_DEFAULT();
     host_config.flags = SDMMC_HOST_FLAG_1BIT;
-    host_config.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+    host_config.max_freq_khz = freq_khz;
 
     sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
     slot_config.width = 1;
@@ -91,7 +153,8 @@ bool rg_sdcard_mount(void)
 
     if (err == ESP_OK)
     {
-        RG_LOGI("SD Card mounted. serial=%08X\n", card->cid.serial);
+        RG_LOGI("SD Card mounted. serial=%08X, freq=%dkHz\n", card->cid.serial, freq_khz);
+        cardFreq = freq_khz;
         return true;
     }
     else
@@ -102,6 +165,83 @@ bool rg_sdcard_mount(void)
     }
 }
 
+// Reads the start of the FAT partition, the boot sector and the first FAT sectors are rarely
+// all zeros. The transfers themselves are CRC16 checked by the driver.
+static bool sdcard_probe_read(uint8_t *buffer, uint32_t *crc)
+{
+    size_t start = 0;
+
+    if (sdmmc_read_sectors(card, buffer, 0, 1) != ESP_OK)
+        return false;
+
+    if (buffer[510] == 0x55 && buffer[511] == 0xAA)
+        start = buffer[0x1C6] | (buffer[0x1C7] << 8) | (buffer[0x1C8] << 16) | (buffer[0x1C9] << 24);
+
+    if (start >= card->csd.capacity)
+        start = 0;
+
+    for (int i = 0; i < SDCARD_PROBE_PASSES; i++)
+    {
+        if (sdmmc_read_sectors(card, buffer, start, SDCARD_PROBE_SECTORS) != ESP_OK)
+            return false;
+
+        uint32_t value = crc32_le(0, buffer, SDCARD_PROBE_SECTORS * 512);
+        if (i > 0 && value != *crc)
+            return false;
+        *crc = value;
+    }
+
+    return true;
+}
+
+bool rg_sdcard_mount(void)
+{
+    const int freqs[] = {SDMMC_FREQ_HIGHSPEED, SDMMC_FREQ_26M, SDMMC_FREQ_DEFAULT};
+    const int safe_freq = RG_DRIVER_SDCARD == 1 ? SDMMC_FREQ_DEFAULT : SDMMC_FREQ_HIGHSPEED;
+    uint32_t reference = 0, crc = 0;
+    uint8_t *buffer = NULL;
+
+    // A clock that passed the probe is remembered until the next power cycle
+    if (probedClock.magic == RG_STRUCT_MAGIC && probedClock.freq_khz > 0)
+    {
+        if (sdcard_mount_at(probedClock.freq_khz) && card->cid.serial == probedClock.serial)
+            return true;
+        probedClock.magic = 0;
+    }
+
+    if (!sdcard_mount_at(safe_freq))
+        return false;
+
+    buffer = heap_caps_malloc(SDCARD_PROBE_SECTORS * 512, MALLOC_CAP_DMA);
+
+    if (buffer && sdcard_probe_read(buffer, &reference))
+    {
+        for (int i = 0; i < sizeof(freqs) / sizeof(freqs[0]) && freqs[i] > safe_freq; i++)
+        {
+            if (sdcard_mount_at(freqs[i]) && sdcard_probe_read(buffer, &crc) && crc == reference)
+                break;
+            RG_LOGW("SD Card failed the read test at %dkHz.\n", freqs[i]);
+            if (!sdcard_mount_at(safe_freq))
+                break;
+        }
+    }
+    else
+    {
+        RG_LOGW("SD Card read test couldn't run, staying at %dkHz.\n", safe_freq);
+    }
+
+    free(buffer);
+
+    if (!card && !sdcard_mount_at(safe_freq))
+        return false;
+
+    probedClock.magic = RG_STRUCT_MAGIC;
+    probedClock.serial = card->cid.serial;
+    probedClock.freq_khz = cardFreq;
+
+    return true;
+}
+
 bool rg_sdcard_unmount(void)
 {
     esp_err_t err = esp_vfs_fat_sdmmc_unmount();
@@ -259,3 +399,525 @@ const char *rg_extension(const char *path)
     const char *ext = strrchr(basename, '.');
     return ext ? ext + 1 : NULL;
 }
+
+typedef struct
+{
+    uint8_t *buffer;
+    size_t size;        // Capacity of buffer
+    size_t length;      // Furthest byte written (or size when reading)
+    size_t pos;
+} memfile_t;
+
+#ifdef __NEWLIB__
+typedef _off64_t memfile_off_t;
+#else
+typedef off64_t memfile_off_t;
+#endif
+
+static ssize_t memfile_read(void *cookie, char *buf, size_t size)
+{
+    memfile_t *mf = cookie;
+    size = RG_MIN(size, mf->length - RG_MIN(mf->pos, mf->length));
+    memcpy(buf, mf->buffer + mf->pos, size);
+    mf->pos += size;
+    return size;
+}
+
+static ssize_t memfile_write(void *cookie, const char *buf, size_t size)
+{
+    memfile_t *mf = cookie;
+    size = RG_MIN(size, mf->size - RG_MIN(mf->pos, mf->size));
+    if (size == 0)
+        return -1;
+    if (mf->buffer)
+        memcpy(mf->buffer + mf->pos, buf, size);
+    mf->pos += size;
+    mf->length = RG_MAX(mf->length, mf->pos);
+    return size;
+}
+
+static int memfile_seek(void *cookie, memfile_off_t *offset, int whence)
+{
+    memfile_t *mf = cookie;
+    memfile_off_t pos = *offset;
+
+    if (whence == SEEK_CUR)
+        pos += mf->pos;
+    else if (whence == SEEK_END)
+        pos += mf->length;
+
+    if (pos < 0 || pos > mf->size)
+        return -1;
+
+    mf->pos = *offset = pos;
+    return 0;
+}
+
+static int memfile_close(void *cookie)
+{
+    free(cookie);
+    return 0;
+}
+
+FILE *rg_fmemopen(void *buffer, size_t size, const char *mode)
+{
+    memfile_t *mf = calloc(1, sizeof(memfile_t));
+    bool reading = mode[0] == 'r';
+    FILE *fp;
+
+    if (!mf || (!buffer && reading))
+    {
+        free(mf);
+        return NULL;
+    }
+
+    mf->buffer = buffer;
+    mf->size = buffer ? size : SIZE_MAX;
+    mf->length = reading ? size : 0;
+
+    fp = fopencookie(mf, mode, (cookie_io_functions_t){
+        .read = memfile_read,
+        .write = memfile_write,
+        .seek = memfile_seek,
+        .close = memfile_close,
+    });
+
+    if (!fp)
+    {
+        free(mf);
+        return NULL;
+    }
+
+    // The data is already in RAM, stdio's buffer would only add a copy
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    return fp;
+}
+
+bool rg_fmemclose(FILE *fp, size_t *length)
+{
+    if (!fp)
+        return false;
+
+    bool success = !ferror(fp);
+
+    if (length && fseek(fp, 0, SEEK_END) == 0)
+        *length = ftell(fp);
+
+    return (fclose(fp) == 0) && success;
+}
+
+// Read cache shared by the files opened with rg_file_open.
+//
+// The cache is a pool of fixed size blocks in PSRAM, keyed by file and block index and evicted
+// least recently used first. A miss following the previous read is treated as sequential and
+// reads a whole window ahead. The card is always read through a small DMA capable bounce buffer,
+// because the SD driver falls back to one sector per transaction when given a PSRAM buffer.
+//
+// A file is identified by its path, size and modification time, so that blocks of a file that
+// was rewritten in the meantime are never returned. Opening a file for writing drops its blocks.
+
+typedef struct
+{
+    uint32_t file;          // Hash of the path
+    uint32_t version;       // Hash of the size and mtime
+    uint32_t index;
+    uint32_t used;          // LRU clock, 0 when the block is free
+    size_t length;          // Shorter than block_size at the end of the file
+} file_block_t;
+
+typedef struct
+{
+    FILE *fp;               // The actual file, unbuffered
+    uint32_t file;
+    uint32_t version;
+    size_t size;
+    size_t pos;
+    size_t window;          // Blocks read at once on sequential misses
+    uint32_t next_index;    // Where a sequential read would continue
+    file_block_t *last;
+} cached_file_t;
+
+static struct
+{
+    uint8_t *data;
+    uint8_t *bounce;
+    file_block_t *blocks;
+    size_t count;
+    size_t block_size;
+    uint32_t clock;
+    int open_files;
+    SemaphoreHandle_t lock;
+    rg_file_stats_t stats;
+} fcache;
+
+static uint32_t fcache_hash(uint32_t hash, const void *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ ((const uint8_t *)data)[i]) * 0x01000193; // FNV-1a
+    return hash;
+}
+
+// Must be called with fcache.lock held
+static void fcache_invalidate(uint32_t file, uint32_t version)
+{
+    for (size_t i = 0; i < fcache.count; i++)
+    {
+        if (fcache.blocks[i].used && fcache.blocks[i].file == file && fcache.blocks[i].version != version)
+            fcache.blocks[i].used = 0;
+    }
+}
+
+// Must be called with fcache.lock held
+static file_block_t *fcache_find(cached_file_t *f, uint32_t index)
+{
+    file_block_t *block = f->last;
+
+    if (!block || block->used == 0 || block->file != f->file || block->index != index || block->version != f->version)
+    {
+        block = NULL;
+        for (size_t i = 0; i < fcache.count; i++)
+        {
+            file_block_t *b = &fcache.blocks[i];
+            if (b->used && b->index == index && b->file == f->file && b->version == f->version)
+            {
+                block = b;
+                break;
+            }
+        }
+    }
+
+    if (block)
+        block->used = ++fcache.clock;
+
+    return block;
+}
+
+// Must be called with fcache.lock held
+static file_block_t *fcache_fill(cached_file_t *f, uint32_t index, size_t wanted)
+{
+    size_t last_index = (f->size + fcache.block_size - 1) / fcache.block_size;
+    size_t count = RG_MAX(wanted, index == f->next_index ? f->window : 1);
+    file_block_t *first = NULL;
+
+    // Never let a single read evict more than half the cache
+    count = RG_MIN(count, RG_MIN(last_index - index, fcache.count / 2));
+    count = RG_MAX(count, 1u);
+
+    if (fseek(f->fp, index * fcache.block_size, SEEK_SET) != 0)
+        return NULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // The rest of the run is already there
+        if (i > 0 && fcache_find(f, index + i))
+            break;
+
+        file_block_t *block = &fcache.blocks[0];
+        for (size_t j = 1; j < fcache.count && block->used; j++)
+        {
+            if (fcache.blocks[j].used < block->used)
+                block = &fcache.blocks[j];
+        }
+
+        size_t length = fread(fcache.bounce, 1, fcache.block_size, f->fp);
+        if (length == 0)
+            break;
+
+        memcpy(fcache.data + (block - fcache.blocks) * fcache.block_size, fcache.bounce, length);
+        *block = (file_block_t){f->file, f->version, index + i, ++fcache.clock, length};
+
+        fcache.stats.reads++;
+        fcache.stats.bytes += length;
+        if (i > 0)
+            fcache.stats.readahead++;
+        if (!first)
+            first = block;
+
+        f->next_index = index + i + 1;
+    }
+
+    return first;
+}
+
+static ssize_t cached_file_read(void *cookie, char *buf, size_t size)
+{
+    cached_file_t *f = cookie;
+    size_t done = 0;
+
+    size = RG_MIN(size, f->size - RG_MIN(f->pos, f->size));
+
+    xSemaphoreTake(fcache.lock, portMAX_DELAY);
+
+    while (done < size)
+    {
+        uint32_t index = f->pos / fcache.block_size;
+        size_t offset = f->pos % fcache.block_size;
+        file_block_t *block = fcache_find(f, index);
+
+        if (block)
+        {
+            fcache.stats.hits++;
+        }
+        else
+        {
+            size_t wanted = (offset + size - done + fcache.block_size - 1) / fcache.block_size;
+            if (!(block = fcache_fill(f, index, wanted)))
+                break;
+            fcache.stats.misses++;
+        }
+
+        if (block->length <= offset)
+            break;
+
+        size_t length = RG_MIN(size - done, block->length - offset);
+        memcpy(buf + done, fcache.data + (block - fcache.blocks) * fcache.block_size + offset, length);
+        f->last = block;
+        f->pos += length;
+        done += length;
+    }
+
+    xSemaphoreGive(fcache.lock);
+
+    if (done == 0 && size > 0)
+        return -1;
+
+    return done;
+}
+
+static int cached_file_seek(void *cookie, memfile_off_t *offset, int whence)
+{
+    cached_file_t *f = cookie;
+    memfile_off_t pos = *offset;
+
+    if (whence == SEEK_CUR)
+        pos += f->pos;
+    else if (whence == SEEK_END)
+        pos += f->size;
+
+    if (pos < 0 || pos > f->size)
+        return -1;
+
+    f->pos = *offset = pos;
+    return 0;
+}
+
+static int cached_file_close(void *cookie)
+{
+    cached_file_t *f = cookie;
+    int ret = fclose(f->fp);
+
+    xSemaphoreTake(fcache.lock, portMAX_DELAY);
+    fcache.open_files--;
+    xSemaphoreGive(fcache.lock);
+
+    free(f);
+    return ret;
+}
+
+bool rg_file_cache_init(size_t cache_size, size_t block_size)
+{
+    if (!fcache.lock)
+        fcache.lock = xSemaphoreCreateMutex();
+
+    xSemaphoreTake(fcache.lock, portMAX_DELAY);
+
+    if (fcache.open_files > 0)
+    {
+        RG_LOGE("Can't resize the file cache while files are open!\n");
+        xSemaphoreGive(fcache.lock);
+        return false;
+    }
+
+    free(fcache.data);
+    free(fcache.bounce);
+    free(fcache.blocks);
+
+    fcache.block_size = RG_MAX(block_size, (size_t)512);
+    fcache.count = cache_size / fcache.block_size;
+    fcache.data = NULL;
+    fcache.bounce = NULL;
+    fcache.blocks = NULL;
+
+    if (fcache.count >= 2)
+    {
+        fcache.data = heap_caps_malloc(fcache.count * fcache.block_size, MALLOC_CAP_SPIRAM);
+        fcache.bounce = heap_caps_malloc(fcache.block_size, MALLOC_CAP_DMA);
+        fcache.blocks = calloc(fcache.count, sizeof(file_block_t));
+    }
+
+    if (!fcache.data || !fcache.bounce || !fcache.blocks)
+    {
+        free(fcache.data);
+        free(fcache.bounce);
+        free(fcache.blocks);
+        fcache.data = fcache.bounce = NULL;
+        fcache.blocks = NULL;
+        fcache.count = 0;
+    }
+
+    memset(&fcache.stats, 0, sizeof(fcache.stats));
+    fcache.clock = 0;
+
+    xSemaphoreGive(fcache.lock);
+
+    if (fcache.count > 0)
+        RG_LOGI("File cache ready. blocks=%d, block_size=%d\n", fcache.count, fcache.block_size);
+    else if (cache_size > 0)
+        RG_LOGW("Not enough memory for the file cache, files won't be cached.\n");
+
+    return fcache.count > 0;
+}
+
+FILE *rg_file_open(const char *path, const char *mode, size_t buffer_size)
+{
+    bool reading = mode[0] == 'r' && !strchr(mode, '+');
+    uint32_t file = fcache_hash(0x811C9DC5, path, strlen(path));
+    cached_file_t *f = NULL;
+    struct stat st;
+    FILE *fp;
+
+    if (!fcache.lock)
+        rg_file_cache_init(RG_FILE_CACHE_SIZE, RG_FILE_BLOCK_SIZE);
+
+    if (!(fp = fopen(path, mode)))
+        return NULL;
+
+    if (!reading || !fcache.count || stat(path, &st) != 0 || !(f = calloc(1, sizeof(cached_file_t))))
+    {
+        if (!reading)
+        {
+            xSemaphoreTake(fcache.lock, portMAX_DELAY);
+            fcache_invalidate(file, 0);
+            xSemaphoreGive(fcache.lock);
+        }
+        if (buffer_size)
+            setvbuf(fp, NULL, _IOFBF, buffer_size);
+        return fp;
+    }
+
+    // The cache does our buffering
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    f->fp = fp;
+    f->file = file;
+    f->version = fcache_hash(fcache_hash(0x811C9DC5, &st.st_size, sizeof(st.st_size)), &st.st_mtime, sizeof(st.st_mtime));
+    f->version |= 1; // Never 0, that's the invalidate-all version
+    f->size = st.st_size;
+    f->window = ((buffer_size ? buffer_size : RG_FILE_READAHEAD) + fcache.block_size - 1) / fcache.block_size;
+    f->next_index = 0;
+
+    xSemaphoreTake(fcache.lock, portMAX_DELAY);
+    fcache_invalidate(f->file, f->version);
+    fcache.open_files++;
+    xSemaphoreGive(fcache.lock);
+
+    FILE *cfp = fopencookie(f, "rb", (cookie_io_functions_t){
+        .read = cached_file_read,
+        .seek = cached_file_seek,
+        .close = cached_file_close,
+    });
+
+    if (!cfp)
+    {
+        cached_file_close(f);
+        return NULL;
+    }
+
+    setvbuf(cfp, NULL, _IONBF, 0);
+
+    return cfp;
+}
+
+rg_file_stats_t rg_file_get_stats(void)
+{
+    return fcache.stats;
+}
+
+size_t rg_file_read(FILE *fp, void *buffer, size_t size)
+{
+    uint8_t *dst = buffer, *bounce = NULL;
+    size_t chunk_size = size, done = 0;
+    long pos = ftell(fp);
+    int fd = fileno(fp);
+
+    // Not a real file (rg_fmemopen, rg_file_open), stdio it is
+    if (fd < 0 || pos < 0)
+        return fread(buffer, 1, size, fp);
+
+    // The SD driver transfers straight into DMA capable memory, anything else goes one sector
+    // at a time. PSRAM destinations are filled through a bounce buffer instead.
+    if (!esp_ptr_dma_capable(buffer) || ((uintptr_t)buffer & 3))
+    {
+        chunk_size = RG_FILE_BOUNCE_SIZE;
+        while (chunk_size >= 2048 && !(bounce = heap_caps_malloc(chunk_size, MALLOC_CAP_DMA)))
+            chunk_size /= 2;
+        if (!bounce)
+            return fread(buffer, 1, size, fp);
+    }
+
+    // stdio may have read ahead of its position, we go by the fd from here
+    if (lseek(fd, pos, SEEK_SET) != pos)
+    {
+        free(bounce);
+        return fread(buffer, 1, size, fp);
+    }
+
+    while (done < size)
+    {
+        // After the first chunk the file position stays sector aligned, so FATFS never has to
+        // go through its own sector buffer
+        size_t length = RG_MIN(size - done, chunk_size - (done ? 0 : pos % 512));
+        ssize_t ret = read(fd, bounce ? bounce : dst + done, length);
+        if (ret <= 0)
+            break;
+        if (bounce)
+            memcpy(dst + done, bounce, ret);
+        done += ret;
+    }
+
+    free(bounce);
+
+    fseek(fp, pos + done, SEEK_SET);
+
+    return done;
+}
+
+int rg_sdcard_get_freq(void)
+{
+    return card ? cardFreq : 0;
+}
+
+float rg_sdcard_benchmark(size_t size)
+{
+    const size_t chunk_sectors = 32;
+    uint8_t *buffer = heap_caps_malloc(chunk_sectors * 512, MALLOC_CAP_DMA);
+    size_t sectors = size / 512;
+    int64_t start = get_elapsed_time();
+    float speed = 0.f;
+
+    if (!card || !buffer)
+    {
+        free(buffer);
+        return 0.f;
+    }
+
+    sectors = RG_MIN(sectors, (size_t)card->csd.capacity);
+
+    for (size_t sector = 0; sector < sectors; sector += chunk_sectors)
+    {
+        if (sdmmc_read_sectors(card, buffer, sector, RG_MIN(chunk_sectors, sectors - sector)) != ESP_OK)
+        {
+            RG_LOGE("SD Card benchmark failed at sector %d.\n", sector);
+            free(buffer);
+            return 0.f;
+        }
+    }
+
+    speed = (sectors * 512.f / (1024 * 1024)) / (get_elapsed_time_since(start) / 1000000.f);
+    free(buffer);
+
+    RG_LOGI("SD Card read %dKB at %.2f MB/s, freq=%dkHz\n", sectors / 2, speed, cardFreq);
+
+    return speed;
+}
@@ -9,6 +9,12 @@
 #define RG_BASE_PATH_CACHE     RG_BASE_PATH "/odroid/cache"
 #define RG_BASE_PATH_CONFIG    RG_BASE_PATH "/odroid"
 #define RG_BASE_PATH_ROMART    RG_BASE_PATH "/romart"
+#define RG_BASE_PATH_GOLDEN    RG_BASE_PATH "/odroid/golden"
+
+#define RG_FILE_CACHE_SIZE     0x20000 // Default cache size, allocated on the first rg_file_open
+#define RG_FILE_BLOCK_SIZE     0x1000
+#define RG_FILE_READAHEAD      0x4000  // Default read-ahead window on sequential reads
+#define RG_FILE_BOUNCE_SIZE    0x4000  // rg_file_read's chunk size for PSRAM destinations
 
 typedef enum
 {
@@ -25,11 +31,22 @@ typedef struct
     char buffer[];
 } rg_strings_t;
 
+typedef struct
+{
+    uint32_t hits;          // Reads served from the cache, by block
+    uint32_t misses;        // Reads that went to the card
+    uint32_t readahead;     // Blocks read ahead of the request
+    uint32_t reads;         // Blocks read from the card
+    uint32_t bytes;
+} rg_file_stats_t;
+
 bool rg_sdcard_mount(void);
 bool rg_sdcard_unmount(void);
 bool rg_sdcard_format(void);
 void rg_sdcard_set_enable_activity_led(bool enable);
 bool rg_sdcard_get_enable_activity_led(void);
+int rg_sdcard_get_freq(void);
+float rg_sdcard_benchmark(size_t size);
 
 rg_strings_t *rg_readdir(const char* path, int flags);
 bool rg_mkdir(const char *dir);
@@ -38,3 +55,18 @@ bool rg_mkdir(const char *dir);
 const char *rg_dirname(const char *path);
 const char *rg_basename(const char *path);
 const char* rg_extension(const char *path);
+
+// Like fmemopen but any number of seeks and writes are allowed. When writing to a NULL buffer
+// nothing is stored and the length reported by rg_fmemclose is the size the data would take.
+FILE *rg_fmemopen(void *buffer, size_t size, const char *mode);
+bool rg_fmemclose(FILE *fp, size_t *length);
+
+// Files opened for reading go through a shared block cache with read-ahead, the others are plain
+// stdio files. buffer_size is the read-ahead window for cached files, or the stdio buffer size
+// otherwise. 0 means the default.
+FILE *rg_file_open(const char *path, const char *mode, size_t buffer_size);
+bool rg_file_cache_init(size_t cache_size, size_t block_size);
+rg_file_stats_t rg_file_get_stats(void);
+
+// Like fread but in large sector aligned transfers, meant for ROM and state loads
+size_t rg_file_read(FILE *fp, void *buffer, size_t size);
@@ -1,4 +1,8 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <esp_err.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
@@ -7,76 +11,539 @@
 #include "rg_system.h"
 #include "rg_settings.h"
 
+// Settings live in a hash table of typed values, keyed by (scope, key). The store is a flat
+// binary file (or NVS blob) read in one go, no parsing involved. Saving is deferred: changes are
+// coalesced and written by settings_task once nothing changed for CONFIG_SAVE_DELAY ms, or right
+// away by rg_settings_commit() when switching apps.
+//
+// The JSON file is kept for users who want to edit their settings: it's only written by
+// rg_settings_export() and imported at boot when it's newer than the binary store.
+//
+// Binary layout:
+//   store_header_t
+//   store_record_t, scope, key, value   (repeated header.count times)
+
 #define USE_CONFIG_FILE (RG_DRIVER_SETTINGS == 1)
 
-#define CONFIG_FILE_PATH RG_BASE_PATH_CONFIG "/retro-go.json"
-#define CONFIG_NAMESPACE "retro-go"
-#define CONFIG_NVS_STORE "config"
+#define CONFIG_FILE_PATH  RG_BASE_PATH_CONFIG "/retro-go.json"
+#define CONFIG_STORE_PATH RG_BASE_PATH_CONFIG "/retro-go.bin"
+#define CONFIG_NAMESPACE  "retro-go"
+#define CONFIG_NVS_STORE  "config"
+#define CONFIG_NVS_BLOB   "store"
 #define CONFIG_VERSION    0x01
 
+#define STORE_MAGIC       0x46434752 // "RGCF"
+#define STORE_VERSION     1
+#define CONFIG_SAVE_DELAY 1000
+
 #if !USE_CONFIG_FILE
     #include <nvs_flash.h>
     static nvs_handle my_handle = 0;
 #endif
 
-static int unsaved_changes = 0;
-static cJSON *root = NULL;
-static cJSON *app_root = NULL;
+typedef enum
+{
+    SETTING_NONE = 0,   // Free slot
+    SETTING_INT32,
+    SETTING_STRING,
+} setting_type_t;
 
+typedef struct
+{
+    uint32_t hash;
+    uint8_t type;
+    char *scope;        // "" for global settings
+    char *key;
+    union {
+        int32_t i32;
+        char *str;
+    } value;
+} setting_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+} store_header_t;
 
-static cJSON *json_get(cJSON *root, const char *key)
+typedef struct
 {
-    if (!root)
+    uint32_t hash;
+    uint8_t type;
+    uint8_t scope_len;
+    uint8_t key_len;
+    uint8_t reserved;
+    uint32_t value_len;
+} store_record_t;
+
+static struct
+{
+    setting_t *table;
+    size_t capacity;        // Power of 2
+    size_t count;
+    char *scope;            // Scope of the app settings
+    int unsaved_changes;
+    int64_t last_change;
+    SemaphoreHandle_t lock;
+    TaskHandle_t task;
+} settings;
+
+
+static uint32_t hash_key(const char *scope, const char *key)
+{
+    uint32_t hash = 0x811C9DC5; // FNV-1a
+
+    for (const char *c = scope; *c; c++)
+        hash = (hash ^ (uint8_t)*c) * 0x01000193;
+    hash = (hash ^ '/') * 0x01000193;
+    for (const char *c = key; *c; c++)
+        hash = (hash ^ (uint8_t)*c) * 0x01000193;
+
+    return hash;
+}
+
+static void table_clear(void)
+{
+    for (size_t i = 0; i < settings.capacity; i++)
     {
-        RG_LOGW("Trying to get key '%s' before rg_settings_init() was called!\n", key);
-        return NULL;
+        setting_t *entry = &settings.table[i];
+        if (entry->type == SETTING_STRING)
+            free(entry->value.str);
+        if (entry->type != SETTING_NONE)
+        {
+            free(entry->scope);
+            free(entry->key);
+        }
     }
+    free(settings.table);
+    settings.table = NULL;
+    settings.capacity = settings.count = 0;
+}
 
-    return cJSON_GetObjectItem(root, key);
+static setting_t *table_slot(setting_t *table, size_t capacity, uint32_t hash, const char *scope, const char *key)
+{
+    for (size_t i = hash & (capacity - 1);; i = (i + 1) & (capacity - 1))
+    {
+        setting_t *entry = &table[i];
+        if (entry->type == SETTING_NONE)
+            return entry;
+        if (entry->hash == hash && strcmp(entry->key, key) == 0 && strcmp(entry->scope, scope) == 0)
+            return entry;
+    }
 }
 
-static void json_set(cJSON *root, const char *key, cJSON *value)
+static setting_t *table_find(const char *scope, const char *key, bool create)
 {
-    if (!root)
+    uint32_t hash = hash_key(scope, key);
+
+    if (!settings.table)
+    {
+        if (!create)
+            return NULL;
+        settings.capacity = 64;
+        settings.table = calloc(settings.capacity, sizeof(setting_t));
+    }
+    else if (create && (settings.count + 1) * 4 > settings.capacity * 3)
+    {
+        size_t capacity = settings.capacity * 2;
+        setting_t *table = calloc(capacity, sizeof(setting_t));
+
+        for (size_t i = 0; i < settings.capacity; i++)
+        {
+            setting_t *entry = &settings.table[i];
+            if (entry->type != SETTING_NONE)
+                *table_slot(table, capacity, entry->hash, entry->scope, entry->key) = *entry;
+        }
+
+        free(settings.table);
+        settings.table = table;
+        settings.capacity = capacity;
+    }
+
+    setting_t *entry = table_slot(settings.table, settings.capacity, hash, scope, key);
+
+    if (entry->type == SETTING_NONE)
+    {
+        if (!create)
+            return NULL;
+        entry->hash = hash;
+        entry->scope = strdup(scope);
+        entry->key = strdup(key);
+        settings.count++;
+    }
+
+    return entry;
+}
+
+static bool store_set(const char *scope, const char *key, setting_type_t type, int32_t i32, const char *str)
+{
+    setting_t *entry = table_find(scope, key, true);
+
+    if (entry->type == type && (type == SETTING_STRING ? strcmp(entry->value.str, str) == 0 : entry->value.i32 == i32))
+        return false;
+
+    if (entry->type == SETTING_STRING)
+        free(entry->value.str);
+
+    entry->type = type;
+    if (type == SETTING_STRING)
+        entry->value.str = strdup(str ? str : "");
+    else
+        entry->value.i32 = i32;
+
+    return true;
+}
+
+static void setting_set(const char *scope, const char *key, setting_type_t type, int32_t i32, const char *str)
+{
+    if (!settings.lock)
     {
         RG_LOGW("Trying to set key '%s' before rg_settings_init() was called!\n", key);
         return;
     }
 
-    cJSON *obj = cJSON_GetObjectItem(root, key);
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    if (store_set(scope, key, type, i32, str))
+        settings.unsaved_changes++;
+    xSemaphoreGive(settings.lock);
+}
 
-    if (obj == NULL)
+static bool setting_get_int32(const char *scope, const char *key, int32_t *out)
+{
+    if (!settings.lock)
     {
-        cJSON_AddItemToObject(root, key, value);
-        unsaved_changes++;
+        RG_LOGW("Trying to get key '%s' before rg_settings_init() was called!\n", key);
+        return false;
     }
-    else if (cJSON_Compare(obj, value, 0) == false)
+
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    setting_t *entry = table_find(scope, key, false);
+    bool found = entry && entry->type == SETTING_INT32;
+    if (found)
+        *out = entry->value.i32;
+    xSemaphoreGive(settings.lock);
+
+    return found;
+}
+
+static char *setting_get_string(const char *scope, const char *key, const char *default_value)
+{
+    char *value = NULL;
+
+    if (!settings.lock)
     {
-        // cJSON_ReplaceItemViaPointer(root, obj, value);
-        cJSON_ReplaceItemInObject(root, key, value);
-        unsaved_changes++;
+        RG_LOGW("Trying to get key '%s' before rg_settings_init() was called!\n", key);
     }
+    else
+    {
+        xSemaphoreTake(settings.lock, portMAX_DELAY);
+        setting_t *entry = table_find(scope, key, false);
+        if (entry && entry->type == SETTING_STRING)
+            value = strdup(entry->value.str);
+        xSemaphoreGive(settings.lock);
+    }
+
+    if (!value && default_value)
+        value = strdup(default_value);
+
+    return value;
 }
 
+static size_t store_serialize(uint8_t **out)
+{
+    size_t size = sizeof(store_header_t);
+    uint16_t count = 0;
 
-void rg_settings_init(const char *app_name)
+    for (size_t i = 0; i < settings.capacity; i++)
+    {
+        setting_t *entry = &settings.table[i];
+        if (entry->type == SETTING_NONE)
+            continue;
+        size += sizeof(store_record_t) + strlen(entry->scope) + strlen(entry->key);
+        size += entry->type == SETTING_STRING ? strlen(entry->value.str) : sizeof(int32_t);
+    }
+
+    uint8_t *buffer = malloc(size);
+    uint8_t *ptr = buffer + sizeof(store_header_t);
+
+    if (!buffer)
+        return 0;
+
+    for (size_t i = 0; i < settings.capacity; i++)
+    {
+        setting_t *entry = &settings.table[i];
+        if (entry->type == SETTING_NONE)
+            continue;
+
+        const void *value = entry->type == SETTING_STRING ? (void *)entry->value.str : (void *)&entry->value.i32;
+        store_record_t record = {
+            .hash = entry->hash,
+            .type = entry->type,
+            .scope_len = strlen(entry->scope),
+            .key_len = strlen(entry->key),
+            .value_len = entry->type == SETTING_STRING ? strlen(entry->value.str) : sizeof(int32_t),
+        };
+
+        memcpy(ptr, &record, sizeof(record)), ptr += sizeof(record);
+        memcpy(ptr, entry->scope, record.scope_len), ptr += record.scope_len;
+        memcpy(ptr, entry->key, record.key_len), ptr += record.key_len;
+        memcpy(ptr, value, record.value_len), ptr += record.value_len;
+        count++;
+    }
+
+    store_header_t header = {STORE_MAGIC, STORE_VERSION, count};
+    memcpy(buffer, &header, sizeof(header));
+
+    *out = buffer;
+    return size;
+}
+
+static bool store_deserialize(const uint8_t *buffer, size_t size)
+{
+    const uint8_t *ptr = buffer + sizeof(store_header_t);
+    const uint8_t *end = buffer + size;
+    store_header_t header;
+    char scope[256], key[256];
+
+    if (size < sizeof(header))
+        return false;
+
+    memcpy(&header, buffer, sizeof(header));
+
+    if (header.magic != STORE_MAGIC || header.version != STORE_VERSION)
+        return false;
+
+    for (int i = 0; i < header.count; i++)
+    {
+        store_record_t record;
+
+        if (ptr + sizeof(record) > end)
+            return false;
+        memcpy(&record, ptr, sizeof(record)), ptr += sizeof(record);
+
+        if (ptr + record.scope_len + record.key_len + record.value_len > end)
+            return false;
+
+        memcpy(scope, ptr, record.scope_len), ptr += record.scope_len;
+        memcpy(key, ptr, record.key_len), ptr += record.key_len;
+        scope[record.scope_len] = key[record.key_len] = 0;
+
+        if (record.type == SETTING_INT32 && record.value_len == sizeof(int32_t))
+        {
+            int32_t value;
+            memcpy(&value, ptr, sizeof(value));
+            store_set(scope, key, SETTING_INT32, value, NULL);
+        }
+        else if (record.type == SETTING_STRING)
+        {
+            char *value = strndup((const char *)ptr, record.value_len);
+            store_set(scope, key, SETTING_STRING, 0, value);
+            free(value);
+        }
+
+        ptr += record.value_len;
+    }
+
+    return true;
+}
+
+static void import_json_object(const char *scope, cJSON *object)
+{
+    cJSON *item;
+
+    cJSON_ArrayForEach(item, object)
+    {
+        if (cJSON_IsObject(item) && !scope[0])
+            import_json_object(item->string, item);
+        else if (cJSON_IsString(item))
+            store_set(scope, item->string, SETTING_STRING, 0, item->valuestring);
+        else if (cJSON_IsNumber(item) || cJSON_IsBool(item))
+            store_set(scope, item->string, SETTING_INT32, cJSON_IsBool(item) ? cJSON_IsTrue(item) : item->valueint, NULL);
+    }
+}
+
+static bool import_json(const char *buffer)
+{
+    cJSON *root = cJSON_Parse(buffer);
+
+    if (!root)
+        return false;
+
+    import_json_object("", root);
+    cJSON_Delete(root);
+
+    return true;
+}
+
+static char *export_json(void)
+{
+    cJSON *root = cJSON_CreateObject();
+
+    for (size_t i = 0; i < settings.capacity; i++)
+    {
+        setting_t *entry = &settings.table[i];
+        cJSON *parent = root;
+
+        if (entry->type == SETTING_NONE)
+            continue;
+
+        if (entry->scope[0])
+        {
+            parent = cJSON_GetObjectItem(root, entry->scope);
+            if (!parent)
+                parent = cJSON_AddObjectToObject(root, entry->scope);
+        }
+
+        if (entry->type == SETTING_STRING)
+            cJSON_AddStringToObject(parent, entry->key, entry->value.str);
+        else
+            cJSON_AddNumberToObject(parent, entry->key, entry->value.i32);
+    }
+
+    char *buffer = cJSON_Print(root);
+    cJSON_Delete(root);
+
+    return buffer;
+}
+
+static bool write_file(const char *path, const void *data, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+    {
+        // Sometimes the FAT is left in an inconsistent state and this might help
+        unlink(path);
+        fp = fopen(path, "wb");
+    }
+    if (!fp)
+        return false;
+
+    bool success = fwrite(data, size, 1, fp) == 1;
+    return (fclose(fp) == 0) && success;
+}
+
+static char *read_file(const char *path, size_t *length)
 {
     char *buffer = NULL;
-    const char *source;
-    size_t length = 0;
+    FILE *fp = fopen(path, "rb");
 
-#if USE_CONFIG_FILE
-    FILE *fp = fopen(CONFIG_FILE_PATH, "rb");
     if (fp)
     {
         fseek(fp, 0, SEEK_END);
-        length = ftell(fp);
+        *length = ftell(fp);
         fseek(fp, 0, SEEK_SET);
-        buffer = calloc(1, length + 1);
-        fread(buffer, 1, length, fp);
+        if ((buffer = calloc(1, *length + 1)))
+            *length = fread(buffer, 1, *length, fp);
         fclose(fp);
     }
-    source = "sdcard";
+
+    return buffer;
+}
+
+static bool export_file(const char *path)
+{
+    char *buffer = export_json();
+    bool success = false;
+
+    if (!buffer)
+    {
+        RG_LOGE("cJSON_Print() failed.\n");
+        return false;
+    }
+
+    if (!(success = write_file(path, buffer, strlen(buffer))))
+        RG_LOGE("Failed to export settings to '%s'.\n", path);
+
+    cJSON_free(buffer);
+
+    return success;
+}
+
+// Must be called with the lock held
+static bool settings_flush(void)
+{
+    bool success = true;
+
+    if (settings.unsaved_changes > 0)
+    {
+        uint8_t *buffer = NULL;
+        size_t size = store_serialize(&buffer);
+
+        if (!size)
+            return false;
+
+    #if USE_CONFIG_FILE
+        success = write_file(CONFIG_STORE_PATH, buffer, size);
+    #else
+        success = nvs_set_blob(my_handle, CONFIG_NVS_BLOB, buffer, size) == ESP_OK
+                  && nvs_commit(my_handle) == ESP_OK;
+    #endif
+
+        free(buffer);
+
+        if (success)
+            settings.unsaved_changes = 0;
+        else
+            RG_LOGE("Failed to save settings!\n");
+    }
+
+    return success;
+}
+
+static void settings_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Wait until things settle down, every save in the meantime pushes the deadline back
+        xSemaphoreTake(settings.lock, portMAX_DELAY);
+        int64_t idle;
+        while ((idle = get_elapsed_time_since(settings.last_change) / 1000) < CONFIG_SAVE_DELAY)
+        {
+            xSemaphoreGive(settings.lock);
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_SAVE_DELAY - idle));
+            xSemaphoreTake(settings.lock, portMAX_DELAY);
+        }
+        settings_flush();
+        xSemaphoreGive(settings.lock);
+    }
+}
+
+
+void rg_settings_init(const char *app_name)
+{
+    const char *source = "sdcard";
+    char *buffer = NULL;
+    size_t length = 0;
+    bool loaded = false;
+
+    if (!settings.lock)
+        settings.lock = xSemaphoreCreateMutex();
+
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+
+#if USE_CONFIG_FILE
+    struct stat json_st = {0}, store_st = {0};
+    bool have_json = stat(CONFIG_FILE_PATH, &json_st) == 0;
+    bool have_store = stat(CONFIG_STORE_PATH, &store_st) == 0;
+
+    // A JSON file newer than the store was edited by the user (or predates the store)
+    if (have_store && !(have_json && json_st.st_mtime > store_st.st_mtime))
+    {
+        if ((buffer = read_file(CONFIG_STORE_PATH, &length)))
+            loaded = store_deserialize((uint8_t *)buffer, length);
+    }
+
+    if (!loaded && have_json)
+    {
+        free(buffer);
+        if ((buffer = read_file(CONFIG_FILE_PATH, &length)))
+            loaded = import_json(buffer);
+        settings.unsaved_changes += loaded;
+        source = "sdcard (json)";
+    }
 #else
     if (nvs_flash_init() != ESP_OK)
     {
@@ -86,149 +553,162 @@ void rg_settings_init(const char *app_name)
 
     if (nvs_open(CONFIG_NAMESPACE, NVS_READWRITE, &my_handle) == ESP_OK)
     {
-        if (nvs_get_str(my_handle, CONFIG_NVS_STORE, NULL, &length) == ESP_OK)
+        if (nvs_get_blob(my_handle, CONFIG_NVS_BLOB, NULL, &length) == ESP_OK)
+        {
+            buffer = calloc(1, length + 1);
+            nvs_get_blob(my_handle, CONFIG_NVS_BLOB, buffer, &length);
+            loaded = store_deserialize((uint8_t *)buffer, length);
+        }
+        else if (nvs_get_str(my_handle, CONFIG_NVS_STORE, NULL, &length) == ESP_OK)
         {
             buffer = calloc(1, length + 1);
             nvs_get_str(my_handle, CONFIG_NVS_STORE, buffer, &length);
+            loaded = import_json(buffer);
+            settings.unsaved_changes += loaded;
         }
     }
     source = "NVS";
 #endif
 
-    if (buffer)
-    {
-        root = cJSON_Parse(buffer);
-        free(buffer);
-    }
+    free(buffer);
 
-    if (root)
+    if (loaded)
     {
-        RG_LOGI("Settings ready. source=%s\n", source);
+        RG_LOGI("Settings ready. source=%s, count=%d\n", source, settings.count);
     }
     else
     {
         RG_LOGE("Failed to initialize settings. source=%s!\n", source);
-        root = cJSON_CreateObject();
     }
 
+    xSemaphoreGive(settings.lock);
+
     rg_settings_set_app_name(app_name);
+    rg_settings_set_int32("version", CONFIG_VERSION);
 
-    json_set(root, "version", cJSON_CreateNumber(CONFIG_VERSION));
+    if (!settings.task)
+    {
+        // Low priority, on the other core than the emulator
+        xTaskCreatePinnedToCore(&settings_task, "settings", 3072, NULL, 1, &settings.task, 1);
+    }
 }
 
 void rg_settings_set_app_name(const char *app_name)
 {
-    app_name = app_name ? app_name : "__app__";
-    app_root = cJSON_GetObjectItem(root, app_name);
-
-    if (!app_root)
-    {
-        app_root = cJSON_AddObjectToObject(root, app_name);
-    }
-    else if (!cJSON_IsObject(app_root))
-    {
-        app_root = cJSON_CreateObject();
-        cJSON_ReplaceItemInObject(root, app_name, app_root);
-    }
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    free(settings.scope);
+    settings.scope = strdup(app_name ? app_name : "__app__");
+    xSemaphoreGive(settings.lock);
 }
 
 bool rg_settings_save(void)
 {
-    if (unsaved_changes == 0)
-        return true;
-
-    char *buffer = cJSON_Print(root);
-    if (!buffer)
-    {
-        RG_LOGE("cJSON_Print() failed.\n");
+    if (!settings.task)
         return false;
-    }
 
-#if USE_CONFIG_FILE
-    FILE *fp = fopen(CONFIG_FILE_PATH, "wb");
-    if (!fp)
-    {
-        // Sometimes the FAT is left in an inconsistent state and this might help
-        unlink(CONFIG_FILE_PATH);
-        fp = fopen(CONFIG_FILE_PATH, "wb");
-    }
-    if (fp)
-    {
-        if (fputs(buffer, fp) > 0)
-            unsaved_changes = 0;
-        fclose(fp);
-    }
-#else
-    if (nvs_set_str(my_handle, CONFIG_NVS_STORE, buffer) == ESP_OK
-        && nvs_commit(my_handle) == ESP_OK) unsaved_changes = 0;
-#endif
+    // The actual write happens once we've been idle for a while, see settings_task. The save
+    // state writer calls us from its own task, last_change is 64bit so it needs the lock too.
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    settings.last_change = get_elapsed_time();
+    xSemaphoreGive(settings.lock);
+    xTaskNotifyGive(settings.task);
 
-    cJSON_free(buffer);
+    return true;
+}
 
-    return (unsaved_changes == 0);
+bool rg_settings_commit(void)
+{
+    if (!settings.lock)
+        return false;
+
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    bool success = settings_flush();
+    xSemaphoreGive(settings.lock);
+
+    return success;
 }
 
 void rg_settings_reset(void)
 {
-    cJSON_Delete(root);
-    root = cJSON_CreateObject();
-    unsaved_changes++;
-    rg_settings_save();
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    table_clear();
+    settings.unsaved_changes++;
+    settings_flush();
+    xSemaphoreGive(settings.lock);
 }
 
 bool rg_settings_ready(void)
 {
-    return root != NULL;
+    return settings.lock != NULL;
+}
+
+bool rg_settings_import(const char *filename)
+{
+    size_t length = 0;
+    bool success = false;
+
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    char *buffer = read_file(filename, &length);
+    if (buffer && (success = import_json(buffer)))
+        settings.unsaved_changes++;
+    xSemaphoreGive(settings.lock);
+    free(buffer);
+
+    if (!success)
+        RG_LOGE("Failed to import settings from '%s'.\n", filename);
+
+    return success;
+}
+
+bool rg_settings_export(const char *filename)
+{
+    xSemaphoreTake(settings.lock, portMAX_DELAY);
+    bool success = export_file(filename);
+    xSemaphoreGive(settings.lock);
+
+    return success;
 }
 
 int32_t rg_settings_get_int32(const char *key, int32_t default_value)
 {
-    cJSON *obj = json_get(root, key);
-    return obj ? obj->valueint : default_value;
+    int32_t value = default_value;
+    setting_get_int32("", key, &value);
+    return value;
 }
 
 void rg_settings_set_int32(const char *key, int32_t value)
 {
-    json_set(root, key, cJSON_CreateNumber(value));
+    setting_set("", key, SETTING_INT32, value, NULL);
 }
 
 char *rg_settings_get_string(const char *key, const char *default_value)
 {
-    cJSON *obj = json_get(root, key);
-
-    if (obj && obj->valuestring)
-        return strdup(obj->valuestring);
-
-    return default_value ? strdup(default_value) : NULL;
+    return setting_get_string("", key, default_value);
 }
 
 void rg_settings_set_string(const char *key, const char *value)
 {
-    json_set(root, key, cJSON_CreateString(value));
+    setting_set("", key, SETTING_STRING, 0, value);
 }
 
 int32_t rg_settings_get_app_int32(const char *key, int32_t default_value)
 {
-    cJSON *obj = json_get(app_root, key);
-    return obj ? obj->valueint : default_value;
+    int32_t value = default_value;
+    setting_get_int32(settings.scope, key, &value);
+    return value;
 }
 
 void rg_settings_set_app_int32(const char *key, int32_t value)
 {
-    json_set(app_root, key, cJSON_CreateNumber(value));
+    setting_set(settings.scope, key, SETTING_INT32, value, NULL);
 }
 
 char *rg_settings_get_app_string(const char *key, const char *default_value)
 {
-    cJSON *obj = json_get(app_root, key);
-
-    if (obj && obj->valuestring)
-        return strdup(obj->valuestring);
-
-    return default_value ? strdup(default_value) : NULL;
+    return setting_get_string(settings.scope, key, default_value);
 }
 
 void rg_settings_set_app_string(const char *key, const char *value)
 {
-    json_set(app_root, key, cJSON_CreateString(value));
+    setting_set(settings.scope, key, SETTING_STRING, 0, value);
 }
@@ -7,9 +7,13 @@ void rg_settings_init(const char *app_name);
 void rg_settings_reset(void);
 bool rg_settings_load(void);
 bool rg_settings_save(void);
+bool rg_settings_commit(void);
 bool rg_settings_ready(void);
 void rg_settings_set_app_name(const char *app_name);
 
+bool rg_settings_import(const char *filename);
+bool rg_settings_export(const char *filename);
+
 void rg_settings_set_string(const char *key, const char *value);
 char* rg_settings_get_string(const char *key, const char *default_value);
 
@@ -0,0 +1,305 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <esp_heap_caps.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "rg_system.h"
+#include "rg_sram.h"
+
+// Battery save (SRAM) persistence.
+//
+// The core registers its SRAM and reports writes page by page with rg_sram_mark, from its memory
+// handlers. Cores whose SRAM is mapped for direct writes register in scan mode instead, and we
+// find the changed pages by comparing with a shadow copy every RG_SRAM_SCAN_INTERVAL frames.
+// Changes are coalesced for a delay, then the dirty pages are copied to a staging buffer on the
+// emulator task and sram_task writes them in place with fseek/fwrite.
+
+#define BITMAP_WORDS(pages) (((pages) + 31) / 32)
+
+static struct
+{
+    char *filename;
+    uint8_t *data;          // The core's SRAM
+    uint8_t *shadow;        // What we last saw, scan mode only
+    uint8_t *staging;       // Copy of the pages being written
+    uint32_t *dirty;        // One bit per page
+    uint32_t *pending;      // Pages being written
+    size_t size;
+    size_t pages;
+    bool scan;
+    bool full;              // The file is missing or short, the next write must cover everything
+    bool failed;            // The last write failed, its pages must be written again
+    int delay;              // Frames, 0 disables autosave
+    int countdown;          // Frames before the write, 0 when nothing is waiting
+    int frames;             // Since the last scan
+} sram;
+
+static QueueHandle_t sram_queue;
+static SemaphoreHandle_t sram_slot; // Taken while a write is in flight
+
+
+static bool sram_write(bool full)
+{
+    FILE *fp = fopen(sram.filename, full ? "wb" : "r+b");
+    bool success = fp != NULL;
+    int written = 0;
+
+    if (fp && full)
+    {
+        success = fwrite(sram.staging, sram.size, 1, fp) == 1;
+        written = sram.pages;
+    }
+    else if (fp)
+    {
+        // Consecutive pages are written together
+        for (size_t page = 0; page < sram.pages && success;)
+        {
+            if (!(sram.pending[page / 32] & (1u << (page % 32))))
+            {
+                page++;
+                continue;
+            }
+
+            size_t start = page;
+            while (page < sram.pages && (sram.pending[page / 32] & (1u << (page % 32))))
+                page++;
+
+            size_t offset = start * RG_SRAM_PAGE_SIZE;
+            size_t length = RG_MIN(page * RG_SRAM_PAGE_SIZE, sram.size) - offset;
+
+            success = fseek(fp, offset, SEEK_SET) == 0 && fwrite(sram.staging + offset, length, 1, fp) == 1;
+            written += page - start;
+        }
+    }
+
+    if (fp)
+        success = (fclose(fp) == 0) && success;
+
+    if (success)
+        RG_LOGI("Wrote %d SRAM pages to '%s'.\n", written, sram.filename);
+    else
+        RG_LOGE("Failed writing SRAM to '%s'!\n", sram.filename);
+
+    return success;
+}
+
+static void sram_task(void *arg)
+{
+    bool full;
+
+    while (xQueueReceive(sram_queue, &full, portMAX_DELAY) == pdTRUE)
+    {
+        rg_system_set_led(1);
+
+        if (sram_write(full))
+            sram.full = false;
+        else
+            sram.failed = true;
+
+        rg_system_set_led(0);
+
+        xSemaphoreGive(sram_slot);
+    }
+
+    vTaskDelete(NULL);
+}
+
+static void sram_scan(void)
+{
+    for (size_t offset = 0; offset < sram.size; offset += RG_SRAM_PAGE_SIZE)
+    {
+        size_t length = RG_MIN(sram.size - offset, (size_t)RG_SRAM_PAGE_SIZE);
+
+        if (memcmp(sram.data + offset, sram.shadow + offset, length) != 0)
+        {
+            memcpy(sram.shadow + offset, sram.data + offset, length);
+            rg_sram_mark(offset);
+        }
+    }
+}
+
+bool rg_sram_open(const char *filename, void *data, size_t size, bool scan)
+{
+    size_t loaded = 0;
+    FILE *fp;
+
+    rg_sram_close();
+
+    if (!filename || !data || !size)
+        return false;
+
+    sram.filename = strdup(filename);
+    sram.data = data;
+    sram.size = size;
+    sram.pages = (size + RG_SRAM_PAGE_SIZE - 1) / RG_SRAM_PAGE_SIZE;
+    sram.scan = scan;
+    sram.delay = RG_SRAM_DEFAULT_DELAY * 60;
+    sram.dirty = calloc(BITMAP_WORDS(sram.pages), 4);
+    sram.pending = calloc(BITMAP_WORDS(sram.pages), 4);
+    sram.staging = heap_caps_malloc(size, MALLOC_CAP_SPIRAM) ?: malloc(size);
+    sram.shadow = scan ? (heap_caps_malloc(size, MALLOC_CAP_SPIRAM) ?: malloc(size)) : NULL;
+
+    if (!sram.filename || !sram.dirty || !sram.pending || !sram.staging || (scan && !sram.shadow))
+    {
+        RG_LOGE("Not enough memory to track SRAM, it won't be saved!\n");
+        rg_sram_close();
+        return false;
+    }
+
+    if (!rg_mkdir(rg_dirname(sram.filename)))
+        RG_LOGW("Unable to create SRAM folder...\n");
+
+    if ((fp = fopen(sram.filename, "rb")))
+    {
+        loaded = fread(sram.data, 1, size, fp);
+        fclose(fp);
+        RG_LOGI("Loaded %d bytes of SRAM from '%s'.\n", loaded, sram.filename);
+    }
+
+    sram.full = loaded < size;
+
+    if (scan)
+        memcpy(sram.shadow, sram.data, size);
+
+    if (!sram_queue)
+    {
+        sram_slot = xSemaphoreCreateBinary();
+        sram_queue = xQueueCreate(1, sizeof(bool));
+        xSemaphoreGive(sram_slot);
+        // Other core than the emulator, same low priority as the other background writers
+        xTaskCreatePinnedToCore(&sram_task, "sram", 3072, NULL, 1, NULL, 1);
+    }
+
+    return loaded > 0;
+}
+
+void rg_sram_close(void)
+{
+    if (sram.data && sram.delay > 0)
+        rg_sram_flush(true);
+
+    // No timeout: sram_task uses the filename and the staging buffer until it gives the slot back
+    if (sram_slot && xSemaphoreTake(sram_slot, portMAX_DELAY) == pdTRUE)
+        xSemaphoreGive(sram_slot);
+
+    free(sram.filename);
+    free(sram.shadow);
+    free(sram.staging);
+    free(sram.dirty);
+    free(sram.pending);
+    memset(&sram, 0, sizeof(sram));
+}
+
+IRAM_ATTR void rg_sram_mark(size_t offset)
+{
+    if (offset >= sram.size)
+        return;
+
+    size_t page = offset / RG_SRAM_PAGE_SIZE;
+    sram.dirty[page / 32] |= 1u << (page % 32);
+
+    if (sram.countdown == 0)
+        sram.countdown = sram.delay;
+}
+
+void rg_sram_mark_all(void)
+{
+    for (size_t offset = 0; offset < sram.size; offset += RG_SRAM_PAGE_SIZE)
+        rg_sram_mark(offset);
+}
+
+bool rg_sram_flush(bool wait)
+{
+    bool dirty = false;
+
+    if (!sram.data)
+        return false;
+
+    if (sram.scan)
+        sram_scan();
+
+    // If a write is in flight and we can't wait, the pages stay dirty for the next attempt
+    if (xSemaphoreTake(sram_slot, wait ? pdMS_TO_TICKS(5000) : 0) != pdTRUE)
+        return false;
+
+    for (size_t i = 0; i < BITMAP_WORDS(sram.pages); i++)
+    {
+        if (sram.failed)
+            sram.dirty[i] |= sram.pending[i];
+        dirty |= sram.dirty[i] != 0;
+    }
+
+    sram.failed = false;
+    sram.countdown = 0;
+
+    if (!dirty)
+    {
+        xSemaphoreGive(sram_slot);
+        return true;
+    }
+
+    // The copy is all the writer needs, the core can keep writing to its SRAM meanwhile
+    if (sram.full)
+    {
+        memcpy(sram.staging, sram.data, sram.size);
+    }
+    else
+    {
+        for (size_t page = 0; page < sram.pages; page++)
+        {
+            if (sram.dirty[page / 32] & (1u << (page % 32)))
+            {
+                size_t offset = page * RG_SRAM_PAGE_SIZE;
+                memcpy(sram.staging + offset, sram.data + offset, RG_MIN(sram.size - offset, (size_t)RG_SRAM_PAGE_SIZE));
+            }
+        }
+    }
+
+    memcpy(sram.pending, sram.dirty, BITMAP_WORDS(sram.pages) * 4);
+    memset(sram.dirty, 0, BITMAP_WORDS(sram.pages) * 4);
+
+    xQueueSend(sram_queue, &sram.full, 0);
+
+    if (wait)
+    {
+        if (xSemaphoreTake(sram_slot, pdMS_TO_TICKS(5000)) != pdTRUE)
+        {
+            RG_LOGW("Timed out waiting for SRAM to be saved!\n");
+            return false;
+        }
+        xSemaphoreGive(sram_slot);
+        return !sram.failed;
+    }
+
+    return true;
+}
+
+void rg_sram_set_delay(int seconds)
+{
+    sram.delay = RG_MAX(seconds, 0) * 60;
+    sram.countdown = RG_MIN(sram.countdown, sram.delay);
+}
+
+int rg_sram_get_delay(void)
+{
+    return sram.delay / 60;
+}
+
+IRAM_ATTR void rg_sram_tick(void)
+{
+    if (!sram.data || !sram.delay)
+        return;
+
+    if (sram.scan && ++sram.frames >= RG_SRAM_SCAN_INTERVAL)
+    {
+        sram.frames = 0;
+        sram_scan();
+    }
+
+    // A busy writer means we try again next frame, the changes keep piling in the meantime
+    if (sram.countdown > 0 && --sram.countdown == 0 && !rg_sram_flush(false))
+        sram.countdown = 1;
+}
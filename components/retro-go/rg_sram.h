@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RG_SRAM_PAGE_SIZE     256
+#define RG_SRAM_DEFAULT_DELAY 2     // Seconds between the first change and the write
+#define RG_SRAM_SCAN_INTERVAL 60    // Frames between scans, for cores without write hooks
+
+bool rg_sram_open(const char *filename, void *data, size_t size, bool scan);
+void rg_sram_close(void);
+void rg_sram_mark(size_t offset);
+void rg_sram_mark_all(void);
+bool rg_sram_flush(bool wait);
+void rg_sram_set_delay(int seconds);
+int  rg_sram_get_delay(void);
+void rg_sram_tick(void);
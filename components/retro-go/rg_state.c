@@ -0,0 +1,214 @@
+#include <esp_heap_caps.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <miniz.h>
+
+#include "rg_system.h"
+#include "rg_state.h"
+
+// Save state container.
+//
+// The cores serialize themselves to memory in their own format (SNSS, freeze, etc), which we
+// then store in fixed size chunks, each deflated on its own and checked with a crc32. States
+// are mostly zeros and tables, so they shrink a lot, and the SD card is much slower than the
+// compressor. Reading is one sequential pass over the file, a chunk at a time.
+//
+// File layout:
+//   state_header_t
+//   state_chunk_t, packed data   (repeated header.chunks times)
+
+#define STATE_MAGIC      0x54534752 // "RGST"
+#define STATE_VERSION    1
+#define STATE_CHUNK_SIZE 0x8000
+
+enum
+{
+    STATE_METHOD_STORE = 0,
+    STATE_METHOD_DEFLATE,
+};
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t chunks;
+    uint32_t size;          // Of the whole state, unpacked
+    char tag[20];           // Emulator that wrote it, the formats aren't interchangeable
+} state_header_t;
+
+typedef struct
+{
+    uint32_t size;          // Unpacked
+    uint32_t packed;        // Bytes following this header
+    uint32_t crc;           // Of the unpacked data
+    uint32_t method;
+} state_chunk_t;
+
+
+bool rg_state_write(const char *filename, const char *tag, const void *data, size_t size)
+{
+    state_header_t header = {STATE_MAGIC, STATE_VERSION, 0, size, {0}};
+    tdefl_compressor *deflator = NULL;
+    uint8_t *packed = NULL;
+    bool success = false;
+    FILE *fp;
+
+    header.chunks = (size + STATE_CHUNK_SIZE - 1) / STATE_CHUNK_SIZE;
+    strncpy(header.tag, tag, sizeof(header.tag) - 1);
+
+    if (!(fp = fopen(filename, "wb")))
+    {
+        RG_LOGE("Unable to open '%s' for writing.\n", filename);
+        return false;
+    }
+
+    // If we can't get the memory the chunks are simply stored, it's still a valid state
+    deflator = heap_caps_malloc(sizeof(tdefl_compressor), MALLOC_CAP_SPIRAM);
+    packed = heap_caps_malloc(STATE_CHUNK_SIZE, MALLOC_CAP_SPIRAM);
+
+    if (!deflator || !packed)
+        RG_LOGW("Not enough memory to compress, the state will be stored.\n");
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1)
+        goto cleanup;
+
+    // Same as the PNG encoder, our miniz only does RLE matches. Most of the gain is runs of zeros.
+    int flags = TDEFL_RLE_MATCHES;
+
+    for (size_t pos = 0; pos < size; pos += STATE_CHUNK_SIZE)
+    {
+        const uint8_t *src = (const uint8_t *)data + pos;
+        size_t length = RG_MIN(size - pos, (size_t)STATE_CHUNK_SIZE);
+        state_chunk_t chunk = {length, length, crc32_le(0, src, length), STATE_METHOD_STORE};
+
+        if (deflator && packed)
+        {
+            size_t in_size = length, out_size = length;
+
+            tdefl_init(deflator, NULL, NULL, flags);
+            if (tdefl_compress(deflator, src, &in_size, packed, &out_size, TDEFL_FINISH) == TDEFL_STATUS_DONE
+                && out_size < length)
+            {
+                chunk.packed = out_size;
+                chunk.method = STATE_METHOD_DEFLATE;
+            }
+        }
+
+        if (fwrite(&chunk, sizeof(chunk), 1, fp) != 1)
+            goto cleanup;
+
+        if (fwrite(chunk.method == STATE_METHOD_DEFLATE ? packed : src, chunk.packed, 1, fp) != 1)
+            goto cleanup;
+    }
+
+    success = true;
+
+cleanup:
+    success = (fclose(fp) == 0) && success;
+    free(deflator);
+    free(packed);
+
+    if (!success)
+        RG_LOGE("Failed writing state to '%s'.\n", filename);
+
+    return success;
+}
+
+rg_state_status_t rg_state_read(const char *filename, const char *tag, void **data, size_t *size)
+{
+    rg_state_status_t status = RG_STATE_ERROR;
+    tinfl_decompressor *inflator = NULL;
+    uint8_t *packed = NULL, *output = NULL;
+    state_header_t header;
+    state_chunk_t chunk;
+    size_t pos = 0;
+    FILE *fp;
+
+    if (!(fp = fopen(filename, "rb")))
+        return RG_STATE_FOREIGN;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != STATE_MAGIC)
+    {
+        fclose(fp);
+        return RG_STATE_FOREIGN;
+    }
+
+    header.tag[sizeof(header.tag) - 1] = 0;
+
+    if (header.version != STATE_VERSION || strncmp(header.tag, tag, sizeof(header.tag) - 1) != 0)
+    {
+        RG_LOGE("State version %d from '%s' isn't supported.\n", header.version, header.tag);
+        goto cleanup;
+    }
+
+    inflator = malloc(sizeof(tinfl_decompressor));
+    packed = heap_caps_malloc(STATE_CHUNK_SIZE, MALLOC_CAP_SPIRAM);
+    output = heap_caps_malloc(RG_MAX(header.size, 1u), MALLOC_CAP_SPIRAM);
+
+    if (!inflator || !packed || !output)
+    {
+        RG_LOGE("Not enough memory to load a %d bytes state.\n", header.size);
+        goto cleanup;
+    }
+
+    for (int i = 0; i < header.chunks; i++)
+    {
+        if (fread(&chunk, sizeof(chunk), 1, fp) != 1
+            || chunk.size > header.size - pos || chunk.packed > STATE_CHUNK_SIZE
+            || rg_file_read(fp, packed, chunk.packed) != chunk.packed)
+        {
+            RG_LOGE("State is truncated at chunk %d.\n", i);
+            goto cleanup;
+        }
+
+        if (chunk.method == STATE_METHOD_DEFLATE)
+        {
+            size_t in_size = chunk.packed, out_size = chunk.size;
+
+            tinfl_init(inflator);
+            if (tinfl_decompress(inflator, packed, &in_size, output + pos, output + pos, &out_size,
+                    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) != TINFL_STATUS_DONE || out_size != chunk.size)
+            {
+                RG_LOGE("Chunk %d failed to decompress.\n", i);
+                goto cleanup;
+            }
+        }
+        else if (chunk.method == STATE_METHOD_STORE && chunk.packed == chunk.size)
+        {
+            memcpy(output + pos, packed, chunk.size);
+        }
+        else
+        {
+            RG_LOGE("Chunk %d has unknown method %d.\n", i, chunk.method);
+            goto cleanup;
+        }
+
+        if (crc32_le(0, output + pos, chunk.size) != chunk.crc)
+        {
+            RG_LOGE("Chunk %d is corrupt (bad crc).\n", i);
+            goto cleanup;
+        }
+
+        pos += chunk.size;
+    }
+
+    if (pos != header.size)
+    {
+        RG_LOGE("State is %d bytes instead of %d.\n", pos, header.size);
+        goto cleanup;
+    }
+
+    *data = output;
+    *size = pos;
+    output = NULL;
+    status = RG_STATE_OK;
+
+cleanup:
+    fclose(fp);
+    free(inflator);
+    free(packed);
+    free(output);
+
+    return status;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+    RG_STATE_OK = 0,
+    RG_STATE_FOREIGN,   // Missing or not a container (an older raw save), let the core read it
+    RG_STATE_ERROR,     // Container is corrupt, truncated, or belongs to another emulator
+} rg_state_status_t;
+
+bool rg_state_write(const char *filename, const char *tag, const void *data, size_t size);
+rg_state_status_t rg_state_read(const char *filename, const char *tag, void **data, size_t *size);
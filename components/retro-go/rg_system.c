@@ -1,4 +1,5 @@
 #include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
 #include <esp_heap_caps.h>
 #include <esp_partition.h>
 #include <esp_task_wdt.h>
@@ -7,6 +8,7 @@
 #include <esp_event.h>
 #include <esp_sleep.h>
 #include <driver/gpio.h>
+#include <soc/soc_memory_layout.h>
 #include <sys/stat.h>
 #include <stdarg.h>
 #include <assert.h>
@@ -38,6 +40,22 @@
 #define SETTING_START_ACTION  "StartAction"
 #define SETTING_STARTUP_APP   "StartupApp"
 
+// Log messages are queued in binary form (format pointer + raw arguments) and formatted later
+// by a low priority task. This keeps vsnprintf and the slow UART out of the caller's path.
+#define LOG_RING_SIZE   4096
+#define LOG_RECORD_MAX  512
+
+typedef struct
+{
+    uint16_t size;          // Whole record including args, 0 marks a jump to the start of the ring
+    uint16_t level;
+    const char *context;    // Must be static (__func__)
+    const char *format;     // Must be static (a literal)
+    uint8_t args[];
+} log_record_t;
+
+enum {LOG_ARG_NONE, LOG_ARG_INT, LOG_ARG_LONG, LOG_ARG_LLONG, LOG_ARG_DOUBLE, LOG_ARG_STRING, LOG_ARG_PTR, LOG_ARG_INVALID};
+
 typedef struct
 {
     uint32_t magicWord;
@@ -47,6 +65,31 @@ typedef struct
     log_buffer_t log;
 } panic_trace_t;
 
+// Save states are serialized to RAM on the emulator task and written out by save_state_task.
+// A job stays in the queue until it's written, so an empty queue means everything is on disk.
+#define SAVE_STATE_QUEUE_LENGTH 2
+
+typedef struct
+{
+    int slot;
+    void *buffer;
+    size_t size;
+    rg_save_callback_t callback;
+} save_state_job_t;
+
+// Memory placement telemetry for rg_alloc. Freeing doesn't go through us (callers use free()), so
+// the counts and the map are what was allocated since boot, not what is still in use.
+#define ALLOC_TAGS_MAX 32
+#define ALLOC_MAP_MAX  64
+
+typedef struct
+{
+    void *ptr;
+    uint32_t size;
+    uint32_t type;
+    const char *tag;
+} alloc_map_entry_t;
+
 // These will survive a software reset
 static RTC_NOINIT_ATTR panic_trace_t panicTrace;
 static runtime_stats_t statistics;
@@ -55,9 +98,32 @@ static rg_app_desc_t app;
 static long inputTimeout = -1;
 static bool initialized = false;
 
+static const char *log_prefix[] = {"", "error", "warn", "info", "debug"};
+static struct
+{
+    uint8_t buffer[LOG_RING_SIZE] __attribute__((aligned(8)));
+    volatile size_t head;   // Free running, producers write here
+    volatile size_t tail;   // Free running, the logger task reads here
+    bool synchronous;       // Set on panic, bypasses the ring
+    size_t lost;            // Messages dropped because the ring was full and busy
+    portMUX_TYPE lock;
+    SemaphoreHandle_t drainLock;
+    TaskHandle_t task;
+} logRing = {.lock = portMUX_INITIALIZER_UNLOCKED};
+
+static rg_alloc_stats_t allocTags[ALLOC_TAGS_MAX];
+static alloc_map_entry_t allocMap[ALLOC_MAP_MAX];
+static size_t allocTagsCount, allocMapCount;
+static portMUX_TYPE allocLock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t saveStateQueue;
+static size_t stateSizeHint; // Buffer size that fit the last state, see save_state_snapshot
+
 #if USE_SPI_MUTEX
 static SemaphoreHandle_t spiMutex;
 static spi_lock_res_t spiMutexOwner;
+static EventGroupHandle_t spiMutexEvents;
+#define SPI_DISPLAY_IDLE (1 << 0) // Cleared while the display waits for the bus
+static rg_spi_lock_stats_t spiMutexStats[SPI_LOCK_COUNT];
 #endif
 
 
@@ -88,9 +154,275 @@ IRAM_ATTR void esp_panic_putchar_hook(char c)
     logbuf_print(&panicTrace.log, (char[2]){c, 0});
 }
 
+static size_t log_parse_spec(const char *fmt, int *type, int *stars)
+{
+    const char *ptr = fmt + 1;
+    int longs = 0;
+
+    *stars = 0;
+
+    ptr += strspn(ptr, "-+ #0");
+    if (*ptr == '*')
+        (*stars)++, ptr++;
+    else
+        ptr += strspn(ptr, "0123456789");
+
+    if (*ptr == '.')
+    {
+        if (*++ptr == '*')
+            (*stars)++, ptr++;
+        else
+            ptr += strspn(ptr, "0123456789");
+    }
+
+    for (; *ptr && strchr("hlLjzt", *ptr); ptr++)
+    {
+        if (*ptr == 'l')
+            longs++;
+        else if (*ptr == 'j')
+            longs = 2;
+        else if (*ptr == 'z' || *ptr == 't')
+            longs = 1; // size_t and ptrdiff_t are long-sized on every target we care about
+    }
+
+    switch (*ptr)
+    {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            *type = longs > 1 ? LOG_ARG_LLONG : (longs ? LOG_ARG_LONG : LOG_ARG_INT);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            *type = LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            *type = LOG_ARG_STRING;
+            break;
+        case 'p':
+            *type = LOG_ARG_PTR;
+            break;
+        case '%':
+            *type = LOG_ARG_NONE;
+            break;
+        default:
+            *type = LOG_ARG_INVALID;
+            *stars = 0;
+            return ptr - fmt;
+    }
+
+    return ptr - fmt + 1;
+}
+
+static int log_pack_args(uint8_t *out, size_t size, const char *format, va_list args)
+{
+    uint8_t *ptr = out, *end = out + size;
+    int type, stars;
+
+    #define PACK(type) {type _v = va_arg(args, type); memcpy(ptr, &_v, sizeof(type)); ptr += sizeof(type);}
+
+    for (const char *fmt = strchr(format, '%'); fmt; fmt = strchr(fmt, '%'))
+    {
+        fmt += log_parse_spec(fmt, &type, &stars);
+
+        // If an argument doesn't fit the record the message is printed synchronously instead
+        if (ptr + stars * sizeof(int) + sizeof(long long) > end)
+            return -1;
+
+        while (stars-- > 0)
+            PACK(int);
+
+        if (type == LOG_ARG_INT)
+            PACK(int)
+        else if (type == LOG_ARG_LONG)
+            PACK(long)
+        else if (type == LOG_ARG_LLONG)
+            PACK(long long)
+        else if (type == LOG_ARG_DOUBLE)
+            PACK(double)
+        else if (type == LOG_ARG_PTR)
+            PACK(void *)
+        else if (type == LOG_ARG_STRING)
+        {
+            const char *str = va_arg(args, const char *) ?: "(null)";
+            size_t len = strnlen(str, end - ptr);
+            if (ptr + len + 1 > end)
+                return -1;
+            memcpy(ptr, str, len);
+            ptr[len] = 0;
+            ptr += len + 1;
+        }
+    }
+
+    #undef PACK
+
+    return ptr - out;
+}
+
+static size_t log_format_record(const log_record_t *record, char *out, size_t size)
+{
+    const uint8_t *args = record->args;
+    const char *fmt = record->format;
+    size_t len = 0;
+    char spec[24];
+    int type, stars;
+
+    if (record->level > RG_LOG_DEBUG)
+        len += snprintf(out, size, "[log:%d] %s: ", record->level, record->context);
+    else if (record->level > RG_LOG_PRINT)
+        len += snprintf(out, size, "[%s] %s: ", log_prefix[record->level], record->context);
+
+    #define UNPACK(type) ({type _v; memcpy(&_v, args, sizeof(type)); args += sizeof(type); _v;})
+    #define APPEND(...) len = RG_MIN(len + snprintf(out + len, size - len, __VA_ARGS__), size - 1)
+
+    while (*fmt && len < size - 1)
+    {
+        const char *next = strchr(fmt, '%');
+        size_t text = next ? (size_t)(next - fmt) : strlen(fmt);
+
+        APPEND("%.*s", (int)text, fmt);
+
+        if (!next)
+            break;
+
+        size_t spec_len = log_parse_spec(next, &type, &stars);
+        size_t pos = 0;
+
+        // Resolve '*' width/precision now so that we only ever pass one argument to snprintf
+        for (size_t i = 0; i < spec_len && pos < sizeof(spec) - 12; i++)
+        {
+            if (next[i] == '*')
+                pos += sprintf(spec + pos, "%d", UNPACK(int));
+            else
+                spec[pos++] = next[i];
+        }
+        spec[pos] = 0;
+        fmt = next + spec_len;
+
+        if (type == LOG_ARG_INT)
+            APPEND(spec, UNPACK(int));
+        else if (type == LOG_ARG_LONG)
+            APPEND(spec, UNPACK(long));
+        else if (type == LOG_ARG_LLONG)
+            APPEND(spec, UNPACK(long long));
+        else if (type == LOG_ARG_DOUBLE)
+            APPEND(spec, UNPACK(double));
+        else if (type == LOG_ARG_PTR)
+            APPEND(spec, UNPACK(void *));
+        else if (type == LOG_ARG_STRING)
+        {
+            APPEND(spec, (const char *)args);
+            args += strlen((const char *)args) + 1;
+        }
+        else if (type == LOG_ARG_NONE)
+            APPEND("%%");
+        else
+            APPEND("%s", spec);
+    }
+
+    #undef UNPACK
+    #undef APPEND
+
+    return len;
+}
+
+static inline void log_output(const char *buffer, size_t len)
+{
+    logbuf_print(&app.log, buffer);
+    fwrite(buffer, len, 1, stdout);
+}
+
+static bool logring_push(const log_record_t *record)
+{
+    size_t size = record->size;
+    bool pushed = false;
+
+    portENTER_CRITICAL(&logRing.lock);
+
+    size_t offset = logRing.head % LOG_RING_SIZE;
+    size_t pad = (LOG_RING_SIZE - offset < size) ? LOG_RING_SIZE - offset : 0;
+
+    if (logRing.head + pad + size - logRing.tail <= LOG_RING_SIZE)
+    {
+        if (pad)
+        {
+            // Records never straddle the end of the ring, a zero size marks the jump back
+            ((log_record_t *)&logRing.buffer[offset])->size = 0;
+            logRing.head += pad;
+            offset = 0;
+        }
+        memcpy(&logRing.buffer[offset], record, size);
+        logRing.head += size;
+        pushed = true;
+    }
+
+    portEXIT_CRITICAL(&logRing.lock);
+
+    return pushed;
+}
+
+// Producers pass a 0 timeout, they must never wait for the logger task. Only the logger (and the
+// callers that need everything written out) block on the lock.
+static bool logring_drain(TickType_t timeout)
+{
+    char buffer[LOG_RECORD_MAX];
+
+    if (!logRing.drainLock)
+        return false;
+
+    // Two drains at once would both consume the records at tail. Going ahead without the lock is
+    // only acceptable once nothing else can run (panic, scheduler stopped).
+    bool forced = logRing.synchronous || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING;
+    bool locked = xSemaphoreTake(logRing.drainLock, forced ? 0 : timeout) == pdTRUE;
+
+    if (!locked && !forced)
+        return false;
+
+    portENTER_CRITICAL(&logRing.lock);
+    size_t lost = logRing.lost;
+    logRing.lost = 0;
+    portEXIT_CRITICAL(&logRing.lock);
+
+    if (lost > 0)
+        log_output(buffer, snprintf(buffer, sizeof(buffer), "[warn] %s: %d messages lost\n", __func__, (int)lost));
+
+    while (logRing.tail != logRing.head)
+    {
+        size_t offset = logRing.tail % LOG_RING_SIZE;
+        log_record_t *record = (log_record_t *)&logRing.buffer[offset];
+
+        if (record->size == 0)
+        {
+            logRing.tail += LOG_RING_SIZE - offset;
+            continue;
+        }
+
+        size_t len = log_format_record(record, buffer, sizeof(buffer));
+        log_output(buffer, len);
+
+        portENTER_CRITICAL(&logRing.lock);
+        logRing.tail += record->size;
+        portEXIT_CRITICAL(&logRing.lock);
+    }
+
+    if (locked)
+        xSemaphoreGive(logRing.drainLock);
+
+    return true;
+}
+
+static void logger_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        logring_drain(portMAX_DELAY);
+    }
+
+    vTaskDelete(NULL);
+}
+
 static void system_monitor_task(void *arg)
 {
     runtime_counters_t current = {0};
+    rg_input_latency_t latency = {0};
     multi_heap_info_t heap_info = {0};
     time_t lastTime = time(NULL);
     bool ledState = false;
@@ -110,6 +442,7 @@ static void system_monitor_task(void *arg)
         current = counters;
         counters.totalFrames = counters.fullFrames = 0;
         counters.skippedFrames = counters.busyTime = 0;
+        counters.rewindTime = 0;
         counters.resetTime = get_elapsed_time();
 
         statistics.battery = rg_input_read_battery();
@@ -117,6 +450,11 @@ static void system_monitor_task(void *arg)
         statistics.skippedFPS = current.skippedFrames / (tickTime / 1000000.f);
         statistics.totalFPS = current.totalFrames / (tickTime / 1000000.f);
         statistics.freeStackMain = uxTaskGetStackHighWaterMark(app.mainTaskHandle);
+        statistics.rewindTime = current.totalFrames ? (float)current.rewindTime / current.totalFrames : 0.f;
+
+        latency = rg_input_get_latency(true);
+        statistics.inputLatency = latency.count ? latency.total / latency.count / 1000.f : 0.f;
+        statistics.inputLatencyMax = latency.max / 1000.f;
 
         heap_caps_get_info(&heap_info, MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
         statistics.freeMemoryInt = heap_info.total_free_bytes;
@@ -137,7 +475,7 @@ static void system_monitor_task(void *arg)
             rg_system_set_led(ledState);
         }
 
-        RG_LOGX("STACK:%d, HEAP:%d+%d (%d+%d), BUSY:%.2f, FPS:%.2f (SKIP:%d, PART:%d, FULL:%d), BATT:%d\n",
+        RG_LOGX("STACK:%d, HEAP:%d+%d (%d+%d), BUSY:%.2f, FPS:%.2f (SKIP:%d, PART:%d, FULL:%d), INPUT:%.1fms, REWIND:%.0fus, BATT:%d\n",
             statistics.freeStackMain,
             statistics.freeMemoryInt / 1024,
             statistics.freeMemoryExt / 1024,
@@ -148,6 +486,8 @@ static void system_monitor_task(void *arg)
             current.skippedFrames,
             current.totalFrames - current.fullFrames - current.skippedFrames,
             current.fullFrames,
+            statistics.inputLatency,
+            statistics.rewindTime,
             statistics.battery.millivolts);
 
         // if (statistics.freeStackMain < 1024)
@@ -200,6 +540,13 @@ IRAM_ATTR void rg_system_tick(bool skippedFrame, bool fullFrame, int busyTime)
     counters.totalFrames++;
     counters.ticks++;
 
+    rg_golden_tick();
+    rg_golden_report();
+
+    counters.rewindTime += rg_rewind_tick();
+
+    rg_sram_tick();
+
     // Reduce the inputTimeout once the emulation is running
     if (counters.ticks == 1)
     {
@@ -207,6 +554,21 @@ IRAM_ATTR void rg_system_tick(bool skippedFrame, bool fullFrame, int busyTime)
     }
 }
 
+IRAM_ATTR bool rg_system_turbo_draw(void)
+{
+    // Frame interval (us) for each speedupEnabled level. In turbo the cores skip rendering and
+    // audio synthesis altogether and only present a frame when this much time has passed.
+    static const int64_t intervals[] = {0, 33333, 100000};
+    static int64_t lastDrawTime = 0;
+    int level = RG_MIN(RG_MAX(app.speedupEnabled, 0), 2);
+
+    if (get_elapsed_time_since(lastDrawTime) < intervals[level])
+        return false;
+
+    lastDrawTime = get_elapsed_time();
+    return true;
+}
+
 runtime_stats_t rg_system_get_stats()
 {
     return statistics;
@@ -237,6 +599,8 @@ rg_app_desc_t *rg_system_init(int sampleRate, const rg_emu_proc_t *handlers)
     spiMutex = xSemaphoreCreateBinary();
     xSemaphoreGive(spiMutex);
     spiMutexOwner = -1;
+    spiMutexEvents = xEventGroupCreate();
+    xEventGroupSetBits(spiMutexEvents, SPI_DISPLAY_IDLE);
     #endif
 
     // Seed C's pseudo random number generator
@@ -256,6 +620,11 @@ rg_app_desc_t *rg_system_init(int sampleRate, const rg_emu_proc_t *handlers)
     if (handlers)
         app.handlers = *handlers;
 
+    // From now on log formatting and output is deferred to a background task
+    logRing.drainLock = xSemaphoreCreateMutex();
+    // Other core than the emulator, like the other writers, or the emulator would starve it
+    xTaskCreatePinnedToCore(&logger_task, "logger", 3072, NULL, 1, &logRing.task, 1);
+
     // Blue LED
     gpio_set_direction(RG_GPIO_LED, GPIO_MODE_OUTPUT);
     gpio_set_level(RG_GPIO_LED, 0);
@@ -327,6 +696,14 @@ rg_app_desc_t *rg_system_init(int sampleRate, const rg_emu_proc_t *handlers)
             rg_gui_alert("SD Card Error", "Invalid ROM Path.");
             rg_system_switch_app(RG_APP_LAUNCHER);
         }
+
+        // A golden run replays a scripted input sequence and checks the output against known hashes
+        if (rg_golden_init(app.romPath))
+        {
+            app.startAction = RG_START_ACTION_NEWGAME;
+        }
+
+        rg_rewind_init();
     }
 
     #ifdef ENABLE_PROFILING
@@ -397,6 +774,18 @@ char *rg_emu_get_path(rg_path_type_t type, const char *_romPath)
             strcat(buffer, fileName);
             break;
 
+        case RG_PATH_GOLDEN_SCRIPT:
+            strcpy(buffer, RG_BASE_PATH_GOLDEN);
+            strcat(buffer, fileName);
+            strcat(buffer, ".inp");
+            break;
+
+        case RG_PATH_GOLDEN_DATA:
+            strcpy(buffer, RG_BASE_PATH_GOLDEN);
+            strcat(buffer, fileName);
+            strcat(buffer, ".crc");
+            break;
+
         default:
             RG_PANIC("Unknown path type");
     }
@@ -416,12 +805,33 @@ bool rg_emu_load_state(int slot)
 
     rg_gui_draw_hourglass();
 
+    // A save might still be on its way to the disk
+    rg_emu_wait_saved_states(-1);
+
     // Increased input timeout, this might take a while
     inputTimeout = INPUT_TIMEOUT * 5;
 
     char *filename = rg_emu_get_path(RG_PATH_SAVE_STATE, app.romPath);
-    bool success = (*app.handlers.loadState)(filename);
-    // bool success = rg_emu_notify(RG_MSG_LOAD_STATE, filename);
+    bool success = false;
+    size_t size = 0;
+    void *buffer;
+
+    switch (rg_state_read(filename, app.name, &buffer, &size))
+    {
+        case RG_STATE_OK:
+            success = rg_emu_load_state_mem(buffer, size);
+            free(buffer);
+            break;
+        case RG_STATE_FOREIGN:
+            // No save yet, or one from before the container, the core knows what to do
+            success = (*app.handlers.loadState)(filename);
+            // success = rg_emu_notify(RG_MSG_LOAD_STATE, filename);
+            if (success)
+                rg_sram_mark_all();
+            break;
+        case RG_STATE_ERROR:
+            break;
+    }
 
     inputTimeout = INPUT_TIMEOUT;
 
@@ -435,33 +845,13 @@ bool rg_emu_load_state(int slot)
     return success;
 }
 
-bool rg_emu_save_state(int slot)
+// Replaces the save state with its freshly written .new file, or discards the .new on failure
+static bool save_state_commit(const char *filename, bool written)
 {
-    if (!app.romPath || !app.handlers.saveState)
-    {
-        RG_LOGE("No rom or handler defined...\n");
-        return false;
-    }
-
-    RG_LOGI("Saving state %d.\n", slot);
-
-    rg_system_set_led(1);
-    rg_gui_draw_hourglass();
-
-    char *filename = rg_emu_get_path(RG_PATH_SAVE_STATE, app.romPath);
     char path_buffer[PATH_MAX + 1];
     bool success = false;
 
-    // Increased input timeout, this might take a while
-    inputTimeout = INPUT_TIMEOUT * 5;
-
-    if (!rg_mkdir(rg_dirname(filename)))
-    {
-        RG_LOGE("Unable to create dir, save might fail...\n");
-    }
-
-    sprintf(path_buffer, "%s.new", filename);
-    if ((*app.handlers.saveState)(path_buffer))
+    if (written)
     {
         sprintf(path_buffer, "%s.bak", filename);
         rename(filename, path_buffer);
@@ -487,10 +877,139 @@ bool rg_emu_save_state(int slot)
         rename(filename, path_buffer);
         sprintf(path_buffer, "%s.new", filename);
         unlink(path_buffer);
+    }
 
-        rg_gui_alert("Save failed", NULL);
+    return success;
+}
+
+static bool save_state_write(const void *buffer, size_t size)
+{
+    char *filename = rg_emu_get_path(RG_PATH_SAVE_STATE, app.romPath);
+    char path_buffer[PATH_MAX + 1];
+
+    if (!rg_mkdir(rg_dirname(filename)))
+    {
+        RG_LOGE("Unable to create dir, save might fail...\n");
+    }
+
+    sprintf(path_buffer, "%s.new", filename);
+    bool success = save_state_commit(filename, rg_state_write(path_buffer, app.name, buffer, size));
+
+    free(filename);
+
+    return success;
+}
+
+static void save_state_task(void *arg)
+{
+    save_state_job_t job;
+
+    while (xQueuePeek(saveStateQueue, &job, portMAX_DELAY) == pdTRUE)
+    {
+        int64_t startTime = get_elapsed_time();
+
+        rg_system_set_led(1);
+        bool success = save_state_write(job.buffer, job.size);
+        rg_system_set_led(0);
+
+        if (success)
+            RG_LOGI("State %d saved in %dms.\n", job.slot, (int)(get_elapsed_time_since(startTime) / 1000));
+
+        free(job.buffer);
+
+        if (job.callback)
+            job.callback(job.slot, success);
+
+        // Only now is the job done, see rg_emu_wait_saved_states
+        xQueueReceive(saveStateQueue, &job, 0);
     }
+
+    vTaskDelete(NULL);
+}
+
+// Serializes the core into a new buffer. Asking the core for the size costs as much as saving,
+// so we start from the size that worked last time and only ask again when it didn't fit.
+static void *save_state_snapshot(size_t *size)
+{
+    size_t capacity = stateSizeHint, tried = 0;
+
+    if (!app.romPath || !app.handlers.saveStateMem)
+        return NULL;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (!capacity)
+        {
+            // Some cores' states grow a little (mapper blocks, etc), leave some room
+            size_t needed = rg_emu_get_state_size();
+            if (needed <= tried)
+                break; // It wasn't a matter of size
+            capacity = needed + needed / 8;
+        }
+
+        void *buffer = heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM);
+        if (!buffer)
+            break;
+
+        *size = capacity;
+        if (rg_emu_save_state_mem(buffer, size))
+        {
+            stateSizeHint = capacity;
+            return buffer;
+        }
+
+        free(buffer);
+        tried = capacity;
+        capacity = 0;
+    }
+
+    return NULL;
+}
+
+static bool save_state_direct(int slot)
+{
+    if (!app.romPath || !app.handlers.saveState)
+    {
+        RG_LOGE("No rom or handler defined...\n");
+        return false;
+    }
+
+    RG_LOGI("Saving state %d.\n", slot);
+
+    rg_system_set_led(1);
+    rg_gui_draw_hourglass();
+
+    // Don't race a background save to the same file
+    rg_emu_wait_saved_states(-1);
+
+    char *filename = rg_emu_get_path(RG_PATH_SAVE_STATE, app.romPath);
+    char path_buffer[PATH_MAX + 1];
+
+    // Increased input timeout, this might take a while
+    inputTimeout = INPUT_TIMEOUT * 5;
+
+    if (!rg_mkdir(rg_dirname(filename)))
+    {
+        RG_LOGE("Unable to create dir, save might fail...\n");
+    }
+
+    sprintf(path_buffer, "%s.new", filename);
+
+    size_t size = 0;
+    void *buffer = save_state_snapshot(&size);
+    bool written;
+
+    // Go through the container when the core can save to memory, it's smaller and faster to write
+    if (buffer)
+        written = rg_state_write(path_buffer, app.name, buffer, size);
     else
+        written = (*app.handlers.saveState)(path_buffer);
+
+    bool success = save_state_commit(filename, written);
+
+    free(buffer);
+
+    if (success)
     {
         // Save succeeded, let's take a pretty screenshot for the launcher!
         char *fileName = rg_emu_get_path(RG_PATH_SCREENSHOT, app.romPath);
@@ -507,6 +1026,118 @@ bool rg_emu_save_state(int slot)
     return success;
 }
 
+bool rg_emu_save_state(int slot)
+{
+    bool success = save_state_direct(slot);
+
+    if (!success)
+    {
+        rg_gui_alert("Save failed", NULL);
+    }
+
+    return success;
+}
+
+bool rg_emu_save_state_async(int slot, rg_save_callback_t callback)
+{
+    if (!app.romPath || !app.handlers.saveStateMem)
+    {
+        bool success = save_state_direct(slot);
+        if (callback)
+            callback(slot, success);
+        return success;
+    }
+
+    save_state_job_t job = {slot, NULL, 0, callback};
+
+    if (!(job.buffer = save_state_snapshot(&job.size)))
+    {
+        RG_LOGW("Unable to snapshot state %d to memory, saving directly.\n", slot);
+        bool success = save_state_direct(slot);
+        if (callback)
+            callback(slot, success);
+        return success;
+    }
+
+    RG_LOGI("Saving state %d in the background (%d bytes).\n", slot, job.size);
+
+    // The frame will have changed by the time the state is written, capture it now. The PNG is
+    // encoded in the background too, by rg_display_save_frame.
+    char *fileName = rg_emu_get_path(RG_PATH_SCREENSHOT, app.romPath);
+    rg_emu_screenshot(fileName, 160, 0);
+    free(fileName);
+
+    if (!saveStateQueue)
+    {
+        saveStateQueue = xQueueCreate(SAVE_STATE_QUEUE_LENGTH, sizeof(save_state_job_t));
+        // Other core than the emulator, same low priority as the frame saver
+        xTaskCreatePinnedToCore(&save_state_task, "save_state", 4096, NULL, 1, NULL, 1);
+    }
+
+    // Saves issued while others are in flight are written in order. If the queue is full we
+    // block until the oldest is on disk, which bounds the memory held by snapshots.
+    xQueueSend(saveStateQueue, &job, portMAX_DELAY);
+
+    return true;
+}
+
+bool rg_emu_wait_saved_states(int timeout_ms)
+{
+    int64_t startTime = get_elapsed_time();
+
+    while (saveStateQueue && uxQueueMessagesWaiting(saveStateQueue) > 0)
+    {
+        if (timeout_ms >= 0 && get_elapsed_time_since(startTime) > timeout_ms * 1000)
+        {
+            RG_LOGW("Timed out waiting for states to be saved!\n");
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    return true;
+}
+
+size_t rg_emu_get_state_size(void)
+{
+    size_t size = 0;
+
+    if (!app.handlers.saveStateMem || !(*app.handlers.saveStateMem)(NULL, &size))
+        return 0;
+
+    return size;
+}
+
+bool rg_emu_save_state_mem(void *buffer, size_t *size)
+{
+    if (!app.romPath || !app.handlers.saveStateMem)
+    {
+        RG_LOGE("No rom or handler defined...\n");
+        return false;
+    }
+
+    return (*app.handlers.saveStateMem)(buffer, size);
+}
+
+bool rg_emu_load_state_mem(const void *buffer, size_t size)
+{
+    if (!app.romPath || !app.handlers.loadStateMem)
+    {
+        RG_LOGE("No rom or handler defined...\n");
+        return false;
+    }
+
+    // The handlers share a type, loading never writes to the buffer
+    if (!(*app.handlers.loadStateMem)((void *)buffer, &size))
+        return false;
+
+    // The state replaced the whole SRAM, the file must be rewritten entirely or it ends up a mix
+    // of both. This also covers rewind, which loads through here.
+    rg_sram_mark_all();
+
+    return true;
+}
+
 bool rg_emu_screenshot(const char *filename, int width, int height)
 {
     if (!app.handlers.screenshot)
@@ -556,11 +1187,16 @@ void rg_emu_start_game(const char *emulator, const char *romPath, rg_start_actio
     if (emulator)
         rg_system_switch_app(emulator);
     else
-        esp_restart();
+        rg_system_restart();
 }
 
 void rg_system_restart()
 {
+    rg_sram_close();
+    // A state that is half written is a lost state, never give up on it
+    rg_emu_wait_saved_states(-1);
+    rg_display_wait_saved_frames(5000);
+    rg_settings_commit();
     // FIX ME: Ensure the boot loader points to us
     esp_restart();
 }
@@ -574,6 +1210,11 @@ void rg_system_switch_app(const char *app)
 
     rg_system_set_boot_app(app);
 
+    rg_sram_close();
+    // A state that is half written is a lost state, never give up on it
+    rg_emu_wait_saved_states(-1);
+    rg_display_wait_saved_frames(5000);
+    rg_settings_commit();
     rg_audio_deinit();
     rg_sdcard_unmount();
     // rg_display_deinit();
@@ -607,6 +1248,10 @@ void rg_system_set_boot_app(const char *app)
 
 void rg_system_panic(const char *message, const char *context)
 {
+    // Pending messages must reach app.log before it is copied to the panic trace
+    logRing.synchronous = true;
+    logring_drain(0);
+
     if (panicTrace.magicWord != RG_STRUCT_MAGIC)
         begin_panic_trace();
 
@@ -621,25 +1266,57 @@ void rg_system_panic(const char *message, const char *context)
 
 void rg_system_log(int level, const char *context, const char *format, ...)
 {
-    static const char *prefix[] = {"", "error", "warn", "info", "debug"};
-    char buffer[512]; /*static*/
-    size_t len = 0;
+    uint8_t data[LOG_RECORD_MAX] __attribute__((aligned(8)));
+    log_record_t *record = (log_record_t *)data;
+    int args_size = -1;
     va_list args;
 
     if (app.logLevel && level > app.logLevel)
         return;
 
+    // Fast path: the arguments are copied raw and formatted later by the logger task
+    if (logRing.task && !logRing.synchronous)
+    {
+        va_start(args, format);
+        args_size = log_pack_args(record->args, sizeof(data) - sizeof(log_record_t), format, args);
+        va_end(args);
+
+        if (args_size >= 0)
+        {
+            record->size = (sizeof(log_record_t) + args_size + 3) & ~3;
+            record->level = level;
+            record->context = context;
+            record->format = format;
+
+            // The ring is full and someone else is draining it, the message is dropped
+            if (!logring_push(record) && !(logring_drain(0) && logring_push(record)))
+            {
+                portENTER_CRITICAL(&logRing.lock);
+                logRing.lost++;
+                portEXIT_CRITICAL(&logRing.lock);
+            }
+            xTaskNotifyGive(logRing.task);
+            return;
+        }
+    }
+
+    // Slow path: early boot, panic, or a message too big for the ring
+    char *buffer = (char *)data;
+    size_t len = 0;
+
+    // If the logger is busy our message may come out before the queued ones, better than waiting
+    logring_drain(0);
+
     if (level > RG_LOG_DEBUG)
         len += sprintf(buffer, "[log:%d] %s: ", level, context);
     else if (level > RG_LOG_PRINT)
-        len += sprintf(buffer, "[%s] %s: ", prefix[level], context);
+        len += sprintf(buffer, "[%s] %s: ", log_prefix[level], context);
 
     va_start(args, format);
-    len += vsnprintf(buffer + len, sizeof(buffer) - len, format, args);
+    len += vsnprintf(buffer + len, sizeof(data) - len, format, args);
     va_end(args);
 
-    logbuf_print(&app.log, buffer);
-    fwrite(buffer, len, 1, stdout);
+    log_output(buffer, RG_MIN(len, sizeof(data) - 1));
 }
 
 bool rg_system_save_trace(const char *filename, bool panic_trace)
@@ -648,6 +1325,9 @@ bool rg_system_save_trace(const char *filename, bool panic_trace)
     log_buffer_t *log = panic_trace ? &panicTrace.log : &app.log;
     RG_ASSERT(filename, "bad param");
 
+    if (!panic_trace)
+        logring_drain(portMAX_DELAY);
+
     FILE *fp = fopen(filename, "w");
     if (fp)
     {
@@ -663,6 +1343,11 @@ bool rg_system_save_trace(const char *filename, bool panic_trace)
             fprintf(fp, "Panic message: %.256s\n", panicTrace.message);
         if (panic_trace && panicTrace.context[0])
             fprintf(fp, "Panic context: %.256s\n", panicTrace.context);
+        if (!panic_trace)
+        {
+            fputs("\nMemory map:\n", fp);
+            rg_alloc_print_map(fp);
+        }
         fputs("\nLog output:\n", fp);
         for (size_t i = 0; i < LOG_BUFFER_SIZE; i++)
         {
@@ -690,6 +1375,11 @@ void rg_system_sleep()
 
     // Wait for button release
     rg_input_wait_for_key(GAMEPAD_KEY_MENU, false);
+    rg_sram_close();
+    // A state that is half written is a lost state, never give up on it
+    rg_emu_wait_saved_states(-1);
+    rg_display_wait_saved_frames(5000);
+    rg_settings_commit();
     rg_audio_deinit();
     vTaskDelay(100);
     esp_deep_sleep_start();
@@ -719,16 +1409,47 @@ IRAM_ATTR void rg_spi_lock_acquire(spi_lock_res_t owner)
 {
 #if USE_SPI_MUTEX
     if (owner == spiMutexOwner)
-    {
         return;
+
+    rg_spi_lock_stats_t *stats = &spiMutexStats[owner % SPI_LOCK_COUNT];
+    int64_t start = get_elapsed_time();
+    bool contended = false;
+
+    // The display goes first: a late frame is visible, a late read mostly isn't. Our semaphore
+    // doesn't hand itself over to waiters, so the others sleep while the display waits. The
+    // timeout only keeps a display that never gets the bus from starving everyone else.
+    if (owner == SPI_LOCK_DISPLAY)
+    {
+        xEventGroupClearBits(spiMutexEvents, SPI_DISPLAY_IDLE);
     }
-    else if (xSemaphoreTake(spiMutex, pdMS_TO_TICKS(10000)) == pdPASS)
+    else if (!(xEventGroupGetBits(spiMutexEvents) & SPI_DISPLAY_IDLE))
     {
-        spiMutexOwner = owner;
+        contended = true;
+        xEventGroupWaitBits(spiMutexEvents, SPI_DISPLAY_IDLE, pdFALSE, pdTRUE, pdMS_TO_TICKS(100));
     }
-    else
+
+    if (xSemaphoreTake(spiMutex, 0) != pdPASS)
+    {
+        contended = true;
+        if (xSemaphoreTake(spiMutex, pdMS_TO_TICKS(10000)) != pdPASS)
+            RG_PANIC("SPI Mutex Lock Acquisition failed!");
+    }
+
+    if (owner == SPI_LOCK_DISPLAY)
+    {
+        xEventGroupSetBits(spiMutexEvents, SPI_DISPLAY_IDLE);
+    }
+
+    spiMutexOwner = owner;
+
+    // Only the lock holder updates its stats
+    stats->count++;
+    if (contended)
     {
-        RG_PANIC("SPI Mutex Lock Acquisition failed!");
+        uint32_t elapsed = get_elapsed_time_since(start);
+        stats->contended++;
+        stats->waitTime += elapsed;
+        stats->maxWaitTime = RG_MAX(stats->maxWaitTime, elapsed);
     }
 #endif
 }
@@ -744,10 +1465,19 @@ IRAM_ATTR void rg_spi_lock_release(spi_lock_res_t owner)
 #endif
 }
 
+rg_spi_lock_stats_t rg_spi_lock_get_stats(spi_lock_res_t owner)
+{
+#if USE_SPI_MUTEX
+    return spiMutexStats[owner % SPI_LOCK_COUNT];
+#else
+    return (rg_spi_lock_stats_t){0};
+#endif
+}
+
 // Note: You should use calloc/malloc everywhere possible. This function is used to ensure
 // that some memory is put in specific regions for performance or hardware reasons.
 // Memory from this function should be freed with free()
-void *rg_alloc(size_t size, uint32_t mem_type)
+void *rg_alloc_tagged(size_t size, uint32_t mem_type, const char *tag)
 {
     uint32_t caps = 0;
 
@@ -759,24 +1489,98 @@ void *rg_alloc(size_t size, uint32_t mem_type)
 
     void *ptr = heap_caps_calloc(1, size, caps);
 
-    RG_LOGX("[RG_ALLOC] SIZE: %u  [SPIRAM: %u; 32BIT: %u; DMA: %u]  PTR: %p\n",
-            size, (caps & MALLOC_CAP_SPIRAM) != 0, (caps & MALLOC_CAP_32BIT) != 0,
-            (caps & MALLOC_CAP_DMA) != 0, ptr);
-
     if (!ptr)
     {
-        size_t availaible = heap_caps_get_largest_free_block(caps);
+        size_t available = heap_caps_get_largest_free_block(caps);
 
         // Loosen the caps and try again
         ptr = heap_caps_calloc(1, size, caps & ~(MALLOC_CAP_SPIRAM|MALLOC_CAP_INTERNAL));
         if (!ptr)
         {
-            RG_LOGX("[RG_ALLOC] ^-- Allocation failed! (available: %d)\n", availaible);
+            RG_LOGE("Allocation of %u bytes from '%s' failed! (largest block: %d)\n", size, tag, available);
             RG_PANIC("Memory allocation failed!");
         }
 
-        RG_LOGX("[RG_ALLOC] ^-- CAPS not fully met! (available: %d)\n", availaible);
+        RG_LOGW("Allocation of %u bytes from '%s' doesn't meet its caps! (largest block: %d)\n", size, tag, available);
+    }
+
+    bool external = esp_ptr_external_ram(ptr);
+
+    if (external && (mem_type & MEM_FAST))
+    {
+        RG_LOGW("MEM_FAST request of %u bytes from '%s' fell back to slow memory!\n", size, tag);
+    }
+
+    portENTER_CRITICAL(&allocLock);
+
+    rg_alloc_stats_t *stats = NULL;
+    for (size_t i = 0; i < allocTagsCount && !stats; i++)
+    {
+        if (allocTags[i].tag == tag || strcmp(allocTags[i].tag, tag) == 0)
+            stats = &allocTags[i];
+    }
+    // When the table is full the last slot collects everything else
+    if (!stats && allocTagsCount < ALLOC_TAGS_MAX - 1)
+    {
+        stats = &allocTags[allocTagsCount++];
+        stats->tag = tag;
+    }
+    else if (!stats)
+    {
+        stats = &allocTags[ALLOC_TAGS_MAX - 1];
+        stats->tag = "(other)";
+        allocTagsCount = ALLOC_TAGS_MAX;
     }
 
+    stats->count++;
+    if (external)
+        stats->external += size;
+    else
+        stats->internal += size;
+    if (external && (mem_type & MEM_FAST))
+        stats->fallbacks++;
+
+    if (allocMapCount < ALLOC_MAP_MAX)
+        allocMap[allocMapCount++] = (alloc_map_entry_t){ptr, size, mem_type, tag};
+
+    portEXIT_CRITICAL(&allocLock);
+
     return ptr;
 }
+
+const rg_alloc_stats_t *rg_alloc_get_stats(size_t *count)
+{
+    if (count)
+        *count = allocTagsCount;
+    return allocTags;
+}
+
+void rg_alloc_print_map(FILE *fp)
+{
+    static const char *types[] = {"ANY", "SLOW", "FAST", "FAST|SLOW"};
+    uint32_t internal = 0, external = 0, fallbacks = 0;
+
+    fputs("Allocated since boot, freed buffers are still counted\n", fp);
+    fputs("Tag                              Count   Internal   External  Fallbacks\n", fp);
+    for (size_t i = 0; i < allocTagsCount; i++)
+    {
+        const rg_alloc_stats_t *stats = &allocTags[i];
+        fprintf(fp, "%-32.32s %5d %10d %10d %10d\n", stats->tag, stats->count,
+            stats->internal, stats->external, stats->fallbacks);
+        internal += stats->internal;
+        external += stats->external;
+        fallbacks += stats->fallbacks;
+    }
+    fprintf(fp, "%-32s %5s %10d %10d %10d\n\n", "Total", "", internal, external, fallbacks);
+
+    fputs("Address     Region     Size  Requested  Tag\n", fp);
+    for (size_t i = 0; i < allocMapCount; i++)
+    {
+        const alloc_map_entry_t *entry = &allocMap[i];
+        fprintf(fp, "%p  %-8s %7d  %-9s  %s\n", entry->ptr,
+            esp_ptr_external_ram(entry->ptr) ? "PSRAM" : "Internal",
+            entry->size, types[entry->type & 3], entry->tag);
+    }
+    if (allocMapCount == ALLOC_MAP_MAX)
+        fputs("(map full, later allocations are only counted above)\n", fp);
+}
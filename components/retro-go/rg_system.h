@@ -27,6 +27,11 @@ extern "C" {
 #include "rg_profiler.h"
 #include "rg_settings.h"
 #include "rg_cheats.h"
+#include "rg_golden.h"
+#include "rg_rewind.h"
+#include "rg_state.h"
+#include "rg_sram.h"
+#include "rg_rom.h"
 
 typedef enum
 {
@@ -58,6 +63,8 @@ typedef enum
     RG_PATH_SAVE_SRAM,
     RG_PATH_ROM_FILE,
     RG_PATH_ART_FILE,
+    RG_PATH_GOLDEN_SCRIPT,
+    RG_PATH_GOLDEN_DATA,
 } rg_path_type_t;
 
 typedef enum
@@ -66,6 +73,7 @@ typedef enum
     SPI_LOCK_SDCARD = 1,
     SPI_LOCK_DISPLAY = 2,
     SPI_LOCK_OTHER = 3,
+    SPI_LOCK_COUNT,
 } spi_lock_res_t;
 
 enum {
@@ -82,7 +90,9 @@ enum {
 #define RG_APP_FACTORY  NULL
 
 typedef bool (*rg_state_handler_t)(const char *filename);
+typedef bool (*rg_state_mem_handler_t)(void *buffer, size_t *size);
 typedef bool (*rg_reset_handler_t)(bool hard);
+typedef void (*rg_save_callback_t)(int slot, bool success); // Writer task, or caller if saved in place
 typedef bool (*rg_message_handler_t)(int msg, void *arg);
 typedef bool (*rg_screenshot_handler_t)(const char *filename, int width, int height);
 typedef int  (*rg_mem_read_handler_t)(int addr);
@@ -92,6 +102,9 @@ typedef struct
 {
     rg_state_handler_t loadState;
     rg_state_handler_t saveState;
+    rg_state_mem_handler_t loadStateMem; // Same as loadState but from a buffer of *size bytes
+    rg_state_mem_handler_t saveStateMem; // *size is the buffer's capacity in, bytes used out.
+                                         // A NULL buffer only computes the size.
     rg_reset_handler_t reset;
     rg_message_handler_t message;
     rg_netplay_handler_t netplay;
@@ -133,6 +146,7 @@ typedef struct
     uint32_t skippedFrames;
     uint32_t fullFrames;
     uint32_t busyTime;
+    uint32_t rewindTime;
     uint64_t resetTime;
     uint32_t ticks;
 } runtime_counters_t;
@@ -149,6 +163,9 @@ typedef struct
     uint32_t freeBlockInt;
     uint32_t freeBlockExt;
     uint32_t freeStackMain;
+    float inputLatency;     // Average ms between a key edge and the emulator seeing it
+    float inputLatencyMax;
+    float rewindTime;       // Average us per frame spent taking or restoring rewind snapshots
 } runtime_stats_t;
 
 rg_app_desc_t *rg_system_init(int sampleRate, const rg_emu_proc_t *handlers);
@@ -162,6 +179,7 @@ bool rg_system_find_app(const char *app);
 void rg_system_set_led(int value);
 int  rg_system_get_led(void);
 void rg_system_tick(bool skippedFrame, bool fullFrame, int busyTime);
+bool rg_system_turbo_draw(void);
 void rg_system_log(int level, const char *context, const char *format, ...);
 bool rg_system_save_trace(const char *filename, bool append);
 rg_app_desc_t *rg_system_get_app();
@@ -173,6 +191,11 @@ void rg_system_time_save();
 char *rg_emu_get_path(rg_path_type_t type, const char *romPath);
 bool rg_emu_save_state(int slot);
 bool rg_emu_load_state(int slot);
+bool rg_emu_save_state_async(int slot, rg_save_callback_t callback);
+bool rg_emu_wait_saved_states(int timeout_ms); // A negative timeout waits for as long as it takes
+size_t rg_emu_get_state_size(void);
+bool rg_emu_save_state_mem(void *buffer, size_t *size);
+bool rg_emu_load_state_mem(const void *buffer, size_t size);
 bool rg_emu_reset(int hard);
 bool rg_emu_notify(int msg, void *arg);
 bool rg_emu_screenshot(const char *filename, int width, int height);
@@ -181,10 +204,33 @@ void rg_emu_start_game(const char *emulator, const char *romPath, rg_start_actio
 int32_t rg_system_get_startup_app(void);
 void rg_system_set_startup_app(int32_t value);
 
+typedef struct
+{
+    uint32_t count;         // Acquisitions
+    uint32_t contended;     // Acquisitions that had to wait
+    uint32_t waitTime;      // Total, in us
+    uint32_t maxWaitTime;   // In us
+} rg_spi_lock_stats_t;
+
 void rg_spi_lock_acquire(spi_lock_res_t);
 void rg_spi_lock_release(spi_lock_res_t);
+rg_spi_lock_stats_t rg_spi_lock_get_stats(spi_lock_res_t owner);
 
-void *rg_alloc(size_t size, uint32_t caps);
+typedef struct
+{
+    const char *tag;
+    uint32_t count;
+    uint32_t internal;      // Bytes placed in internal RAM since boot, frees aren't tracked
+    uint32_t external;      // Bytes placed in PSRAM since boot, frees aren't tracked
+    uint32_t fallbacks;     // MEM_FAST requests that had to be placed in PSRAM
+} rg_alloc_stats_t;
+
+void *rg_alloc_tagged(size_t size, uint32_t caps, const char *tag);
+const rg_alloc_stats_t *rg_alloc_get_stats(size_t *count);
+void rg_alloc_print_map(FILE *fp);
+
+// Allocations are tagged with the caller's name, use rg_alloc_tagged for buffers worth naming
+#define rg_alloc(size, caps) rg_alloc_tagged(size, caps, __func__)
 
 #define MEM_ANY   (0)
 #define MEM_SLOW  (1)
@@ -213,11 +259,18 @@ extern uint32_t crc32_le(uint32_t crc, const uint8_t * buf, uint32_t len);
 #define RG_PANIC(x) rg_system_panic(x, __FUNCTION__)
 #define RG_ASSERT(cond, msg) while (!(cond)) { RG_PANIC("Assertion failed: `" #cond "` : " msg); }
 
-#define RG_LOGX(x, ...) rg_system_log(RG_LOG_PRINT, __func__, x, ## __VA_ARGS__)
-#define RG_LOGE(x, ...) rg_system_log(RG_LOG_ERROR, __func__, x, ## __VA_ARGS__)
-#define RG_LOGW(x, ...) rg_system_log(RG_LOG_WARN, __func__, x, ## __VA_ARGS__)
-#define RG_LOGI(x, ...) rg_system_log(RG_LOG_INFO, __func__, x, ## __VA_ARGS__)
-#define RG_LOGD(x, ...) rg_system_log(RG_LOG_DEBUG, __func__, x, ## __VA_ARGS__)
+// Messages above this level are compiled out entirely (arguments aren't evaluated)
+#ifndef RG_LOG_LEVEL_MAX
+#define RG_LOG_LEVEL_MAX RG_LOG_INFO
+#endif
+
+// The format must be a string literal, it is referenced (not copied) until the message is printed
+#define RG_LOG(level, x, ...) do { if ((level) <= RG_LOG_LEVEL_MAX) rg_system_log(level, __func__, x, ## __VA_ARGS__); } while (0)
+#define RG_LOGX(x, ...) RG_LOG(RG_LOG_PRINT, x, ## __VA_ARGS__)
+#define RG_LOGE(x, ...) RG_LOG(RG_LOG_ERROR, x, ## __VA_ARGS__)
+#define RG_LOGW(x, ...) RG_LOG(RG_LOG_WARN, x, ## __VA_ARGS__)
+#define RG_LOGI(x, ...) RG_LOG(RG_LOG_INFO, x, ## __VA_ARGS__)
+#define RG_LOGD(x, ...) RG_LOG(RG_LOG_DEBUG, x, ## __VA_ARGS__)
 
 #define RG_DUMP(...) {}
 
@@ -19,3 +19,7 @@ PROJECT_APPS = {
   'handy-go':     [0,  393216],
   'snes9x-go':    [0,  851968], # 1048576
 }
+PROJECT_DATA = {
+  # Label          Type, Sub, Size
+  'romcache':     [1,  0x40, 4194304], # ROM staging, see rg_rom.c
+}
@@ -36,6 +36,7 @@ typedef unsigned int addr_t; // Most efficient but at least 16 bits
 extern void sys_vsync(void);
 extern void sys_panic(char *);
 extern void sys_log(int type, const char *format, ...);
+extern void sys_latch_pad(void);
 
 /* emu.c */
 void emu_init();
@@ -25,6 +25,10 @@ static const char *mbc_names[16] = {
 static FILE* fpRomFile = NULL;
 static FILE *fpSramFile = NULL;
 
+// Set when the launcher staged the ROM to flash, the banks then point into the mapping
+static const byte *romMapped = NULL;
+static int romMappedBanks = 0;
+
 #ifdef IS_LITTLE_ENDIAN
 #define LIL(x) (x)
 #else
@@ -134,6 +138,13 @@ int rom_loadbank(int bank)
 	const size_t BANK_SIZE = 0x4000;
 	const size_t OFFSET = bank * BANK_SIZE;
 
+	if (romMapped)
+	{
+		// Banks past the end of the file mirror the ones we have, like on a real cart
+		rom.bank[bank] = (byte*)romMapped + (bank % romMappedBanks) * BANK_SIZE;
+		return 0;
+	}
+
 	if (rom.bank[bank])
 	{
 		MESSAGE_INFO("bank %d already loaded!\n", bank);
@@ -172,8 +183,14 @@ int rom_load(const char *file)
 {
     MESSAGE_INFO("Loading file: '%s'\n", file);
 
-	fpRomFile = fopen(file, "rb");
-	if (fpRomFile == NULL)
+	size_t mappedSize = 0;
+
+	if ((romMapped = rg_rom_map(file, &mappedSize)))
+	{
+		romMappedBanks = RG_MAX(mappedSize / 0x4000, 1);
+		MESSAGE_INFO("Using the staged ROM, %d banks mapped\n", romMappedBanks);
+	}
+	else if (!(fpRomFile = rg_file_open(file, "rb", 0x4000)))
 	{
 		emu_die("ROM fopen failed");
 	}
@@ -258,6 +275,10 @@ int rom_load(const char *file)
 
 	int preload = mbc.romsize < 64 ? mbc.romsize : 64;
 
+	// Mapped banks cost nothing, all of them are available right away
+	if (romMapped)
+		preload = mbc.romsize;
+
 	if (strncmp(rom.name, "RAYMAN", 6) == 0 || strncmp(rom.name, "NONAME", 6) == 0)
 	{
 		MESSAGE_INFO("Special preloading for Rayman 1/2\n");
@@ -285,10 +306,16 @@ void rom_unload(void)
 {
 	for (int i = 0; i < 512; i++) {
 		if (rom.bank[i]) {
-			free(rom.bank[i]);
+			if (!romMapped)
+				free(rom.bank[i]);
 			rom.bank[i] = NULL;
 		}
 	}
+	if (romMapped) {
+		rg_rom_unmap();
+		romMapped = NULL;
+		romMappedBanks = 0;
+	}
 	free(ram.sbank);
 	ram.sbank = NULL;
 
@@ -322,7 +349,6 @@ int sram_load(const char *file)
 		MESSAGE_INFO("Loading SRAM from '%s'\n", file);
 		if (fread(ram.sbank, 8192, mbc.ramsize, f))
 		{
-			ram.sram_dirty = 0;
 			rtc_load(f);
 			ret = 0;
 		}
@@ -346,7 +372,6 @@ int sram_save(const char *file)
 		MESSAGE_INFO("Saving SRAM to '%s'\n", file);
 		if (fwrite(ram.sbank, 8192, mbc.ramsize, f))
 		{
-			ram.sram_dirty = 0;
 			rtc_save(f);
 			ret = 0;
 		}
@@ -357,62 +382,31 @@ int sram_save(const char *file)
 }
 
 
-int sram_update(const char *file)
+// The SRAM pages are written by rg_sram as they change, only the RTC that follows them is left
+int sram_update_rtc(const char *file)
 {
 	if (!mbc.batt || !mbc.ramsize || !file || !*file)
 		return -1;
 
-	FILE *fp = fopen(file, "wb");
+	FILE *fp = fopen(file, "r+b");
 	if (!fp)
 	{
 		MESSAGE_ERROR("Unable to open SRAM file: %s", file);
-		goto _cleanup;
+		return -1;
 	}
 
-	for (int pos = 0; pos < (mbc.ramsize * 8192); pos += SRAM_SECTOR_SIZE)
-	{
-		int sector = pos / SRAM_SECTOR_SIZE;
-
-		if (ram.sram_dirty_sector[sector])
-		{
-			// MESSAGE_INFO("Writing sram sector #%d @ %ld\n", sector, pos);
-
-			if (fseek(fp, pos, SEEK_SET) != 0)
-			{
-				MESSAGE_ERROR("Failed to seek sram sector #%d\n", sector);
-				goto _cleanup;
-			}
-
-			if (fwrite(&ram.sram[pos], SRAM_SECTOR_SIZE, 1, fp) != 1)
-			{
-				MESSAGE_ERROR("Failed to write sram sector #%d\n", sector);
-				goto _cleanup;
-			}
-
-			ram.sram_dirty_sector[sector] = 0;
-		}
-	}
+	int ret = -1;
 
 	if (fseek(fp, mbc.ramsize * 8192, SEEK_SET) == 0)
 	{
 		rtc_save(fp);
+		ret = 0;
 	}
 
-_cleanup:
-	// Keeping the file open between calls is dangerous unfortunately
+	if (fclose(fp) != 0)
+		ret = -1;
 
-	// if (mbc.romsize < 64)
-	// {
-	// 	fflush(fpSramFile);
-	// }
-	// else
-
-	if (fclose(fp) == 0)
-	{
-		ram.sram_dirty = 0;
-	}
-
-	return 0;
+	return ret;
 }
 
 
@@ -432,14 +426,11 @@ _cleanup:
  *
  */
 
-int state_save(const char *file)
+int state_write(FILE *fp)
 {
 	byte *buf = calloc(1, 4096);
 	if (!buf) return -2;
 
-	FILE *fp = fopen(file, "wb");
-	if (!fp) goto _error;
-
 	sblock_t blocks[] = {
 		{buf, 1},
 		{ram.ibank, hw.cgb ? 8 : 2},
@@ -487,27 +478,22 @@ int state_save(const char *file)
 		}
 	}
 
-	fclose(fp);
 	free(buf);
 
 	return 0;
 
 _error:
-	if (fp) fclose(fp);
-	if (buf) free(buf);
+	free(buf);
 
 	return -1;
 }
 
 
-int state_load(const char *file)
+int state_read(FILE *fp)
 {
 	byte* buf = calloc(1, 4096);
 	if (!buf) return -2;
 
-	FILE *fp = fopen(file, "rb");
-	if (!fp) goto _error;
-
 	sblock_t blocks[] = {
 		{buf, 1},
 		{ram.ibank, hw.cgb ? 8 : 2},
@@ -562,7 +548,6 @@ int state_load(const char *file)
 	memcpy(lcd.oam.mem, buf+oamofs, sizeof lcd.oam);
 	memcpy(snd.wave, buf+wavofs, sizeof snd.wave);
 
-	fclose(fp);
 	free(buf);
 
 	pal_dirty();
@@ -572,8 +557,34 @@ int state_load(const char *file)
 	return 0;
 
 _error:
-	if (fp) fclose(fp);
-	if (buf) free(buf);
+	free(buf);
 
 	return -1;
 }
+
+
+int state_save(const char *file)
+{
+	FILE *fp = fopen(file, "wb");
+	if (!fp) return -1;
+
+	int ret = state_write(fp);
+
+	if (fclose(fp) != 0)
+		ret = -1;
+
+	return ret;
+}
+
+
+int state_load(const char *file)
+{
+	FILE *fp = fopen(file, "rb");
+	if (!fp) return -1;
+
+	int ret = state_read(fp);
+
+	fclose(fp);
+
+	return ret;
+}
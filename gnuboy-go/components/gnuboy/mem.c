@@ -134,6 +134,7 @@ static inline void ioreg_write(byte r, byte b)
 		break;
 	case RI_P1:
 		REG(r) = b;
+		sys_latch_pad();
 		pad_refresh();
 		break;
 	case RI_SC:
@@ -456,9 +457,7 @@ void IRAM_ATTR mem_write(addr_t a, byte b)
 			if (ram.sram[offset] != b)
 			{
 				ram.sram[offset] = b;
-				ram.sram_dirty_sector[offset / SRAM_SECTOR_SIZE] = 1;
-				ram.sram_dirty = 1;
-				// ram.sram_dirty |= (1 << mbc.rambank);
+				rg_sram_mark(offset);
 			}
 		}
 		break;
@@ -565,10 +564,6 @@ void mem_reset(bool hard)
 		memset(ram.sbank, 0xff, 8192 * mbc.ramsize);
 	}
 
-	// Mark all sectors as dirty and wait for sram_dirty to trigger
-	memset(ram.sram_dirty_sector, 1, 256);
-	ram.sram_dirty = 0;
-
 	mbc.rombank = 1;
 	mbc.rambank = 0;
 	mbc.enableram = 0;
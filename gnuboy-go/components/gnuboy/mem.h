@@ -16,9 +16,6 @@ enum {
 	MBC_MMM01,
 };
 
-// This must be a power of 2
-#define SRAM_SECTOR_SIZE 1024
-
 struct mbc
 {
 	int type;
@@ -51,8 +48,6 @@ struct ram
 		byte (*sbank)[8192];
 		byte *sram;
 	};
-	un32 sram_dirty;
-	byte sram_dirty_sector[256];
 };
 
 
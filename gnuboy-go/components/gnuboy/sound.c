@@ -171,11 +171,101 @@ void sound_reset(bool hard)
 	R_NR52 = 0xF1;
 }
 
+static inline void envelope_skip(sndchan_t *ch, int cycles)
+{
+	if (ch->enlen && (ch->encnt += cycles) >= ch->enlen)
+	{
+		ch->envol += ch->endir * (ch->encnt / ch->enlen);
+		ch->encnt %= ch->enlen;
+		if (ch->envol < 0) ch->envol = 0;
+		if (ch->envol > 15) ch->envol = 15;
+	}
+}
+
+/* Fast-forward version of sound_mix: only the state visible through NR52
+   and the registers is advanced, nothing is synthesized. */
+static void sound_skip()
+{
+	int samples = snd.cycles / RATE;
+	int cycles = samples * RATE;
+
+	snd.cycles -= cycles;
+
+	if (S1.on)
+	{
+		S1.pos += S1.freq * samples;
+
+		if ((R_NR14 & 64) && ((S1.cnt += cycles) >= S1.len))
+			S1.on = 0;
+
+		envelope_skip(&S1, cycles);
+
+		if (S1.swlen && (S1.swcnt += cycles) >= S1.swlen)
+		{
+			int f = S1.swfreq;
+
+			for (; S1.swcnt >= S1.swlen && f <= 2047; S1.swcnt -= S1.swlen)
+			{
+				if (R_NR10 & 8)
+					f -= (f >> (R_NR10 & 7));
+				else
+					f += (f >> (R_NR10 & 7));
+			}
+
+			if (f > 2047)
+				S1.on = 0;
+			else
+			{
+				S1.swfreq = f;
+				R_NR13 = f;
+				R_NR14 = (R_NR14 & 0xF8) | (f>>8);
+				s1_freq();
+			}
+		}
+	}
+
+	if (S2.on)
+	{
+		S2.pos += S2.freq * samples;
+
+		if ((R_NR24 & 64) && ((S2.cnt += cycles) >= S2.len))
+			S2.on = 0;
+
+		envelope_skip(&S2, cycles);
+	}
+
+	if (S3.on)
+	{
+		S3.pos += S3.freq * samples;
+
+		if ((R_NR34 & 64) && ((S3.cnt += cycles) >= S3.len))
+			S3.on = 0;
+	}
+
+	if (S4.on)
+	{
+		S4.pos += S4.freq * samples;
+
+		if ((R_NR44 & 64) && ((S4.cnt += cycles) >= S4.len))
+			S4.on = 0;
+
+		envelope_skip(&S4, cycles);
+	}
+
+	R_NR52 = (R_NR52&0xf0) | S1.on | (S2.on<<1) | (S3.on<<2) | (S4.on<<3);
+}
+
 void sound_mix()
 {
 	if (!RATE || snd.cycles < RATE)
 		return;
 
+	if (pcm.skip)
+	{
+		sound_skip();
+		return;
+	}
+
 	for (; snd.cycles >= RATE; snd.cycles -= RATE)
 	{
 		int l = 0;
@@ -28,6 +28,7 @@ typedef struct
 	int stereo;
 	n16* buf;
 	int pos;
+	int skip; /* Advance the channels without producing samples */
 } pcm_t;
 
 extern pcm_t pcm;
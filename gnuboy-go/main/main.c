@@ -27,7 +27,6 @@ static long skipFrames = 20; // The 20 is to hide startup flicker in some games
 
 static const char *sramFile;
 static long autoSaveSRAM = 0;
-static long autoSaveSRAM_Timer = 0;
 
 #ifdef ENABLE_NETPLAY
 static bool netplay = false;
@@ -61,19 +60,40 @@ static bool load_state_handler(const char *filename)
     }
 
     skipFrames = 0;
-    autoSaveSRAM_Timer = 0;
 
     // TO DO: Call rtc_sync() if a physical RTC is present
     return true;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "wb");
+    bool success = fp && state_write(fp) == 0;
+    return rg_fmemclose(fp, size) && success;
+}
+
+static bool load_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "rb");
+    bool success = fp && state_read(fp) == 0;
+
+    if (!rg_fmemclose(fp, NULL) || !success)
+    {
+        emu_reset(true);
+        sram_load(sramFile);
+        return false;
+    }
+
+    skipFrames = 0;
+    return true;
+}
+
 static bool reset_handler(bool hard)
 {
     emu_reset(hard);
 
     fullFrame = false;
     skipFrames = 20;
-    autoSaveSRAM_Timer = 0;
 
     return true;
 }
@@ -106,6 +126,8 @@ static dialog_return_t sram_save_now_cb(dialog_option_t *option, dialog_event_t
 {
     if (event == RG_DIALOG_ENTER)
     {
+        // Let the background writer finish first, we're rewriting the whole file
+        rg_sram_flush(true);
         rg_system_set_led(1);
 
         if (sram_save(sramFile) != 0)
@@ -131,6 +153,7 @@ static dialog_return_t sram_autosave_cb(dialog_option_t *option, dialog_event_t
     if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
     {
         rg_settings_set_app_int32(SETTING_SAVESRAM, autoSaveSRAM);
+        rg_sram_set_delay(autoSaveSRAM);
     }
 
     if (autoSaveSRAM == 0) strcpy(option->value, "Off ");
@@ -211,16 +234,34 @@ static void screen_blit(void)
 
 static void auto_sram_update(void)
 {
-    if (autoSaveSRAM > 0 && ram.sram_dirty)
+    // The pages are saved in the background as they change, but the menu might lead to
+    // a power off so we don't wait for the delay. The clock isn't in SRAM, save it too.
+    if (autoSaveSRAM > 0 && mbc.batt && mbc.ramsize)
     {
-        rg_system_set_led(1);
-        sram_update(sramFile);
-        if (ram.sram_dirty)
-        {
-            MESSAGE_ERROR("sram still dirty after sram_update(), trying full save...\n");
-            sram_save(sramFile);
-        }
-        rg_system_set_led(0);
+        rg_sram_flush(true);
+        if (mbc.rtc)
+            sram_update_rtc(sramFile);
+    }
+}
+
+static inline void set_pad(gamepad_state_t joystick)
+{
+    pad_set(PAD_UP, joystick & GAMEPAD_KEY_UP);
+    pad_set(PAD_RIGHT, joystick & GAMEPAD_KEY_RIGHT);
+    pad_set(PAD_DOWN, joystick & GAMEPAD_KEY_DOWN);
+    pad_set(PAD_LEFT, joystick & GAMEPAD_KEY_LEFT);
+    pad_set(PAD_SELECT, joystick & GAMEPAD_KEY_SELECT);
+    pad_set(PAD_START, joystick & GAMEPAD_KEY_START);
+    pad_set(PAD_A, joystick & GAMEPAD_KEY_A);
+    pad_set(PAD_B, joystick & GAMEPAD_KEY_B);
+}
+
+void sys_latch_pad(void)
+{
+    // Called whenever the game selects a row of P1, right before it reads the keys
+    if (rg_input_get_late_latch())
+    {
+        set_pad(rg_input_latch_gamepad());
     }
 }
 
@@ -229,6 +270,8 @@ void app_main(void)
     rg_emu_proc_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .netplay = NULL,
         .screenshot = &screenshot_handler,
@@ -242,8 +285,8 @@ void app_main(void)
     frames[0].stride = GB_WIDTH * 2;
     frames[1] = frames[0];
 
-    frames[0].buffer = rg_alloc(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY);
-    frames[1].buffer = rg_alloc(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY);
+    frames[0].buffer = rg_alloc_tagged(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY, "framebuffer");
+    frames[1].buffer = rg_alloc_tagged(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY, "framebuffer");
 
     autoSaveSRAM = rg_settings_get_app_int32(SETTING_SAVESRAM, 0);
     sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, 0);
@@ -276,6 +319,13 @@ void app_main(void)
 
     emu_init();
 
+    // Before the state is loaded, rg_sram_open reads the file into ram.sram
+    if (mbc.batt && mbc.ramsize)
+    {
+        rg_sram_open(sramFile, ram.sram, mbc.ramsize * 8192, false);
+        rg_sram_set_delay(autoSaveSRAM);
+    }
+
     if (app->startAction == RG_START_ACTION_RESUME)
     {
         rg_emu_load_state(0);
@@ -287,7 +337,7 @@ void app_main(void)
 
     while (true)
     {
-        uint32_t joystick = rg_input_read_gamepad();
+        uint32_t joystick = rg_input_read_frame();
 
         if (joystick & GAMEPAD_KEY_MENU) {
             auto_sram_update();
@@ -306,38 +356,22 @@ void app_main(void)
         int64_t startTime = get_elapsed_time();
         bool drawFrame = !skipFrames;
 
-        pad_set(PAD_UP, joystick & GAMEPAD_KEY_UP);
-        pad_set(PAD_RIGHT, joystick & GAMEPAD_KEY_RIGHT);
-        pad_set(PAD_DOWN, joystick & GAMEPAD_KEY_DOWN);
-        pad_set(PAD_LEFT, joystick & GAMEPAD_KEY_LEFT);
-        pad_set(PAD_SELECT, joystick & GAMEPAD_KEY_SELECT);
-        pad_set(PAD_START, joystick & GAMEPAD_KEY_START);
-        pad_set(PAD_A, joystick & GAMEPAD_KEY_A);
-        pad_set(PAD_B, joystick & GAMEPAD_KEY_B);
+        set_pad(joystick);
 
-        emu_run(drawFrame);
+        pcm.skip = app->speedupEnabled;
 
-        if (autoSaveSRAM > 0)
-        {
-            if (ram.sram_dirty && autoSaveSRAM_Timer == 0)
-            {
-                autoSaveSRAM_Timer = autoSaveSRAM * 60;
-            }
-
-            if (autoSaveSRAM_Timer > 0 && --autoSaveSRAM_Timer == 0)
-            {
-                auto_sram_update();
-                skipFrames += 5;
-            }
-        }
+        emu_run(drawFrame);
 
         long elapsed = get_elapsed_time_since(startTime);
 
-        if (skipFrames == 0)
+        if (app->speedupEnabled)
+        {
+            // Turbo: no rendering or audio synthesis, only present a frame now and then
+            skipFrames = rg_system_turbo_draw() ? 0 : 1;
+        }
+        else if (skipFrames == 0)
         {
-            if (app->speedupEnabled)
-                skipFrames = app->speedupEnabled * 2;
-            else if (elapsed >= get_frame_time(60)) // Frame took too long
+            if (elapsed >= get_frame_time(60)) // Frame took too long
                 skipFrames = 1;
             else if (drawFrame && fullFrame) // This could be avoided when scaling != full
                 skipFrames = 1;
@@ -3376,6 +3376,12 @@ inline void CMikie::UpdateSound(void)
    int samples = (gSystemCycleCount-gAudioLastUpdateCycle)/HANDY_AUDIO_SAMPLE_PERIOD;
    if (samples == 0) return;
 
+   // Fast-forward, the channels are still clocked by UpdateCalcSound
+   if (gAudioSkip) {
+      gAudioLastUpdateCycle += samples * HANDY_AUDIO_SAMPLE_PERIOD;
+      return;
+   }
+
    int cur_lsample = 0;
    int cur_rsample = 0;
 
@@ -78,6 +78,7 @@ ULONG   gTimerCount=0;
 ULONG   gRenderFrame=1;
 
 ULONG   gAudioEnabled=FALSE;
+ULONG   gAudioSkip=FALSE;
 SWORD   *gAudioBuffer;//[HANDY_AUDIO_BUFFER_SIZE];
 ULONG   gAudioBufferPointer=0;
 ULONG   gAudioLastUpdateCycle=0;
@@ -118,6 +118,7 @@ extern ULONG    gTimerCount;
 extern ULONG    gRenderFrame;
 
 extern ULONG    gAudioEnabled;
+extern ULONG    gAudioSkip;
 extern SWORD    *gAudioBuffer;
 extern ULONG    gAudioBufferPointer;
 extern ULONG    gAudioLastUpdateCycle;
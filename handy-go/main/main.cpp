@@ -144,6 +144,26 @@ static bool load_state_handler(const char *filename)
     return ret;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "wb");
+    bool ret = fp && lynx->ContextSave(fp);
+    return rg_fmemclose(fp, size) && ret;
+}
+
+static bool load_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "rb");
+    bool ret = fp && lynx->ContextLoad(fp);
+
+    if (!rg_fmemclose(fp, NULL) || !ret)
+    {
+        lynx->Reset();
+        return false;
+    }
+    return true;
+}
+
 static bool reset_handler(bool hard)
 {
     // This isn't nice but lynx->Reset() crashes...
@@ -157,6 +177,8 @@ extern "C" void app_main(void)
     rg_emu_proc_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .netplay = NULL,
         .screenshot = &screenshot_handler,
@@ -171,8 +193,8 @@ extern "C" void app_main(void)
     frames[1] = frames[0];
 
     // the HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH is deliberate because of rotation
-    frames[0].buffer = (void*)rg_alloc(HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH * 2, MEM_FAST);
-    frames[1].buffer = (void*)rg_alloc(HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH * 2, MEM_FAST);
+    frames[0].buffer = (void*)rg_alloc_tagged(HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH * 2, MEM_FAST, "framebuffer");
+    frames[1].buffer = (void*)rg_alloc_tagged(HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH * 2, MEM_FAST, "framebuffer");
 
     // The Lynx has a variable framerate but 60 is typical
     app->refreshRate = 60;
@@ -203,7 +225,7 @@ extern "C" void app_main(void)
     // Start emulation
     while (1)
     {
-        uint32_t joystick = rg_input_read_gamepad();
+        uint32_t joystick = rg_input_read_frame();
 
         if (joystick & GAMEPAD_KEY_MENU) {
             rg_gui_game_menu();
@@ -232,6 +254,8 @@ extern "C" void app_main(void)
 
         lynx->SetButtonData(buttons);
 
+        gAudioSkip = app->speedupEnabled;
+
         lynx->UpdateFrame(drawFrame);
 
         if (drawFrame)
@@ -247,12 +271,15 @@ extern "C" void app_main(void)
         long elapsed = get_elapsed_time_since(startTime);
 
         // See if we need to skip a frame to keep up
-        if (skipFrames == 0)
+        if (app->speedupEnabled)
+        {
+            // Turbo: no rendering or audio synthesis, only present a frame now and then
+            skipFrames = rg_system_turbo_draw() ? 0 : 1;
+        }
+        else if (skipFrames == 0)
         {
-            if (app->speedupEnabled)
-                skipFrames += app->speedupEnabled * 2.5;
             // The Lynx uses a variable framerate so we use the count of generated audio samples as reference instead
-            else if (elapsed > ((gAudioBufferPointer/2) * sampleTime))
+            if (elapsed > ((gAudioBufferPointer/2) * sampleTime))
                 skipFrames += 1;
             else if (drawFrame && fullFrame) // This could be avoided when scaling != full
                 skipFrames += 1;
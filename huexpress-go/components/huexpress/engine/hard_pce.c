@@ -86,7 +86,8 @@ void
 pce_term(void)
 {
     if (PCE.ExRAM) free(PCE.ExRAM);
-    if (PCE.ROM) free(PCE.ROM);
+    if (PCE.ROM && PCE.ROM_MAPPED) rg_rom_unmap();
+    else if (PCE.ROM) free(PCE.ROM);
 }
 
 
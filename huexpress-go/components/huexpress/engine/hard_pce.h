@@ -104,6 +104,9 @@ typedef struct {
 	// ROM memory
 	uint8_t *ROM, *ROM_DATA;
 
+	// ROM points to the staged copy in flash
+	bool ROM_MAPPED;
+
 	// ROM size in 0x2000 blocks
 	uint16_t ROM_SIZE;
 
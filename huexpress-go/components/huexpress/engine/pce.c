@@ -75,39 +75,57 @@ int
 LoadCard(const char *name)
 {
 	int fsize, offset;
+	size_t mapped_size = 0;
 
 	MESSAGE_INFO("Opening %s...\n", name);
 
-	FILE *fp = fopen(name, "rb");
+	if (PCE.ROM != NULL) {
+		if (PCE.ROM_MAPPED)
+			rg_rom_unmap();
+		else
+			free(PCE.ROM);
+		PCE.ROM = NULL;
+	}
 
-	if (fp == NULL)
+	// The launcher staged the ROM to flash, read it in place
+	if ((PCE.ROM = (uint8_t *)rg_rom_map(name, &mapped_size)))
 	{
-		MESSAGE_ERROR("Failed to open %s!\n", name);
-		return -1;
+		MESSAGE_INFO("Using the staged ROM\n");
+		PCE.ROM_MAPPED = true;
+		fsize = mapped_size;
 	}
+	else
+	{
+		FILE *fp = fopen(name, "rb");
 
-	if (PCE.ROM != NULL) {
-		free(PCE.ROM);
-	}
+		if (fp == NULL)
+		{
+			MESSAGE_ERROR("Failed to open %s!\n", name);
+			return -1;
+		}
 
-	// find file size
-	fseek(fp, 0, SEEK_END);
-	fsize = ftell(fp);
-	offset = fsize & 0x1fff;
+		// find file size
+		fseek(fp, 0, SEEK_END);
+		fsize = ftell(fp);
 
-	// read ROM
-	PCE.ROM = osd_alloc(fsize);
+		// read ROM
+		PCE.ROM = osd_alloc(fsize);
+		PCE.ROM_MAPPED = false;
 
-	if (PCE.ROM == NULL)
-	{
-		MESSAGE_ERROR("Failed to allocate ROM buffer!\n");
-		return -1;
-	}
+		if (PCE.ROM == NULL)
+		{
+			MESSAGE_ERROR("Failed to allocate ROM buffer!\n");
+			fclose(fp);
+			return -1;
+		}
 
-	fseek(fp, 0, SEEK_SET);
-	fread(PCE.ROM, 1, fsize, fp);
+		fseek(fp, 0, SEEK_SET);
+		rg_file_read(fp, PCE.ROM, fsize);
 
-	fclose(fp);
+		fclose(fp);
+	}
+
+	offset = fsize & 0x1fff;
 
 	PCE.ROM_SIZE = (fsize - offset) / 0x2000;
 	PCE.ROM_DATA = PCE.ROM + offset;
@@ -135,6 +153,22 @@ LoadCard(const char *name)
 	{
 		MESSAGE_INFO("This rom is probably US encrypted, decrypting...\n");
 
+		// Decrypting writes to the ROM, the mapping is read-only
+		if (PCE.ROM_MAPPED)
+		{
+			uint8_t *copy = osd_alloc(fsize);
+			if (copy == NULL)
+			{
+				MESSAGE_ERROR("Failed to allocate ROM buffer!\n");
+				return -1;
+			}
+			memcpy(copy, PCE.ROM, fsize);
+			rg_rom_unmap();
+			PCE.ROM = copy;
+			PCE.ROM_DATA = PCE.ROM + offset;
+			PCE.ROM_MAPPED = false;
+		}
+
 		unsigned char inverted_nibble[16] = {
 			0, 8, 4, 12, 2, 10, 6, 14,
 			1, 9, 5, 13, 3, 11, 7, 15
@@ -248,31 +282,22 @@ RunPCE(void)
 
 
 /**
- * Load saved state
+ * Load saved state from an open stream
  */
 int
-LoadState(const char *name)
+LoadStateFromFile(FILE *fp)
 {
-	MESSAGE_INFO("Loading state from %s...\n", name);
-
 	char buffer[512];
 
-	FILE *fp = fopen(name, "rb");
-	if (fp == NULL)
-		return -1;
-
-	fread(&buffer, 8, 1, fp);
-
-	if (memcmp(&buffer, SAVESTATE_HEADER, 8) != 0)
+	if (fread(&buffer, 8, 1, fp) != 1 || memcmp(&buffer, SAVESTATE_HEADER, 8) != 0)
 	{
 		MESSAGE_ERROR("Loading state failed: Header mismatch\n");
-		fclose(fp);
 		return -1;
 	}
 
 	for (int i = 0; SaveStateVars[i].len > 0; i++)
 	{
-		MESSAGE_INFO("Loading %s (%d)\n", SaveStateVars[i].key, SaveStateVars[i].len);
+		MESSAGE_DEBUG("Loading %s (%d)\n", SaveStateVars[i].key, SaveStateVars[i].len);
 		fread(SaveStateVars[i].ptr, SaveStateVars[i].len, 1, fp);
 	}
 
@@ -285,9 +310,45 @@ LoadState(const char *name)
 
 	osd_gfx_set_mode(IO_VDC_SCREEN_WIDTH, IO_VDC_SCREEN_HEIGHT);
 
+	return 0;
+}
+
+
+/**
+ * Save current state to an open stream
+ */
+int
+SaveStateToFile(FILE *fp)
+{
+	fwrite(SAVESTATE_HEADER, sizeof(SAVESTATE_HEADER), 1, fp);
+
+	for (int i = 0; SaveStateVars[i].len > 0; i++)
+	{
+		MESSAGE_DEBUG("Saving %s (%d)\n", SaveStateVars[i].key, SaveStateVars[i].len);
+		fwrite(SaveStateVars[i].ptr, SaveStateVars[i].len, 1, fp);
+	}
+
+	return ferror(fp) ? -1 : 0;
+}
+
+
+/**
+ * Load saved state
+ */
+int
+LoadState(const char *name)
+{
+	MESSAGE_INFO("Loading state from %s...\n", name);
+
+	FILE *fp = fopen(name, "rb");
+	if (fp == NULL)
+		return -1;
+
+	int ret = LoadStateFromFile(fp);
+
 	fclose(fp);
 
-	return 0;
+	return ret;
 }
 
 
@@ -303,17 +364,12 @@ SaveState(const char *name)
 	if (fp == NULL)
 		return -1;
 
-	fwrite(SAVESTATE_HEADER, sizeof(SAVESTATE_HEADER), 1, fp);
+	int ret = SaveStateToFile(fp);
 
-	for (int i = 0; SaveStateVars[i].len > 0; i++)
-	{
-		MESSAGE_INFO("Saving %s (%d)\n", SaveStateVars[i].key, SaveStateVars[i].len);
-		fwrite(SaveStateVars[i].ptr, SaveStateVars[i].len, 1, fp);
-	}
-
-	fclose(fp);
+	if (fclose(fp) != 0)
+		ret = -1;
 
-	return 0;
+	return ret;
 }
 
 
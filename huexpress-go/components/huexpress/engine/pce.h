@@ -19,6 +19,8 @@
 
 int LoadState(const char *name);
 int SaveState(const char *name);
+int LoadStateFromFile(FILE *fp);
+int SaveStateToFile(FILE *fp);
 void ResetPCE(bool);
 void RunPCE(void);
 void ShutdownPCE();
@@ -78,8 +78,8 @@ uint8_t *osd_gfx_framebuffer(void)
 
 void osd_gfx_init(void)
 {
-    framebuffers[0] = rg_alloc(XBUF_WIDTH * XBUF_HEIGHT, MEM_SLOW);
-    framebuffers[1] = rg_alloc(XBUF_WIDTH * XBUF_HEIGHT, MEM_SLOW);
+    framebuffers[0] = rg_alloc_tagged(XBUF_WIDTH * XBUF_HEIGHT, MEM_SLOW, "framebuffer");
+    framebuffers[1] = rg_alloc_tagged(XBUF_WIDTH * XBUF_HEIGHT, MEM_SLOW, "framebuffer");
 
     overscan = rg_settings_get_app_int32(SETTING_OVERSCAN, 1);
 
@@ -144,12 +144,14 @@ void osd_gfx_blit(void)
     }
 
     // See if we need to skip a frame to keep up
-    if (skipFrames == 0)
+    if (app->speedupEnabled)
+    {
+        // Turbo: no rendering or audio synthesis, only present a frame now and then
+        skipFrames = rg_system_turbo_draw() ? 0 : 1;
+    }
+    else if (skipFrames == 0)
     {
         skipFrames++;
-
-        if (app->speedupEnabled)
-            skipFrames += app->speedupEnabled * 2.5;
     }
     else if (skipFrames > 0)
     {
@@ -208,7 +210,7 @@ int osd_input_init(void)
 
 void osd_input_read(void)
 {
-    uint32_t joystick = rg_input_read_gamepad();
+    uint32_t joystick = rg_input_read_frame();
     uint32_t buttons = 0;
 
     // TO DO: We should pause the audio task when entering a menu...
@@ -242,6 +244,12 @@ static void audioTask(void *arg)
 
     while (1)
     {
+        // The PSG state is only advanced by register writes, we can simply stop mixing in turbo
+        if (app->speedupEnabled)
+        {
+            vTaskDelay(1);
+            continue;
+        }
         psg_update(audiobuffer, AUDIO_BUFFER_LENGTH);
         rg_audio_submit(audiobuffer, AUDIO_BUFFER_LENGTH);
     }
@@ -279,7 +287,11 @@ void osd_vsync(void)
     int64_t curtime = get_elapsed_time();
     int32_t sleep = frametime - (curtime - lasttime);
 
-    if (sleep > frametime)
+    if (app->speedupEnabled)
+    {
+        // Run as fast as we can
+    }
+    else if (sleep > frametime)
     {
         MESSAGE_ERROR("Our vsync timer seems to have overflowed! (%dus)\n", sleep);
     }
@@ -330,6 +342,26 @@ static bool load_state_handler(const char *filename)
     return true;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "wb");
+    bool success = fp && SaveStateToFile(fp) == 0;
+    return rg_fmemclose(fp, size) && success;
+}
+
+static bool load_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "rb");
+    bool success = fp && LoadStateFromFile(fp) == 0;
+
+    if (!rg_fmemclose(fp, NULL) || !success)
+    {
+        ResetPCE(false);
+        return false;
+    }
+    return true;
+}
+
 static bool reset_handler(bool hard)
 {
     ResetPCE(hard);
@@ -341,6 +373,8 @@ void app_main(void)
     rg_emu_proc_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
     };
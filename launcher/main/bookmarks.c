@@ -8,6 +8,8 @@
 #include "images.h"
 #include "gui.h"
 
+#define BOOK_LABEL_SIZE 112
+
 static book_t books[BOOK_TYPE_COUNT];
 
 
@@ -36,6 +38,7 @@ static void event_handler(gui_event_t event, tab_t *tab)
         else
             snprintf(tab->status[0].left, 24, "No %.20s", book ? book->name : "bookmark");
         gui_set_status(tab, NULL, "");
+        gui_prefetch_previews(tab);
     }
     else if (event == TAB_REDRAW)
     {
@@ -43,9 +46,9 @@ static void event_handler(gui_event_t event, tab_t *tab)
     }
     else if (event == TAB_IDLE)
     {
-        if (file && gui.show_preview && gui.idle_counter == (gui.show_preview_fast ? 1 : 8))
+        if (file && gui.show_preview && gui.idle_counter >= (gui.show_preview_fast ? 1 : 8))
             gui_draw_preview(tab, file);
-        else if ((gui.idle_counter % 100) == 0)
+        if ((gui.idle_counter % 100) == 0)
             crc_cache_idle_task(tab);
     }
     else if (event == KEY_PRESS_A)
@@ -73,7 +76,10 @@ static void tab_refresh(book_type_t book_type)
     memset(&book->tab->status, 0, sizeof(book->tab->status));
     book->tab->is_empty = true;
 
-    if (book->count)
+    // The list items point to the labels, they're all reassigned below
+    book->labels = realloc(book->labels, RG_MAX(book->count, 1) * BOOK_LABEL_SIZE);
+
+    if (book->count && book->labels)
     {
         gui_resize_list(book->tab, book->count);
         for (int i = 0; i < book->count; i++)
@@ -81,8 +87,10 @@ static void tab_refresh(book_type_t book_type)
             retro_emulator_file_t *file = &book->items[i];
             if (file->is_valid)
             {
+                char *label = book->labels + i * BOOK_LABEL_SIZE;
                 listbox_item_t *listitem = &book->tab->listbox.items[list_index++];
-                snprintf(listitem->text, 128, "[%-3s] %.100s", file->ext, file->name);
+                snprintf(label, BOOK_LABEL_SIZE, "[%-3s] %.100s", file->ext, file->name);
+                listitem->text = label;
                 listitem->arg = file;
                 listitem->id = i;
                 book->tab->is_empty = false;
@@ -95,11 +103,20 @@ static void tab_refresh(book_type_t book_type)
     if (book->tab->is_empty)
     {
         gui_resize_list(book->tab, 6);
-        sprintf(book->tab->listbox.items[0].text, "Welcome to Retro-Go!");
-        sprintf(book->tab->listbox.items[2].text, "You have no %s games.", book->name);
-        sprintf(book->tab->listbox.items[4].text, "Use SELECT and START to navigate.");
+        for (int i = 0; i < 6; i++)
+            book->tab->listbox.items[i] = (listbox_item_t){.text = ""};
+        if (book->labels)
+        {
+            snprintf(book->labels, BOOK_LABEL_SIZE, "You have no %s games.", book->name);
+            book->tab->listbox.items[2].text = book->labels;
+        }
+        book->tab->listbox.items[0].text = "Welcome to Retro-Go!";
+        book->tab->listbox.items[4].text = "Use SELECT and START to navigate.";
         book->tab->listbox.cursor = 3;
     }
+
+    // The labels were rewritten in place, the list can't tell by comparing pointers
+    gui_invalidate_list(0);
 }
 
 static void book_append(book_type_t book_type, retro_emulator_file_t *new_item)
@@ -126,7 +143,9 @@ static void book_load(book_type_t book_type)
     FILE *fp = fopen(book->path, "r");
     if (fp)
     {
+        // Every item is read again, nothing points to the old names anymore
         book->count = 0;
+        string_pool_free(&book->strings);
 
         while (fgets(line_buffer, 168, fp))
         {
@@ -134,7 +153,7 @@ static void book_load(book_type_t book_type)
             if (line_buffer[len - 1] == '\n')
                 line_buffer[len - 1] = 0;
 
-            if (emulator_build_file_object(line_buffer, &tmp_file))
+            if (emulator_build_file_object(line_buffer, &tmp_file, &book->strings))
                 book_append(book_type, &tmp_file);
             else
                 RG_LOGW("Unknown path form: '%s'\n", line_buffer);
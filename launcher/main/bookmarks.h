@@ -19,6 +19,8 @@ typedef struct
     long capacity;
     long count;
     retro_emulator_file_t *items;
+    string_pool_t *strings; // Names of the items read from the file
+    char *labels;
     tab_t *tab;
 } book_t;
 
@@ -1,5 +1,10 @@
 #include <rg_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include <sys/stat.h>
+#include <dirent.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -13,70 +18,224 @@
 static retro_emulator_t emulators[32];
 static int emulators_count = 0;
 static retro_crc_cache_t *crc_cache;
+static SemaphoreHandle_t crc_cache_lock;
+
+static struct
+{
+    QueueHandle_t queue;    // Emulators whose ROM list must be scanned (retro_emulator_t *)
+    uint8_t *buffer;
+    volatile int pending;   // Emulators queued or being scanned
+} crc_scanner;
 static bool crc_cache_dirty = false;
 
 
+#define CRC_CACHE_PAGES ((sizeof(retro_crc_cache_t) + CRC_CACHE_PAGE_SIZE - 1) / CRC_CACHE_PAGE_SIZE)
+#define CRC_PAGE_LOADED 1
+#define CRC_PAGE_DIRTY  2
+
+static uint8_t crc_cache_pages[CRC_CACHE_PAGES];
+static uint32_t crc_cache_referenced[CRC_CACHE_SLOTS / 32]; // Clock bits, RAM only so that hits don't dirty pages
+static bool crc_cache_on_disk = false;
+static FILE *crc_cache_file; // Kept open for paging in, closed while saving
+
+
+static void crc_cache_page_in(size_t offset)
+{
+    size_t page = offset / CRC_CACHE_PAGE_SIZE;
+    size_t count = 0;
+
+    if (crc_cache_pages[page] & CRC_PAGE_LOADED)
+        return;
+
+    // Lookups of neighbouring slots are common (probing, eviction), a run of missing pages is
+    // read in one go
+    while (count < CRC_CACHE_READAHEAD && page + count < CRC_CACHE_PAGES
+            && !(crc_cache_pages[page + count] & CRC_PAGE_LOADED))
+    {
+        crc_cache_pages[page + count++] |= CRC_PAGE_LOADED;
+    }
+
+    if (!crc_cache_file)
+        crc_cache_file = fopen(CRC_CACHE_PATH, "rb");
+
+    if (crc_cache_file)
+    {
+        size_t start = page * CRC_CACHE_PAGE_SIZE;
+        size_t length = RG_MIN(count * CRC_CACHE_PAGE_SIZE, sizeof(retro_crc_cache_t) - start);
+        fseek(crc_cache_file, start, SEEK_SET);
+        fread((uint8_t *)crc_cache + start, 1, length, crc_cache_file);
+    }
+}
+
+static retro_crc_entry_t *crc_cache_slot(size_t index, bool write)
+{
+    size_t offset = offsetof(retro_crc_cache_t, entries) + index * sizeof(retro_crc_entry_t);
+
+    crc_cache_page_in(offset);
+
+    if (write)
+    {
+        crc_cache_pages[offset / CRC_CACHE_PAGE_SIZE] |= CRC_PAGE_DIRTY;
+        crc_cache_pages[0] |= CRC_PAGE_DIRTY; // Header
+        crc_cache_dirty = true;
+    }
+
+    return &crc_cache->entries[index];
+}
+
 void crc_cache_init(void)
 {
     crc_cache = calloc(1, sizeof(retro_crc_cache_t));
-    crc_cache_dirty = true;
+    crc_cache_dirty = false;
 
-    if (!crc_cache)
+    crc_cache_lock = xSemaphoreCreateMutex();
+
+    if (!crc_cache || !crc_cache_lock)
     {
         RG_LOGE("Failed to allocate crc_cache!\n");
+        free(crc_cache);
+        crc_cache = NULL;
         return;
     }
 
-    FILE *fp = fopen(CRC_CACHE_PATH, "rb");
-    if (!fp)
+    // Only the first pages (with the header) are read now, the rest is paged in on demand
+    crc_cache_page_in(0);
+
+    if (crc_cache_file)
     {
-        rg_mkdir(RG_BASE_PATH_CACHE);
-        fp = fopen(CRC_CACHE_PATH, "wb");
-        fwrite(crc_cache, sizeof(retro_crc_cache_t), 1, fp);
-        fclose(fp);
+        fseek(crc_cache_file, 0, SEEK_END);
+        crc_cache_on_disk = ftell(crc_cache_file) == sizeof(retro_crc_cache_t);
+    }
 
-        fp = fopen(CRC_CACHE_PATH, "rb");
+    if (crc_cache_on_disk && crc_cache->magic == CRC_CACHE_MAGIC && crc_cache->count <= CRC_CACHE_MAX_ENTRIES)
+    {
+        RG_LOGI("Loaded CRC cache (entries: %d)\n", crc_cache->count);
     }
+    else
+    {
+        memset(crc_cache, 0, sizeof(retro_crc_cache_t));
+        memset(crc_cache_referenced, 0, sizeof(crc_cache_referenced));
+        memset(crc_cache_pages, CRC_PAGE_LOADED|CRC_PAGE_DIRTY, sizeof(crc_cache_pages));
+        crc_cache->magic = CRC_CACHE_MAGIC;
+        crc_cache_on_disk = false;
+        crc_cache_dirty = true;
+    }
+}
 
-    if (fp)
+static const char *get_file_path(retro_emulator_file_t *file, char *buffer, size_t buffer_size);
+
+static uint32_t crc_cache_calc_key(retro_emulator_file_t *file)
+{
+    char buffer[192];
+    const char *path = get_file_path(file, buffer, sizeof(buffer));
+    uint32_t signature[2] = {0, 0};
+    struct stat st;
+
+    // The path makes files with the same name in different folders distinct, and size/mtime
+    // catch a file being replaced with another version.
+    if (stat(path, &st) == 0)
+    {
+        signature[0] = st.st_size;
+        signature[1] = st.st_mtime;
+    }
+
+    uint32_t key = crc32_le(crc32_le(0, (void *)path, strlen(path)), (void *)signature, sizeof(signature));
+
+    return key ? key : 1;
+}
+
+static inline size_t crc_cache_home(uint32_t key)
+{
+    return key & (CRC_CACHE_SLOTS - 1);
+}
+
+static inline bool crc_cache_get_ref(size_t index)
+{
+    return crc_cache_referenced[index / 32] & (1u << (index % 32));
+}
+
+static inline void crc_cache_set_ref(size_t index, bool value)
+{
+    if (value)
+        crc_cache_referenced[index / 32] |= (1u << (index % 32));
+    else
+        crc_cache_referenced[index / 32] &= ~(1u << (index % 32));
+}
+
+static void crc_cache_remove(size_t index)
+{
+    const size_t mask = CRC_CACHE_SLOTS - 1;
+    size_t hole = index;
+
+    // Backward shift deletion, so that no tombstones are needed
+    for (size_t i = (index + 1) & mask; crc_cache_slot(i, false)->key; i = (i + 1) & mask)
     {
-        fread(crc_cache, offsetof(retro_crc_cache_t, entries), 1, fp);
+        size_t home = crc_cache_home(crc_cache_slot(i, false)->key);
 
-        if (crc_cache->magic == CRC_CACHE_MAGIC && crc_cache->count <= CRC_CACHE_MAX_ENTRIES)
+        if (((i - home) & mask) >= ((i - hole) & mask))
         {
-            RG_LOGI("Loaded CRC cache (entries: %d)\n", crc_cache->count);
-            fread(crc_cache->entries, crc_cache->count, sizeof(crc_cache->entries), fp);
-            crc_cache_dirty = false;
+            *crc_cache_slot(hole, true) = *crc_cache_slot(i, false);
+            crc_cache_set_ref(hole, crc_cache_get_ref(i));
+            hole = i;
         }
-        else
-        {
-            crc_cache->count = 0;
-        }
-        fclose(fp);
     }
+
+    memset(crc_cache_slot(hole, true), 0, sizeof(retro_crc_entry_t));
+    crc_cache_set_ref(hole, false);
+    crc_cache->count--;
 }
 
-static uint32_t crc_cache_calc_key(retro_emulator_file_t *file)
+static void crc_cache_evict(void)
 {
-    // return ((uint64_t)crc32_le(0, (void *)file->name, strlen(file->name)) << 33 | file->size);
-    // This should be reasonably unique
-    return crc32_le(0, (void *)file->name, strlen(file->name));
+    // Clock sweep: entries used since the hand last went by get a second chance. The hand is
+    // saved with the header, the reference bits start cleared after a reboot.
+    for (size_t n = 0; n < CRC_CACHE_SLOTS * 2; n++)
+    {
+        size_t i = crc_cache->hand & (CRC_CACHE_SLOTS - 1);
+
+        if (crc_cache_slot(i, false)->key)
+        {
+            if (!crc_cache_get_ref(i))
+            {
+                RG_LOGI("Evicting %08X\n", crc_cache->entries[i].crc);
+                crc_cache_remove(i); // The next entry may shift into i, so the hand stays
+                return;
+            }
+            crc_cache_set_ref(i, false);
+        }
+
+        crc_cache->hand = (i + 1) & (CRC_CACHE_SLOTS - 1);
+    }
 }
 
 uint32_t crc_cache_lookup(retro_emulator_file_t *file)
 {
-    uint32_t key = crc_cache_calc_key(file);
-
     if (!crc_cache)
         return 0;
 
-    for (int i = 0; i < crc_cache->count; i++)
+    uint32_t key = crc_cache_calc_key(file);
+    uint32_t crc = 0;
+
+    xSemaphoreTake(crc_cache_lock, portMAX_DELAY);
+
+    for (size_t i = crc_cache_home(key);; i = (i + 1) & (CRC_CACHE_SLOTS - 1))
     {
-        if (crc_cache->entries[i].key == key)
-            return crc_cache->entries[i].crc;
+        retro_crc_entry_t *entry = crc_cache_slot(i, false);
+
+        if (entry->key == 0)
+            break;
+
+        if (entry->key == key)
+        {
+            crc_cache_set_ref(i, true);
+            crc = entry->crc;
+            break;
+        }
     }
 
-    return 0;
+    xSemaphoreGive(crc_cache_lock);
+
+    return crc;
 }
 
 void crc_cache_save(void)
@@ -86,40 +245,106 @@ void crc_cache_save(void)
 
     RG_LOGI("Saving cache\n");
 
-    FILE *fp = fopen(CRC_CACHE_PATH, "wb");
+    rg_mkdir(RG_BASE_PATH_CACHE);
+
+    xSemaphoreTake(crc_cache_lock, portMAX_DELAY);
+
+    if (crc_cache_file)
+    {
+        fclose(crc_cache_file);
+        crc_cache_file = NULL;
+    }
+
+    // Only the dirty pages are written back when the file already exists
+    FILE *fp = fopen(CRC_CACHE_PATH, crc_cache_on_disk ? "r+b" : "wb");
     if (fp)
     {
-        size_t unused = CRC_CACHE_MAX_ENTRIES - RG_MIN(crc_cache->count, CRC_CACHE_MAX_ENTRIES);
-        size_t minsize = sizeof(retro_crc_cache_t) - (unused * sizeof(retro_crc_entry_t));
+        for (size_t page = 0; page < CRC_CACHE_PAGES; page++)
+        {
+            size_t offset = page * CRC_CACHE_PAGE_SIZE;
 
-        fwrite(crc_cache, minsize, 1, fp);
+            if (!(crc_cache_pages[page] & CRC_PAGE_DIRTY))
+                continue;
+
+            fseek(fp, offset, SEEK_SET);
+            fwrite((uint8_t *)crc_cache + offset, RG_MIN(CRC_CACHE_PAGE_SIZE, sizeof(retro_crc_cache_t) - offset), 1, fp);
+            crc_cache_pages[page] &= ~CRC_PAGE_DIRTY;
+        }
         fclose(fp);
+        crc_cache_on_disk = true;
         crc_cache_dirty = false;
     }
+
+    xSemaphoreGive(crc_cache_lock);
 }
 
 void crc_cache_update(retro_emulator_file_t *file)
 {
-    uint32_t key = crc_cache_calc_key(file);
-    size_t index = 0;
-
     if (!crc_cache)
         return;
 
-    if (crc_cache->count < CRC_CACHE_MAX_ENTRIES)
-        index = crc_cache->count++;
-    else
-        index = rand() % CRC_CACHE_MAX_ENTRIES;
+    uint32_t key = crc_cache_calc_key(file);
+    size_t index;
+
+    xSemaphoreTake(crc_cache_lock, portMAX_DELAY);
 
-    crc_cache->magic = CRC_CACHE_MAGIC;
-    crc_cache->entries[index].key = key;
-    crc_cache->entries[index].crc = file->checksum;
-    crc_cache_dirty = true;
+    if (crc_cache->count >= CRC_CACHE_MAX_ENTRIES)
+        crc_cache_evict();
+
+    for (index = crc_cache_home(key);; index = (index + 1) & (CRC_CACHE_SLOTS - 1))
+    {
+        retro_crc_entry_t *entry = crc_cache_slot(index, false);
+        if (entry->key == 0 || entry->key == key)
+            break;
+    }
 
-    RG_LOGI("Adding %08X => %08X to cache (new total: %d)\n",
-        key, file->checksum, crc_cache->count);
+    retro_crc_entry_t *entry = crc_cache_slot(index, true);
 
-    // crc_cache_save();
+    if (entry->key == 0)
+        crc_cache->count++;
+
+    entry->key = key;
+    entry->crc = file->checksum;
+    crc_cache_set_ref(index, true);
+
+    xSemaphoreGive(crc_cache_lock);
+
+    RG_LOGI("Adding %08X => %08X to cache (new total: %d)\n", key, file->checksum, crc_cache->count);
+}
+
+static bool crc_scanner_yield(void)
+{
+    // Give the SD card back to the UI while it is doing something (loading a preview, etc)
+    while (gui.idle_counter < CRC_SCAN_IDLE_DELAY)
+        vTaskDelay(pdMS_TO_TICKS(100));
+    return true;
+}
+
+static bool crc_foreground_yield(void)
+{
+    gui.joystick = rg_input_read_gamepad();
+    return (gui.joystick & GAMEPAD_KEY_ANY) == 0;
+}
+
+static void crc_scanner_task(void *arg)
+{
+    retro_emulator_t *emulator;
+
+    while (xQueueReceive(crc_scanner.queue, &emulator, portMAX_DELAY) == pdTRUE)
+    {
+        RG_LOGI("Scanning '%s' (%d files)\n", emulator->system_name, emulator->roms.count);
+
+        for (size_t i = 0; i < emulator->roms.count && crc_cache->count < CRC_CACHE_MAX_ENTRIES; i++)
+        {
+            if (emulator->roms.files[i].checksum == 0)
+                emulator_crc32_file_ex(&emulator->roms.files[i], crc_scanner.buffer, &crc_scanner_yield);
+        }
+
+        emulator->crc_scan_done = true;
+        crc_scanner.pending--;
+    }
+
+    vTaskDelete(NULL);
 }
 
 void crc_cache_idle_task(tab_t *tab)
@@ -127,10 +352,9 @@ void crc_cache_idle_task(tab_t *tab)
     if (!crc_cache)
         return;
 
-    if (gui.idle_counter >= 2000 && crc_cache->count < CRC_CACHE_MAX_ENTRIES)
+    if (gui.idle_counter >= CRC_SCAN_IDLE_DELAY && crc_scanner.queue && crc_cache->count < CRC_CACHE_MAX_ENTRIES)
     {
         int start_offset = 0;
-        int remaining = 20;
 
         // Find the currently focused emulator, if any
         for (int i = 0; i < emulators_count; i++)
@@ -142,43 +366,27 @@ void crc_cache_idle_task(tab_t *tab)
             }
         }
 
-        for (int i = 0; i < emulators_count && remaining > 0; i++)
+        // Only one emulator is handed over at a time, the ROM lists are built here because
+        // emulator_init isn't safe to call from the scanner.
+        for (int i = 0; i < emulators_count && crc_scanner.pending == 0; i++)
         {
             retro_emulator_t *emulator = &emulators[(start_offset + i) % emulators_count];
-            int processed = 0;
 
             if (emulator->crc_scan_done)
                 continue;
 
-            gui_set_status(tab, "BUILDING CACHE...", "SCANNING");
-            gui_draw_status(tab);
-
             if (!emulator->initialized)
-                emulator_init(emulator);
-
-            for (int j = 0; j < emulator->roms.count && remaining > 0; j++)
             {
-                retro_emulator_file_t *file = &emulator->roms.files[j];
-
-                if (file->checksum == 0)
-                    file->checksum = crc_cache_lookup(file);
-
-                if (file->checksum == 0 && emulator_crc32_file(file))
-                {
-                    processed++;
-                    remaining--;
-                }
-
-                if (gui.joystick & GAMEPAD_KEY_ANY)
-                    remaining = -1;
+                gui_set_status(tab, "BUILDING CACHE...", "SCANNING");
+                gui_draw_status(tab);
+                emulator_init(emulator);
+                gui_set_status(tab, "", "");
+                gui_draw_status(tab);
             }
 
-            if (processed == 0 && remaining != -1)
-                emulator->crc_scan_done = true;
-
-            gui_set_status(tab, "", "");
+            crc_scanner.pending++;
+            xQueueSend(crc_scanner.queue, &emulator, 0);
         }
-        gui_draw_status(tab);
     }
 
     crc_cache_save();
@@ -202,7 +410,7 @@ static void event_handler(gui_event_t event, tab_t *tab)
 
             for (int i = 0; i < emu->roms.count; i++)
             {
-                strcpy(tab->listbox.items[i].text, emu->roms.files[i].name);
+                tab->listbox.items[i].text = emu->roms.files[i].name;
                 tab->listbox.items[i].arg = &emu->roms.files[i];
             }
 
@@ -210,10 +418,18 @@ static void event_handler(gui_event_t event, tab_t *tab)
         }
         else
         {
+            char buffer[128];
+            if (!emu->roms.placeholder[0])
+            {
+                sprintf(buffer, "Place roms in folder: /roms/%s", emu->dirname);
+                emu->roms.placeholder[0] = string_pool_add(&emu->roms.strings, buffer);
+                sprintf(buffer, "With file extension: %s", emu->extensions);
+                emu->roms.placeholder[1] = string_pool_add(&emu->roms.strings, buffer);
+            }
             gui_resize_list(tab, 8);
-            sprintf(tab->listbox.items[0].text, "Place roms in folder: /roms/%s", emu->dirname);
-            sprintf(tab->listbox.items[2].text, "With file extension: %s", emu->extensions);
-            sprintf(tab->listbox.items[4].text, "Use SELECT and START to navigate.");
+            tab->listbox.items[0].text = emu->roms.placeholder[0];
+            tab->listbox.items[2].text = emu->roms.placeholder[1];
+            tab->listbox.items[4].text = "Use SELECT and START to navigate.";
             tab->listbox.cursor = 3;
             tab->is_empty = true;
         }
@@ -233,6 +449,7 @@ static void event_handler(gui_event_t event, tab_t *tab)
         else
             strcpy(tab->status[0].left, "No Games");
         gui_set_status(tab, NULL, "");
+        gui_prefetch_previews(tab);
     }
     else if (event == TAB_REDRAW)
     {
@@ -240,9 +457,9 @@ static void event_handler(gui_event_t event, tab_t *tab)
     }
     else if (event == TAB_IDLE)
     {
-        if (file && gui.show_preview && gui.idle_counter == (gui.show_preview_fast ? 1 : 8))
+        if (file && gui.show_preview && gui.idle_counter >= (gui.show_preview_fast ? 1 : 8))
             gui_draw_preview(tab, file);
-        else if ((gui.idle_counter % 100) == 0)
+        if ((gui.idle_counter % 100) == 0)
             crc_cache_idle_task(tab);
     }
     else if (event == KEY_PRESS_A)
@@ -286,6 +503,291 @@ static void add_emulator(const char *system, const char *dirname, const char* ex
         event_handler);
 }
 
+char *string_pool_alloc(string_pool_t **pool, size_t size)
+{
+    string_pool_t *block = *pool;
+
+    if (!block || block->used + size > block->size)
+    {
+        size_t block_size = RG_MAX(size, STRING_POOL_BLOCK_SIZE);
+
+        if (!(block = malloc(sizeof(string_pool_t) + block_size)))
+            return NULL;
+
+        block->next = *pool;
+        block->used = 0;
+        block->size = block_size;
+        *pool = block;
+    }
+
+    char *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+const char *string_pool_add(string_pool_t **pool, const char *str)
+{
+    size_t size = strlen(str) + 1;
+    char *ptr = string_pool_alloc(pool, size);
+    return ptr ? memcpy(ptr, str, size) : NULL;
+}
+
+void string_pool_free(string_pool_t **pool)
+{
+    while (*pool)
+    {
+        string_pool_t *next = (*pool)->next;
+        free(*pool);
+        *pool = next;
+    }
+}
+
+static bool match_extension(retro_emulator_t *emu, const char *ext)
+{
+    char buffer[32];
+
+    if (!ext)
+        return false;
+
+    for (char *token = strtok(strcpy(buffer, emu->extensions), " "); token; token = strtok(NULL, " "))
+    {
+        if (strcasecmp(token, ext) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static bool add_file(retro_emulator_t *emu, size_t *capacity, const char *folder, const char *name, uint32_t checksum)
+{
+    if (emu->roms.count >= *capacity)
+    {
+        size_t new_capacity = *capacity ? *capacity * 2 : 64;
+        void *new_files = realloc(emu->roms.files, new_capacity * sizeof(retro_emulator_file_t));
+
+        // In case of low memory, keep at least what we have so far...
+        if (!new_files)
+        {
+            RG_LOGW("Out of memory, ROMs list truncated to %d entries!\n", emu->roms.count);
+            return false;
+        }
+
+        emu->roms.files = new_files;
+        *capacity = new_capacity;
+    }
+
+    emu->roms.files[emu->roms.count++] = (retro_emulator_file_t){
+        .name = name,
+        .ext = name + strlen(name) + 1,
+        .folder = folder,
+        .checksum = checksum,
+        .missing_cover = 0,
+        .is_valid = 1,
+        .emulator = emu,
+    };
+
+    return true;
+}
+
+static rom_index_dir_t *add_dir(rom_index_dir_t **dirs, size_t *count, size_t *capacity, const char *path)
+{
+    if (*count >= *capacity)
+    {
+        size_t new_capacity = *capacity ? *capacity * 2 : 16;
+        void *new_dirs = realloc(*dirs, new_capacity * sizeof(rom_index_dir_t));
+
+        if (!new_dirs)
+        {
+            RG_LOGW("Out of memory, skipping folder '%s'!\n", path);
+            return NULL;
+        }
+
+        *dirs = new_dirs;
+        *capacity = new_capacity;
+    }
+
+    rom_index_dir_t *dir = &(*dirs)[(*count)++];
+    memset(dir, 0, sizeof(rom_index_dir_t));
+    snprintf(dir->path, sizeof(dir->path), "%s", path);
+
+    return dir;
+}
+
+static bool is_child_dir(const char *parent, const char *path)
+{
+    size_t len = strlen(parent);
+
+    if (len == 0)
+        return path[0] && !strchr(path, '/');
+
+    return strncmp(parent, path, len) == 0 && path[len] == '/' && !strchr(path + len + 1, '/');
+}
+
+// Reading the listing costs about as much as stat'ing the folder on FAT and it's the only thing
+// that reliably changes when a file is added, removed, or renamed.
+bool emulator_dir_signature(const char *path, uint32_t *entries, uint32_t *hash)
+{
+    struct dirent *ent;
+    DIR *dir = opendir(path);
+
+    if (!dir)
+        return false;
+
+    *entries = 0;
+    *hash = 0x811C9DC5; // FNV-1a
+
+    while ((ent = readdir(dir)))
+    {
+        for (const char *c = ent->d_name; *c; c++)
+            *hash = (*hash ^ (uint8_t)*c) * 0x01000193;
+        *hash = (*hash ^ ent->d_type) * 0x01000193;
+        (*entries)++;
+    }
+
+    closedir(dir);
+
+    return true;
+}
+
+// dirs may move when a subfolder is added, so the current folder is passed by index
+static void scan_directory(retro_emulator_t *emu, const char *base_path, rom_index_dir_t **dirs,
+                           size_t *dirs_count, size_t *dirs_capacity, size_t current, size_t *capacity)
+{
+    char path[256], sub_path[256];
+    char *current_path = (*dirs)[current].path;
+    size_t found = 0;
+    struct dirent *ent;
+
+    snprintf(path, sizeof(path), "%s%s%s", base_path, current_path[0] ? "/" : "", current_path);
+
+    DIR *dir = opendir(path);
+    if (!dir)
+        return;
+
+    while ((ent = readdir(dir)))
+    {
+        const char *name = ent->d_name;
+
+        if (name[0] == '.')
+            continue;
+
+        if (ent->d_type == DT_DIR)
+        {
+            snprintf(sub_path, sizeof(sub_path), "%s%s%s", current_path, current_path[0] ? "/" : "", name);
+            add_dir(dirs, dirs_count, dirs_capacity, sub_path);
+            current_path = (*dirs)[current].path;
+            continue;
+        }
+
+        const char *ext = rg_extension(name);
+
+        if (!match_extension(emu, ext))
+            continue;
+
+        // The name contains the relative subfolder, the folder is always the system's root.
+        // Name and extension are stored back to back: "subdir/name\0ext\0"
+        size_t prefix_len = current_path[0] ? strlen(current_path) + 1 : 0;
+        size_t name_len = ext - name - 1;
+        size_t ext_len = strlen(ext);
+        char *str = string_pool_alloc(&emu->roms.strings, prefix_len + name_len + ext_len + 2);
+
+        if (!str)
+            break;
+
+        sprintf(str, "%s%s%.*s", current_path, prefix_len ? "/" : "", (int)name_len, name);
+        strcpy(str + prefix_len + name_len + 1, ext);
+
+        if (!add_file(emu, capacity, base_path, str, 0))
+            break;
+
+        found++;
+    }
+
+    closedir(dir);
+
+    (*dirs)[current].count += found;
+}
+
+static string_pool_t *rom_index_load(const char *filename)
+{
+    string_pool_t *block = NULL;
+    size_t size = 0;
+
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    // The whole index is read at once and becomes a block of the ROM list's string pool, the
+    // names are then used in place.
+    if (size >= sizeof(rom_index_header_t) && (block = malloc(sizeof(string_pool_t) + size + 2)))
+    {
+        rom_index_header_t *index = (void *)block->data;
+
+        block->next = NULL;
+        block->used = block->size = size + 2;
+        block->data[size] = block->data[size + 1] = 0;
+
+        if (fread(block->data, size, 1, fp) != 1
+            || index->magic != ROM_INDEX_MAGIC || index->version != ROM_INDEX_VERSION
+            || index->dirs_count > size / sizeof(rom_index_dir_t)
+            || size != sizeof(rom_index_header_t) + index->dirs_count * sizeof(rom_index_dir_t)
+                        + index->files_count * sizeof(rom_index_file_t) + index->strings_size)
+        {
+            RG_LOGW("Invalid ROM index '%s', ignoring it.\n", filename);
+            free(block);
+            block = NULL;
+        }
+    }
+
+    fclose(fp);
+
+    return block;
+}
+
+static void rom_index_save(const char *filename, retro_emulator_t *emu, rom_index_dir_t *dirs, size_t dirs_count)
+{
+    rom_index_header_t header = {ROM_INDEX_MAGIC, ROM_INDEX_VERSION, dirs_count, emu->roms.count, 0};
+    rom_index_file_t *files = calloc(emu->roms.count + 1, sizeof(rom_index_file_t));
+
+    if (!files)
+        return;
+
+    for (size_t i = 0; i < emu->roms.count; i++)
+    {
+        retro_emulator_file_t *file = &emu->roms.files[i];
+        files[i].name = header.strings_size;
+        files[i].checksum = file->checksum;
+        header.strings_size += strlen(file->name) + strlen(file->ext) + 2;
+    }
+
+    rg_mkdir(RG_BASE_PATH_CACHE);
+
+    FILE *fp = fopen(filename, "wb");
+    if (fp)
+    {
+        fwrite(&header, sizeof(header), 1, fp);
+        fwrite(dirs, sizeof(rom_index_dir_t), dirs_count, fp);
+        fwrite(files, sizeof(rom_index_file_t), emu->roms.count, fp);
+        for (size_t i = 0; i < emu->roms.count; i++)
+        {
+            retro_emulator_file_t *file = &emu->roms.files[i];
+            fwrite(file->name, strlen(file->name) + 1, 1, fp);
+            fwrite(file->ext, strlen(file->ext) + 1, 1, fp);
+        }
+        fclose(fp);
+    }
+    else
+    {
+        RG_LOGE("Unable to save ROM index '%s'\n", filename);
+    }
+
+    free(files);
+}
+
 void emulator_init(retro_emulator_t *emu)
 {
     if (emu->initialized)
@@ -295,7 +797,7 @@ void emulator_init(retro_emulator_t *emu)
 
     RG_LOGI("Initializing emulator '%s'\n", emu->system_name);
 
-    char path[256], buffer[32];
+    char path[256], index_path[128];
 
     sprintf(path, RG_BASE_PATH_SAVES "/%s", emu->dirname);
     rg_mkdir(path);
@@ -303,69 +805,114 @@ void emulator_init(retro_emulator_t *emu)
     sprintf(path, RG_BASE_PATH_ROMS "/%s", emu->dirname);
     rg_mkdir(path);
 
-    rg_strings_t *files = rg_readdir(path, RG_SKIP_HIDDEN|RG_RECURSIVE|RG_FILES_ONLY);
-    if (files && files->count > 0)
+    sprintf(index_path, ROM_INDEX_PATH, emu->dirname);
+
+    string_pool_t *index_block = rom_index_load(index_path);
+    rom_index_header_t *index = index_block ? (void *)index_block->data : NULL;
+    rom_index_dir_t *old_dirs = index ? (void *)(index + 1) : NULL;
+    rom_index_file_t *old_files = index ? (void *)(old_dirs + index->dirs_count) : NULL;
+    const char *old_strings = index ? (void *)(old_files + index->files_count) : NULL;
+    rom_index_dir_t *dirs = NULL;
+    size_t dirs_count = 0, dirs_capacity = 0, capacity = 0, rescanned = 0, reused = 0;
+    const char *folder = string_pool_add(&emu->roms.strings, path);
+
+    if (!add_dir(&dirs, &dirs_count, &dirs_capacity, "") || !folder)
+        RG_PANIC("Out of memory, unable to alloc ROMs index!\n");
+
+    emu->roms.files = NULL;
+    emu->roms.count = 0;
+
+    // Folders are processed breadth-first, dirs[] doubles as the queue. A folder whose signature
+    // still matches the index is copied as-is (along with its known subfolders), the others are
+    // read from the card. Only directories that changed since the last boot are rescanned.
+    for (size_t i = 0; i < dirs_count; i++)
     {
-        char *files_ptr = files->buffer;
-        size_t count = files->count;
+        rom_index_dir_t *dir = &dirs[i];
+        rom_index_dir_t *cached = NULL;
+        char dir_path[256];
 
-        emu->roms.files = calloc(count, sizeof(retro_emulator_file_t));;
-        emu->roms.count = 0;
+        snprintf(dir_path, sizeof(dir_path), "%s%s%s", path, dir->path[0] ? "/" : "", dir->path);
 
-        // In case of low memory, try to fit at least *something*...
-        while (!emu->roms.files && count > 20)
-        {
-            count /= 2;
-            emu->roms.files = calloc(count, sizeof(retro_emulator_file_t));
-            RG_LOGW("Had to reduce list to fit in memory %d => %d ...\n", files->count, count);
-        }
+        if (!emulator_dir_signature(dir_path, &dir->entries, &dir->hash))
+            continue;
 
-        if (!emu->roms.files)
-            RG_PANIC("Out of memory, unable to alloc ROMs list!\n");
+        dir->first = emu->roms.count;
+        dir->count = 0;
 
-        for (int i = 0; i < count; ++i)
+        for (size_t j = 0; index && j < index->dirs_count; j++)
         {
-            const char *name = files_ptr;
-            const char *ext = strrchr(name, '.') + 1;
-            size_t name_len = strlen(name);
-            bool ext_match = false;
-
-            // Advance pointer to next entry
-            files_ptr += name_len + 1;
+            if (strcmp(old_dirs[j].path, dir->path) == 0)
+            {
+                if (old_dirs[j].entries == dir->entries && old_dirs[j].hash == dir->hash
+                    && old_dirs[j].first + old_dirs[j].count <= index->files_count)
+                    cached = &old_dirs[j];
+                break;
+            }
+        }
 
-            if (ext > name)
+        if (cached)
+        {
+            for (size_t j = 0; j < cached->count; j++)
+            {
+                rom_index_file_t *file = &old_files[cached->first + j];
+                if (file->name >= index->strings_size)
+                    continue;
+                if (!add_file(emu, &capacity, folder, old_strings + file->name, file->checksum))
+                    break;
+                dir->count++;
+            }
+            // dir is not used past this point, add_dir may move the array
+            for (size_t j = 0; j < index->dirs_count; j++)
             {
-                char *token = strtok(strcpy(buffer, emu->extensions), " ");
-                while (token && !ext_match)
-                {
-                    ext_match = strcasecmp(token, ext) == 0;
-                    token = strtok(NULL, " ");
-                }
+                if (is_child_dir(dirs[i].path, old_dirs[j].path))
+                    add_dir(&dirs, &dirs_count, &dirs_capacity, old_dirs[j].path);
             }
+            reused++;
+        }
+        else
+        {
+            scan_directory(emu, folder, &dirs, &dirs_count, &dirs_capacity, i, &capacity);
+            rescanned++;
+        }
+    }
 
-            if (!ext_match)
-                continue;
+    // Folders that disappeared leave an empty slot behind, the index must be rewritten too
+    if (rescanned > 0 || !index || index->dirs_count != dirs_count || index->files_count != emu->roms.count)
+    {
+        RG_LOGI("ROM index: %d folders rescanned, saving %d files.\n", rescanned, emu->roms.count);
+        rom_index_save(index_path, emu, dirs, dirs_count);
+    }
+    else
+    {
+        RG_LOGI("ROM index: loaded %d files.\n", emu->roms.count);
+    }
 
-            retro_emulator_file_t *file = &emu->roms.files[emu->roms.count++];
-            strcpy(file->folder, path); // This is wrong, won't contain subdir...
-            strcpy(file->name, name);
-            strcpy(file->ext, ext);
-            file->name[name_len-strlen(ext)-1] = 0;
-            file->emulator = (void*)emu;
-            file->checksum = 0;
-            file->missing_cover = 0;
-            file->is_valid = 1;
-        }
+    // The names of the reused folders point into the index, it becomes part of the pool
+    if (reused > 0)
+    {
+        index_block->next = emu->roms.strings;
+        emu->roms.strings = index_block;
     }
-    free(files);
+    else
+    {
+        free(index_block);
+    }
+
+    free(dirs);
+}
+
+// Reentrant version of emu_get_file_path, for use outside of the UI task
+static const char *get_file_path(retro_emulator_file_t *file, char *buffer, size_t buffer_size)
+{
+    if (file == NULL) return NULL;
+    snprintf(buffer, buffer_size, "%s/%s.%s", file->folder, file->name, file->ext);
+    return buffer;
 }
 
 const char *emu_get_file_path(retro_emulator_file_t *file)
 {
     static char buffer[192];
-    if (file == NULL) return NULL;
-    sprintf(buffer, "%s/%s.%s", file->folder, file->name, file->ext);
-    return (const char*)&buffer;
+    return get_file_path(file, buffer, sizeof(buffer));
 }
 
 size_t emu_get_file_crc_offset(retro_emulator_file_t *file)
@@ -375,7 +922,8 @@ size_t emu_get_file_crc_offset(retro_emulator_file_t *file)
     return 0;
 }
 
-bool emulator_build_file_object(const char *path, retro_emulator_file_t *file)
+// The strings are allocated in the given pool, they live as long as it does
+bool emulator_build_file_object(const char *path, retro_emulator_file_t *file, string_pool_t **pool)
 {
     RG_ASSERT(path && file, "Bad param");
 
@@ -386,21 +934,30 @@ bool emulator_build_file_object(const char *path, retro_emulator_file_t *file)
 
     for (int i = 0; i < emulators_count; ++i)
     {
-        if (strncmp(emulators[i].dirname, path + base_len, strlen(emulators[i].dirname)) == 0)
+        size_t dirname_len = strlen(emulators[i].dirname);
+
+        if (strncmp(emulators[i].dirname, path + base_len, dirname_len) == 0 && path[base_len + dirname_len] == '/')
         {
-            const char *name = rg_basename(path);
+            // Same layout as the ROM lists: the folder is the system's root, the name is relative to it
+            const char *name = path + base_len + dirname_len + 1;
             const char *ext = rg_extension(name);
 
-            if (!ext || !name)
+            if (!ext)
                 return false;
 
-            size_t folder_len = strlen(path) - strlen(name);
-            size_t name_len = strlen(name) - strlen(ext);
+            size_t folder_len = base_len + dirname_len;
+            size_t name_len = ext - name - 1;
+            char *str = string_pool_alloc(pool, folder_len + 1 + strlen(name) + 1);
+
+            if (!str)
+                return false;
 
             memset(file, 0, sizeof(retro_emulator_file_t));
-            strncpy(file->folder, path, RG_MIN(folder_len, 32) - 1);
-            strncpy(file->name, name, RG_MIN(name_len, 128) - 1);
-            strncpy(file->ext, ext, 7);
+            file->folder = memcpy(str, path, folder_len);
+            str[folder_len] = 0;
+            file->name = strcpy(str + folder_len + 1, name);
+            file->ext = file->name + name_len + 1;
+            str[folder_len + 1 + name_len] = 0;
             file->emulator = &emulators[i];
             file->is_valid = true;
             return true;
@@ -410,11 +967,12 @@ bool emulator_build_file_object(const char *path, retro_emulator_file_t *file)
     return false;
 }
 
-bool emulator_crc32_file(retro_emulator_file_t *file)
+bool emulator_crc32_file_ex(retro_emulator_file_t *file, uint8_t *buffer, crc_yield_cb_t yield)
 {
-    uint8_t buffer[0x1000];
+    size_t crc_offset = emu_get_file_crc_offset(file);
     uint32_t crc_tmp = 0;
-    int count = -1;
+    size_t count = 0;
+    char path[192];
     FILE *fp;
 
     if (file == NULL)
@@ -426,41 +984,67 @@ bool emulator_crc32_file(retro_emulator_file_t *file)
     if ((crc_tmp = crc_cache_lookup(file)))
     {
         file->checksum = crc_tmp;
+        return true;
     }
-    else
-    {
-        tab_t *tab = gui_get_current_tab();
-        gui_set_status(tab, NULL, "CRC32...");
-        gui_draw_status(tab);
 
-        if ((fp = fopen(emu_get_file_path(file), "rb")))
-        {
-            fseek(fp, emu_get_file_crc_offset(file), SEEK_SET);
+    if (!(fp = fopen(get_file_path(file, path, sizeof(path)), "rb")))
+        return false;
 
-            while (count != 0)
-            {
-                gui.joystick = rg_input_read_gamepad();
+    // Reads are cluster sized and start at offset 0, FatFs can then transfer whole clusters straight
+    // to our buffer instead of going through stdio's and its own sector buffers.
+    setvbuf(fp, NULL, _IONBF, 0);
 
-                if (gui.joystick & GAMEPAD_KEY_ANY)
-                    break;
+    while (true)
+    {
+        if (yield && !yield())
+            break;
 
-                count = fread(buffer, 1, sizeof(buffer), fp);
-                crc_tmp = crc32_le(crc_tmp, buffer, count);
-            }
+        size_t skip = RG_MIN(crc_offset, CRC_SCAN_BLOCK_SIZE);
 
-            if (feof(fp))
-            {
-                file->checksum = crc_tmp;
-                crc_cache_update(file);
-            }
+        if ((count = fread(buffer, 1, CRC_SCAN_BLOCK_SIZE, fp)) == 0)
+            break;
 
-            fclose(fp);
-        }
+        if (count > skip)
+            crc_tmp = crc32_le(crc_tmp, buffer + skip, count - skip);
 
-        gui_set_status(tab, NULL, "");
-        gui_draw_status(tab);
+        crc_offset -= RG_MIN(crc_offset, count);
+    }
+
+    if (feof(fp))
+    {
+        file->checksum = crc_tmp;
+        crc_cache_update(file);
     }
 
+    fclose(fp);
+
+    return file->checksum > 0;
+}
+
+bool emulator_crc32_file(retro_emulator_file_t *file)
+{
+    uint8_t *buffer;
+
+    if (file == NULL)
+        return false;
+
+    if (file->checksum > 0)
+        return true;
+
+    if (!(buffer = malloc(CRC_SCAN_BLOCK_SIZE)))
+        return false;
+
+    tab_t *tab = gui_get_current_tab();
+    gui_set_status(tab, NULL, "CRC32...");
+    gui_draw_status(tab);
+
+    emulator_crc32_file_ex(file, buffer, &crc_foreground_yield);
+
+    gui_set_status(tab, NULL, "");
+    gui_draw_status(tab);
+
+    free(buffer);
+
     return file->checksum > 0;
 }
 
@@ -477,9 +1061,9 @@ void emulator_show_file_info(retro_emulator_file_t *file)
     }
 
     dialog_option_t options[] = {
-        {0, "Name", file->name, 1, NULL},
-        {0, "Type", file->ext, 1, NULL},
-        {0, "Folder", file->folder, 1, NULL},
+        {0, "Name", (char *)file->name, 1, NULL},
+        {0, "Type", (char *)file->ext, 1, NULL},
+        {0, "Folder", (char *)file->folder, 1, NULL},
         {0, "Size", filesize, 1, NULL},
         {3, "CRC32", filecrc, 1, NULL},
         RG_DIALOG_SEPARATOR,
@@ -558,6 +1142,15 @@ void emulator_start(retro_emulator_file_t *file, bool load_state)
         RG_PANIC("Unable to find file...");
 
     rg_start_action_t action = load_state ? RG_START_ACTION_RESUME : RG_START_ACTION_NEWGAME;
+
+    if (rg_rom_get_staging())
+    {
+        // The checksum skips the header of some formats, it only identifies the whole file when it doesn't
+        uint32_t crc = emu_get_file_crc_offset(file) == 0 ? file->checksum : 0;
+        rg_gui_draw_hourglass();
+        rg_rom_stage(emu_get_file_path(file), crc);
+    }
+
     rg_emu_start_game(file->emulator->partition, emu_get_file_path(file), action);
 }
 
@@ -577,4 +1170,8 @@ void emulators_init()
     add_emulator("Neo Geo Pocket Color",          "ngp",  "ngp ngc", "ngpocket-go",  0, &logo_ngp,  &header_ngp);
 
     crc_cache_init();
+
+    crc_scanner.buffer = rg_alloc_tagged(CRC_SCAN_BLOCK_SIZE, MEM_FAST|MEM_DMA, "crc_scanner");
+    crc_scanner.queue = xQueueCreate(emulators_count + 1, sizeof(retro_emulator_t *));
+    xTaskCreatePinnedToCore(&crc_scanner_task, "crc_scanner", 4096, NULL, 1, NULL, 1);
 }
@@ -3,31 +3,80 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define CRC_CACHE_MAGIC 0x21112222
-#define CRC_CACHE_MAX_ENTRIES (0x10000 / sizeof(retro_crc_entry_t) - 1)
+#define CRC_CACHE_MAGIC 0x21112225
+#define CRC_CACHE_SLOTS 16384 // Must be a power of two
+#define CRC_CACHE_MAX_ENTRIES 8192 // Half the slots, which keeps the probe sequences short
+#define CRC_CACHE_PAGE_SIZE 512
+#define CRC_CACHE_READAHEAD 8 // Pages read at once when one is missing
 #define CRC_CACHE_PATH RG_BASE_PATH_CACHE "/crc32.bin"
+#define CRC_SCAN_BLOCK_SIZE 0x8000 // Typical cluster size of large FAT32 cards
+#define CRC_SCAN_IDLE_DELAY 100    // gui.idle_counter, the scanner pauses until the UI has been idle this long
+
+#define ROM_INDEX_MAGIC 0x58444E49 // "INDX"
+#define ROM_INDEX_VERSION 3
+#define ROM_INDEX_PATH RG_BASE_PATH_CACHE "/index_%s.bin"
 
 typedef struct __attribute__((__packed__))
 {
-    // uint64_t key;
-    uint32_t key;
+    uint32_t key;       // crc32(path, size, mtime), 0 means empty slot
     uint32_t crc;
 } retro_crc_entry_t;
 
+// The file is an image of this struct, it is paged in and out as needed (CRC_CACHE_PAGE_SIZE)
 typedef struct __attribute__((__packed__))
 {
     uint32_t magic;
     uint32_t count;
-    retro_crc_entry_t entries[CRC_CACHE_MAX_ENTRIES];
+    uint32_t hand;      // Next slot looked at by the eviction sweep
+    uint32_t reserved;
+    retro_crc_entry_t entries[CRC_CACHE_SLOTS]; // Open addressing, linear probing
 } retro_crc_cache_t;
 
+typedef struct __attribute__((__packed__))
+{
+    char path[96];      // Relative to the system's rom folder, empty for the root
+    uint32_t entries;   // Directory signature, the folder is rescanned when it changes. FAT doesn't
+    uint32_t hash;      // update a folder's mtime when files are added so we hash its listing.
+    uint32_t first;     // Index of the folder's first file
+    uint32_t count;
+} rom_index_dir_t;
+
+typedef struct __attribute__((__packed__))
+{
+    uint32_t name;      // Offset of "name\0ext\0" in the string table
+    uint32_t checksum;
+} rom_index_file_t;
+
+typedef struct __attribute__((__packed__))
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dirs_count;
+    uint32_t files_count;
+    uint32_t strings_size;
+    // rom_index_dir_t dirs[dirs_count];
+    // rom_index_file_t files[files_count];
+    // char strings[strings_size];
+} rom_index_header_t;
+
+#define STRING_POOL_BLOCK_SIZE 4096
+
+// Strings are never moved or freed individually, pointers remain valid for the lifetime of the pool
+typedef struct string_pool_s
+{
+    struct string_pool_s *next;
+    size_t used;
+    size_t size;
+    char data[];
+} string_pool_t;
+
 typedef struct retro_emulator_s retro_emulator_t;
 
 typedef struct
 {
-    char name[128];
-    char ext[8];
-    char folder[32];
+    const char *name;   // Relative path without the extension, stored in a string pool
+    const char *ext;
+    const char *folder; // Shared by all the files of an emulator
     uint32_t checksum;
     uint16_t missing_cover;
     uint8_t  is_valid;
@@ -44,6 +93,8 @@ typedef struct retro_emulator_s
     struct {
         retro_emulator_file_t *files;
         size_t count;
+        string_pool_t *strings;
+        const char *placeholder[2]; // Shown when there are no ROMs, interned once
     } roms;
     bool crc_scan_done;
     bool initialized;
@@ -51,14 +102,22 @@ typedef struct retro_emulator_s
 
 typedef struct tab_s tab_t;
 
+// Called before every block read by emulator_crc32_file_ex, returning false aborts the scan
+typedef bool (*crc_yield_cb_t)(void);
+
 void emulators_init();
 void emulator_init(retro_emulator_t *emu);
 void emulator_start(retro_emulator_file_t *file, bool load_state);
 void emulator_show_file_menu(retro_emulator_file_t *file);
 void emulator_show_file_info(retro_emulator_file_t *file);
 bool emulator_crc32_file(retro_emulator_file_t *file);
-bool emulator_build_file_object(const char *path, retro_emulator_file_t *out_file);
+bool emulator_crc32_file_ex(retro_emulator_file_t *file, uint8_t *buffer, crc_yield_cb_t yield);
+bool emulator_build_file_object(const char *path, retro_emulator_file_t *out_file, string_pool_t **pool);
+bool emulator_dir_signature(const char *path, uint32_t *entries, uint32_t *hash);
 const char *emu_get_file_path(retro_emulator_file_t *file);
+char *string_pool_alloc(string_pool_t **pool, size_t size);
+const char *string_pool_add(string_pool_t **pool, const char *str);
+void string_pool_free(string_pool_t **pool);
 size_t emu_get_file_crc_offset(retro_emulator_file_t *file);
 
 void crc_cache_init(void);
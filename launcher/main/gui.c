@@ -1,4 +1,8 @@
 #include <rg_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
@@ -18,6 +22,8 @@
 #define LIST_X_OFFSET       (0)
 #define LIST_Y_OFFSET       (48 + 8)
 
+#define LIST_MAX_LINES      (64)
+
 #define COVER_MAX_HEIGHT    (184)
 #define COVER_MAX_WIDTH     (184)
 
@@ -42,6 +48,48 @@ const int gui_themes_count = sizeof(gui_themes) / sizeof(theme_t);
 
 retro_gui_t gui;
 
+// What each list row currently shows on screen, rows that are unchanged aren't redrawn
+static struct
+{
+    const char *text; // NULL if the row must be redrawn
+    uint16_t color_fg;
+    uint16_t color_bg;
+} list_shadow[LIST_MAX_LINES];
+static bool list_shadow_filled = false; // The area below the last row
+
+static cover_cache_t *cover_cache;
+static bool cover_cache_ready = false;
+
+// Art folder signatures, read once per session (see cover_art_stamp)
+static struct
+{
+    uint32_t folder;
+    uint32_t stamp;
+} cover_art_stamps[32];
+static size_t cover_art_stamps_count;
+
+static struct
+{
+    QueueHandle_t queue;        // Files to load (preview_request_t)
+    SemaphoreHandle_t lock;     // Protects the slots
+    preview_slot_t slots[PREVIEW_CACHE_SIZE];
+    uint32_t clock;
+    const retro_emulator_file_t *volatile wanted[PREVIEW_PREFETCH_DISTANCE * 2 + 1]; // Cursor and its neighbors
+    const retro_emulator_file_t *volatile working; // File being loaded by the worker
+    const retro_emulator_file_t *drawn;            // File whose preview is on screen
+} preview;
+
+static const uint32_t preview_orders[PREVIEW_MODE_COUNT] = {
+    [PREVIEW_MODE_NONE]       = 0x0000,
+    [PREVIEW_MODE_COVER_SAVE] = 0x0312,
+    [PREVIEW_MODE_SAVE_COVER] = 0x0123,
+    [PREVIEW_MODE_COVER_ONLY] = 0x0012,
+    [PREVIEW_MODE_SAVE_ONLY]  = 0x0003,
+};
+
+static void preview_task(void *arg);
+static void preview_flush(void);
+
 #define CONCAT(a, b) ({char buffer[128]; strcat(strcpy(buffer, a), b);})
 #define SETTING_SELECTED_TAB    "SelectedTab"
 #define SETTING_GUI_THEME       "ColorTheme"
@@ -61,6 +109,10 @@ void gui_init(void)
     gui.width = rg_display_get_status()->screen.width;
     gui.height = rg_display_get_status()->screen.height;
     rg_display_clear(C_BLACK);
+
+    preview.lock = xSemaphoreCreateMutex();
+    preview.queue = xQueueCreate(PREVIEW_PREFETCH_DISTANCE * 2 + 1, sizeof(preview_request_t));
+    xTaskCreatePinnedToCore(&preview_task, "gui_preview", 6144, NULL, 1, NULL, 1);
 }
 
 void gui_event(gui_event_t event, tab_t *tab)
@@ -249,7 +301,7 @@ void gui_resize_list(tab_t *tab, int new_size)
     {
         tab->listbox.items = realloc(tab->listbox.items, new_size * sizeof(listbox_item_t));
         for (int i = cur_size; i < new_size; i++)
-            memset(&tab->listbox.items[i], 0, sizeof(listbox_item_t));
+            tab->listbox.items[i] = (listbox_item_t){.text = ""};
     }
 
     tab->listbox.length = new_size;
@@ -316,6 +368,11 @@ void gui_scroll_list(tab_t *tab, scroll_mode_t mode, int arg)
 void gui_redraw()
 {
     tab_t *tab = gui_get_current_tab();
+    gui_invalidate_list(0);
+    // Whatever happened while we were away (a save state was deleted, etc) may have changed the previews
+    preview_flush();
+    preview.drawn = NULL;
+    memset((void *)preview.wanted, 0, sizeof(preview.wanted));
     gui_draw_header(tab);
     gui_draw_status(tab);
     gui_draw_list(tab);
@@ -362,70 +419,315 @@ void gui_draw_status(tab_t *tab)
     rg_gui_draw_text(status_x, status_y, 0, txt_left, C_WHITE, C_BLACK, RG_TEXT_ALIGN_RIGHT);
 }
 
+void gui_invalidate_list(int y_pos)
+{
+    int line_height = rg_gui_get_font_info().height;
+
+    for (int i = 0; i < LIST_MAX_LINES; i++)
+    {
+        if (LIST_Y_OFFSET + (i + 1) * line_height > y_pos)
+            list_shadow[i].text = NULL;
+    }
+
+    list_shadow_filled = false;
+}
+
 void gui_draw_list(tab_t *tab)
 {
     const theme_t *theme = &gui_themes[gui.theme % gui_themes_count];
-    const listbox_t *list = &tab->listbox;
+    listbox_t *list = &tab->listbox;
     char text_label[64];
     uint16_t color_fg = theme->list_standard;
     uint16_t color_bg = theme->list_background;
 
-    int lines = LIST_LINE_COUNT;
+    int lines = RG_MIN(LIST_LINE_COUNT, LIST_MAX_LINES);
+    int line_height = rg_gui_get_font_info().height;
     int y = LIST_Y_OFFSET;
     int y_max = y + LIST_HEIGHT;
 
-    for (int i = 0; i < lines; i++)
-    {
-        int entry = list->cursor + i - (lines / 2);
+    // The window moves as little as possible, stepping inside it only changes two rows
+    if (list->cursor == list->top - 1)
+        list->top--;
+    else if (list->cursor == list->top + lines)
+        list->top++;
+    else if (list->cursor < list->top || list->cursor >= list->top + lines)
+        list->top = list->cursor - (lines / 2);
+    list->top = RG_MAX(RG_MIN(list->top, list->length - lines), 0);
 
-        if (entry >= 0 && entry < list->length) {
-            sprintf(text_label, "%.63s", list->items[entry].text);
-        } else {
-            text_label[0] = '\0';
-        }
+    for (int i = 0; i < lines; i++, y += line_height)
+    {
+        int entry = list->top + i;
+        const char *text = (entry >= 0 && entry < list->length) ? list->items[entry].text : "";
 
         color_fg = (entry == list->cursor) ? theme->list_selected : theme->list_standard;
         color_bg = (int)(16.f / lines * i) << theme->list_background;
 
-        y += rg_gui_draw_text(LIST_X_OFFSET, y, LIST_WIDTH, text_label, color_fg, color_bg, 0).height;
+        if (list_shadow[i].text == text && list_shadow[i].color_fg == color_fg && list_shadow[i].color_bg == color_bg)
+            continue;
+
+        sprintf(text_label, "%.63s", text);
+        rg_gui_draw_text(LIST_X_OFFSET, y, LIST_WIDTH, text_label, color_fg, color_bg, 0);
+
+        list_shadow[i].text = text;
+        list_shadow[i].color_fg = color_fg;
+        list_shadow[i].color_bg = color_bg;
     }
 
-    if (y < y_max)
+    if (y < y_max && !list_shadow_filled)
         rg_gui_draw_fill_rect(0, y, LIST_WIDTH, y_max - y, color_bg);
+
+    list_shadow_filled = true;
 }
 
-void gui_draw_preview(tab_t *tab, retro_emulator_file_t *file)
+// The cache is rebuilt from scratch, any cover still in the file is lost
+static bool cover_cache_reset(void)
+{
+    memset(cover_cache, 0, sizeof(cover_cache_t));
+    cover_cache->magic = COVER_CACHE_MAGIC;
+
+    rg_mkdir(RG_BASE_PATH_CACHE);
+
+    FILE *fp = fopen(COVER_CACHE_PATH, "wb");
+    if (!fp)
+        return false;
+
+    bool success = fwrite(cover_cache, sizeof(cover_cache_t), 1, fp) == 1;
+    fclose(fp);
+
+    return success;
+}
+
+static void cover_cache_init(void)
+{
+    if (cover_cache_ready)
+        return;
+
+    cover_cache = rg_alloc_tagged(sizeof(cover_cache_t), MEM_SLOW, "cover_cache");
+    cover_cache_ready = true;
+
+    FILE *fp = fopen(COVER_CACHE_PATH, "rb");
+    if (fp)
+    {
+        bool valid = fread(cover_cache, sizeof(cover_cache_t), 1, fp) == 1
+                        && cover_cache->magic == COVER_CACHE_MAGIC
+                        && cover_cache->count <= COVER_CACHE_MAX_ENTRIES;
+        fclose(fp);
+
+        if (valid)
+        {
+            RG_LOGI("Loaded cover cache (%d entries)\n", cover_cache->count);
+            return;
+        }
+    }
+
+    if (!cover_cache_reset())
+    {
+        RG_LOGE("Unable to create cover cache '%s'\n", COVER_CACHE_PATH);
+        free(cover_cache);
+        cover_cache = NULL;
+    }
+}
+
+static uint64_t cover_cache_calc_key(retro_emulator_file_t *file)
+{
+    const char *dirname = file->emulator->dirname;
+    return (uint64_t)crc32_le(0, (void *)dirname, strlen(dirname)) << 32 | file->checksum;
+}
+
+// A game without a cover gets one when a file is added to its art folder, which changes the
+// folder's listing. Negative entries are only trusted while the signature they recorded holds.
+static uint32_t cover_art_stamp(retro_emulator_file_t *file)
 {
     const char *dirname = file->emulator->dirname;
-    bool show_missing_cover = false;
-    uint32_t order;
+    uint32_t folder = crc32_le(0, (void *)dirname, strlen(dirname)) ^ (file->checksum >> 28);
+    uint32_t entries = 0, hash = 0;
     char path[256];
 
-    switch (gui.show_preview)
-    {
-        case PREVIEW_MODE_COVER_SAVE:
-            show_missing_cover = true;
-            order = 0x0312;
-            break;
-        case PREVIEW_MODE_SAVE_COVER:
-            show_missing_cover = true;
-            order = 0x0123;
-            break;
-        case PREVIEW_MODE_COVER_ONLY:
-            show_missing_cover = true;
-            order = 0x0012;
-            break;
-        case PREVIEW_MODE_SAVE_ONLY:
-            show_missing_cover = false;
-            order = 0x0003;
-            break;
-        default:
-            show_missing_cover = false;
-            order = 0x0000;
+    for (size_t i = 0; i < cover_art_stamps_count; i++)
+    {
+        if (cover_art_stamps[i].folder == folder)
+            return cover_art_stamps[i].stamp;
+    }
+
+    // A folder that doesn't exist has a signature too, creating it changes it
+    sprintf(path, RG_BASE_PATH_ROMART "/%s/%X", dirname, file->checksum >> 28);
+    emulator_dir_signature(path, &entries, &hash);
+
+    uint32_t stamp = (hash ^ entries) ?: 1;
+
+    if (cover_art_stamps_count < sizeof(cover_art_stamps) / sizeof(cover_art_stamps[0]))
+    {
+        cover_art_stamps[cover_art_stamps_count].folder = folder;
+        cover_art_stamps[cover_art_stamps_count].stamp = stamp;
+        cover_art_stamps_count++;
+    }
+
+    return stamp;
+}
+
+static cover_cache_entry_t *cover_cache_find(retro_emulator_file_t *file)
+{
+    uint64_t key = cover_cache_calc_key(file);
+    size_t index = (key ^ (key >> 32)) & (COVER_CACHE_SLOTS - 1);
+
+    while (cover_cache->entries[index].key != 0)
+    {
+        if (cover_cache->entries[index].key == key)
+            return &cover_cache->entries[index];
+        index = (index + 1) & (COVER_CACHE_SLOTS - 1);
+    }
+
+    return NULL;
+}
+
+// A NULL image records that the game has no cover at all. Only a game without a cover can be
+// stored again, when its entry has expired.
+static void cover_cache_store(retro_emulator_file_t *file, const rg_image_t *img)
+{
+    if (!cover_cache || !file->checksum)
+        return;
+
+    uint64_t key = cover_cache_calc_key(file);
+    size_t home = (key ^ (key >> 32)) & (COVER_CACHE_SLOTS - 1);
+    size_t index = home;
+    size_t size = img ? img->width * img->height * 2 : 0;
+
+    while (cover_cache->entries[index].key != 0 && cover_cache->entries[index].key != key)
+        index = (index + 1) & (COVER_CACHE_SLOTS - 1);
+
+    if (cover_cache->entries[index].key == key && cover_cache->entries[index].offset)
+        return;
+
+    FILE *fp = fopen(COVER_CACHE_PATH, "r+b");
+    if (!fp)
+        return;
+
+    fseek(fp, 0, SEEK_END);
+    size_t end = ftell(fp);
+
+    // Covers are only ever appended, instead of compacting we start over once either limit is hit
+    if ((cover_cache->entries[index].key == 0 && cover_cache->count >= COVER_CACHE_MAX_ENTRIES)
+        || end + size > COVER_CACHE_MAX_SIZE)
+    {
+        RG_LOGI("Cover cache is full (%d entries, %d bytes), starting over.\n", cover_cache->count, end);
+        fclose(fp);
+        if (!cover_cache_reset() || !(fp = fopen(COVER_CACHE_PATH, "r+b")))
+        {
+            RG_LOGE("Unable to reset cover cache '%s'\n", COVER_CACHE_PATH);
+            free(cover_cache);
+            cover_cache = NULL;
+            return;
+        }
+        index = home;
+        end = sizeof(cover_cache_t);
+    }
+
+    bool is_new = cover_cache->entries[index].key == 0;
+    cover_cache_entry_t entry = {key, 0, 0, 0, 0};
+
+    if (img)
+    {
+        fseek(fp, end, SEEK_SET);
+        entry.offset = end;
+        entry.width = img->width;
+        entry.height = img->height;
+        if (fwrite(img->data, img->width * img->height * 2, 1, fp) != 1)
+        {
+            RG_LOGE("Unable to append cover to the cache\n");
+            fclose(fp);
+            return;
+        }
+    }
+    else
+    {
+        entry.stamp = cover_art_stamp(file);
+    }
+
+    cover_cache->entries[index] = entry;
+    cover_cache->count += is_new;
+
+    fseek(fp, offsetof(cover_cache_t, entries) + index * sizeof(entry), SEEK_SET);
+    fwrite(&entry, sizeof(entry), 1, fp);
+    fseek(fp, offsetof(cover_cache_t, count), SEEK_SET);
+    fwrite(&cover_cache->count, sizeof(cover_cache->count), 1, fp);
+    fclose(fp);
+}
+
+static rg_image_t *cover_cache_load(const cover_cache_entry_t *entry)
+{
+    rg_image_t *img = NULL;
+
+    FILE *fp = rg_file_open(COVER_CACHE_PATH, "rb", 0);
+    if (!fp)
+        return NULL;
+
+    if (fseek(fp, entry->offset, SEEK_SET) == 0
+        && (img = rg_image_alloc(entry->width, entry->height))
+        && fread(img->data, entry->width * entry->height * 2, 1, fp) != 1)
+    {
+        rg_image_free(img);
+        img = NULL;
+    }
+
+    fclose(fp);
+
+    return img;
+}
+
+static bool preview_is_wanted(const retro_emulator_file_t *file)
+{
+    for (int i = 0; i < PREVIEW_PREFETCH_DISTANCE * 2 + 1; i++)
+    {
+        if (preview.wanted[i] == file)
+            return true;
+    }
+    return false;
+}
+
+static bool preview_yield(void)
+{
+    // Abort as soon as the cursor has moved too far away from the file being loaded
+    return preview_is_wanted(preview.working);
+}
+
+// Must be called with preview.lock held
+static preview_slot_t *preview_find(const retro_emulator_file_t *file, int mode)
+{
+    for (int i = 0; i < PREVIEW_CACHE_SIZE; i++)
+    {
+        preview_slot_t *slot = &preview.slots[i];
+        if (slot->file == file && slot->name == file->name && slot->mode == mode)
+        {
+            slot->last_used = ++preview.clock;
+            return slot;
+        }
     }
+    return NULL;
+}
+
+static void preview_flush(void)
+{
+    if (!preview.lock)
+        return;
+
+    xSemaphoreTake(preview.lock, portMAX_DELAY);
+    for (int i = 0; i < PREVIEW_CACHE_SIZE; i++)
+    {
+        rg_image_free(preview.slots[i].img);
+        free(preview.slots[i].stream_path);
+        preview.slots[i] = (preview_slot_t){0};
+    }
+    xSemaphoreGive(preview.lock);
+}
 
+// Returns false if the load was cancelled
+static bool preview_load(retro_emulator_file_t *file, int mode, rg_image_t **out_img, char **out_path, uint32_t *out_errors)
+{
+    const char *dirname = file->emulator->dirname;
+    uint32_t order = preview_orders[mode % PREVIEW_MODE_COUNT];
     rg_image_t *img = NULL;
     uint32_t errors = 0;
+    char path[256];
 
     while (order && !img)
     {
@@ -438,16 +740,37 @@ void gui_draw_preview(tab_t *tab, retro_emulator_file_t *file)
             continue;
         }
 
-        gui.joystick = rg_input_read_gamepad();
+        if ((type == 0x1 || type == 0x2) && file->checksum == 0)
+        {
+            uint8_t *buffer = malloc(CRC_SCAN_BLOCK_SIZE);
+            if (buffer)
+            {
+                emulator_crc32_file_ex(file, buffer, &preview_yield);
+                free(buffer);
+            }
+        }
 
-        if (type == 0x1 || type == 0x2)
+        if (!preview_yield())
         {
-            emulator_crc32_file(file);
+            return false;
         }
 
-        if (gui.joystick & GAMEPAD_KEY_ANY)
+        if ((type == 0x1 || type == 0x2) && file->checksum)
         {
-            break;
+            cover_cache_init();
+
+            cover_cache_entry_t *entry = cover_cache ? cover_cache_find(file) : NULL;
+            // Files were added to the art folder since we found no cover, look again
+            if (entry && !entry->offset && entry->stamp != cover_art_stamp(file))
+                entry = NULL;
+            if (entry)
+            {
+                if (entry->offset && (img = cover_cache_load(entry)))
+                    break;
+                // Either the game has no cover or the cache is damaged, skip both formats
+                file->missing_cover |= (1 << 0x1) | (1 << 0x2);
+                continue;
+            }
         }
 
         if (type == 0x1) // Game cover (old format)
@@ -463,26 +786,190 @@ void gui_draw_preview(tab_t *tab, retro_emulator_file_t *file)
 
         if (access(path, F_OK) == 0)
         {
-            img = rg_image_load_from_file(path, 0);
+            // Save screenshots change with every save and aren't worth caching, they are streamed
+            // from the file to the display when drawn and never need a buffer
+            if (type == 0x3 && (*out_path = strdup(path)))
+                break;
+
+            // Scaled while decoding, the full size image never exists in memory
+            img = rg_image_load_scaled(path, COVER_MAX_WIDTH, COVER_MAX_HEIGHT);
             if (!img)
                 errors++;
         }
 
         file->missing_cover |= (img ? 0 : 1) << type;
+
+        if (type == 0x1 || type == 0x2)
+        {
+            if (img)
+                cover_cache_store(file, img);
+            else if (!errors && (file->missing_cover & (1 << 0x1)) && (file->missing_cover & (1 << 0x2)))
+                cover_cache_store(file, NULL);
+        }
     }
 
-    if (img)
+    *out_img = img;
+    *out_errors = errors;
+
+    return true;
+}
+
+static void preview_task(void *arg)
+{
+    preview_request_t req;
+
+    while (xQueueReceive(preview.queue, &req, portMAX_DELAY) == pdTRUE)
     {
-        int height = RG_MIN(img->height, COVER_MAX_HEIGHT);
-        int width = RG_MIN(img->width, COVER_MAX_WIDTH);
+        rg_image_t *img = NULL;
+        char *stream_path = NULL;
+        uint32_t errors = 0;
 
-        rg_gui_draw_image(-width, -height, width, height, img);
-        rg_image_free(img);
+        preview.working = req.file;
+
+        if (!preview_is_wanted(req.file))
+            continue;
+
+        xSemaphoreTake(preview.lock, portMAX_DELAY);
+        bool loaded = preview_find(req.file, req.mode) != NULL;
+        xSemaphoreGive(preview.lock);
+
+        if (loaded || !preview_load(&req.copy, req.mode, &img, &stream_path, &errors))
+            continue;
+
+        xSemaphoreTake(preview.lock, portMAX_DELAY);
+        preview_slot_t *slot = &preview.slots[0];
+        for (int i = 1; i < PREVIEW_CACHE_SIZE; i++)
+        {
+            if (preview.slots[i].last_used < slot->last_used)
+                slot = &preview.slots[i];
+        }
+        rg_image_free(slot->img);
+        free(slot->stream_path);
+        *slot = (preview_slot_t){
+            .file = req.file,
+            .name = req.copy.name,
+            .img = img,
+            .stream_path = stream_path,
+            .checksum = req.copy.checksum,
+            .missing_cover = req.copy.missing_cover,
+            .mode = req.mode,
+            .errors = errors,
+            .last_used = ++preview.clock,
+        };
+        xSemaphoreGive(preview.lock);
     }
-    else if (file->checksum && (show_missing_cover || errors))
+
+    vTaskDelete(NULL);
+}
+
+void gui_prefetch_previews(tab_t *tab)
+{
+    if (!preview.queue)
+        return;
+
+    preview.drawn = NULL;
+
+    // Requests for items we've scrolled past are dropped, the worker only sees the new window
+    xQueueReset(preview.queue);
+
+    for (int i = 0; i < PREVIEW_PREFETCH_DISTANCE * 2 + 1; i++)
     {
-        RG_LOGI("No image found for '%s'\n", file->name);
-        gui_set_status(tab, NULL, errors ? "Bad cover" : "No cover");
-        gui_draw_status(tab);
+        // Cursor first, then alternate below and above it
+        int index = tab->listbox.cursor + ((i & 1) ? (i + 1) / 2 : -(i / 2));
+        retro_emulator_file_t *file = NULL;
+
+        if (!tab->is_empty && index >= 0 && index < tab->listbox.length)
+            file = (retro_emulator_file_t *)tab->listbox.items[index].arg;
+
+        preview.wanted[i] = file;
+
+        if (!file || !gui.show_preview)
+            continue;
+
+        xSemaphoreTake(preview.lock, portMAX_DELAY);
+        bool loaded = preview_find(file, gui.show_preview) != NULL;
+        xSemaphoreGive(preview.lock);
+
+        if (!loaded)
+        {
+            preview_request_t req = {file, *file, gui.show_preview};
+            xQueueSend(preview.queue, &req, 0);
+        }
     }
 }
+
+// Returns true once the preview is on screen, it can be called on every idle tick until then
+bool gui_draw_preview(tab_t *tab, retro_emulator_file_t *file)
+{
+    bool show_missing_cover = gui.show_preview != PREVIEW_MODE_SAVE_ONLY;
+
+    if (preview.drawn == file)
+        return true;
+
+    if (!preview.lock)
+        return false;
+
+    xSemaphoreTake(preview.lock, portMAX_DELAY);
+
+    preview_slot_t *slot = preview_find(file, gui.show_preview);
+    if (!slot)
+    {
+        xSemaphoreGive(preview.lock);
+        // Not even requested, we probably got here without scrolling (tab change, redraw)
+        if (preview.wanted[0] != file)
+            gui_prefetch_previews(tab);
+        return false;
+    }
+
+    // Keep what the worker learned about the file, so that nothing is computed twice
+    if (file->checksum == 0)
+        file->checksum = slot->checksum;
+    file->missing_cover |= slot->missing_cover;
+
+    if (slot->img)
+    {
+        int height = RG_MIN(slot->img->height, COVER_MAX_HEIGHT);
+        int width = RG_MIN(slot->img->width, COVER_MAX_WIDTH);
+
+        rg_gui_draw_image(-width, -height, width, height, slot->img);
+        xSemaphoreGive(preview.lock);
+        // The cover hides part of the list, those rows will have to be repainted
+        gui_invalidate_list(gui.height - height);
+    }
+    else if (slot->stream_path)
+    {
+        char path[256];
+        snprintf(path, sizeof(path), "%s", slot->stream_path);
+        xSemaphoreGive(preview.lock);
+
+        // Negative positions align the image with the bottom right corner, like covers
+        bool drawn = rg_image_draw_from_file(path, -1, -1, COVER_MAX_WIDTH, COVER_MAX_HEIGHT);
+
+        // The display was written behind the GUI's back, its canvas no longer matches
+        rg_gui_compose_invalidate();
+        gui_invalidate_list(gui.height - COVER_MAX_HEIGHT);
+
+        if (!drawn)
+        {
+            RG_LOGE("Unable to draw '%s'\n", path);
+            gui_set_status(tab, NULL, "Bad cover");
+            gui_draw_status(tab);
+        }
+    }
+    else
+    {
+        bool errors = slot->errors > 0;
+        xSemaphoreGive(preview.lock);
+
+        if (file->checksum && (show_missing_cover || errors))
+        {
+            RG_LOGI("No image found for '%s'\n", file->name);
+            gui_set_status(tab, NULL, errors ? "Bad cover" : "No cover");
+            gui_draw_status(tab);
+        }
+    }
+
+    preview.drawn = file;
+
+    return true;
+}
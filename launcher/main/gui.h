@@ -4,6 +4,50 @@
 #include <stdbool.h>
 #include "emulators.h"
 
+#define COVER_CACHE_MAGIC 0x32564F43 // "COV2"
+#define COVER_CACHE_SLOTS 4096 // Must be a power of two
+#define COVER_CACHE_MAX_ENTRIES (COVER_CACHE_SLOTS * 3 / 4)
+#define COVER_CACHE_MAX_SIZE (48 * 1024 * 1024) // The cache starts over when it would grow past it
+#define COVER_CACHE_PATH RG_BASE_PATH_CACHE "/covers.bin"
+
+typedef struct __attribute__((__packed__))
+{
+    uint64_t key;       // crc32(dirname) << 32 | checksum, 0 means empty slot
+    uint32_t offset;    // Position of the RGB565 pixels in the file, 0 means the game has no cover
+    uint32_t stamp;     // No cover: signature of the art folder it would be in, see cover_art_stamp
+    uint16_t width;
+    uint16_t height;
+} cover_cache_entry_t;
+
+// The file starts with this struct, the pixels of every cover are appended after it
+typedef struct __attribute__((__packed__))
+{
+    uint32_t magic;
+    uint32_t count;
+    cover_cache_entry_t entries[COVER_CACHE_SLOTS]; // Open addressing, linear probing
+} cover_cache_t;
+
+#define PREVIEW_CACHE_SIZE 6        // Decoded previews kept in memory
+#define PREVIEW_PREFETCH_DISTANCE 2 // Items preloaded above and below the cursor
+
+typedef struct {
+    const retro_emulator_file_t *file; // The list item it belongs to
+    const char *name;                  // Compared too, in case the list was reallocated
+    rg_image_t *img;                   // NULL if there is no preview
+    char *stream_path;                 // Or the file to stream to the display, see gui_draw_preview
+    uint32_t checksum;
+    uint16_t missing_cover;
+    uint8_t mode;                      // gui.show_preview when it was loaded
+    uint8_t errors;
+    uint32_t last_used;
+} preview_slot_t;
+
+typedef struct {
+    const retro_emulator_file_t *file;
+    retro_emulator_file_t copy; // The worker never touches the list itself
+    int mode;
+} preview_request_t;
+
 typedef enum {
     KEY_PRESS_A,
     KEY_PRESS_B,
@@ -57,7 +101,7 @@ typedef struct {
 } theme_t;
 
 typedef struct {
-    char text[128];
+    const char *text; // Not owned by the list, it must outlive it
     int enabled;
     int id;
     int arg_type;
@@ -69,6 +113,7 @@ typedef struct {
     listbox_item_t *items;
     int length;
     int cursor;
+    int top;        // First visible item, the window follows the cursor
     int sort_mode;
 } listbox_t;
 
@@ -128,4 +173,6 @@ void gui_draw_navbar(void);
 void gui_draw_header(tab_t *tab);
 void gui_draw_status(tab_t *tab);
 void gui_draw_list(tab_t *tab);
-void gui_draw_preview(tab_t *tab, retro_emulator_file_t *file);
+void gui_invalidate_list(int y_pos);
+bool gui_draw_preview(tab_t *tab, retro_emulator_file_t *file);
+void gui_prefetch_previews(tab_t *tab);
@@ -81,6 +81,15 @@ static dialog_return_t disk_activity_cb(dialog_option_t *option, dialog_event_t
     return RG_DIALOG_IGNORE;
 }
 
+static dialog_return_t rom_staging_cb(dialog_option_t *option, dialog_event_t event)
+{
+    if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT) {
+        rg_rom_set_staging(!rg_rom_get_staging());
+    }
+    strcpy(option->value, rg_rom_get_staging() ? "On " : "Off");
+    return RG_DIALOG_IGNORE;
+}
+
 static dialog_return_t show_preview_cb(dialog_option_t *option, dialog_event_t event)
 {
     if (event == RG_DIALOG_PREV) {
@@ -183,11 +192,24 @@ void retro_loop()
 
         if (last_key == GAMEPAD_KEY_MENU) {
             const dialog_option_t options[] = {
-                {1, "Clear cache", NULL, 1, NULL},
+                {1, "Rescan ROMs", NULL, 1, NULL},
+                {2, "Clear cache", NULL, 1, NULL},
                 RG_DIALOG_CHOICE_LAST
             };
-            if (rg_gui_about_menu(options) == 1) {
-                unlink(CRC_CACHE_PATH);
+            int sel = rg_gui_about_menu(options);
+            if (sel == 1 || sel == 2) {
+                rg_strings_t *files = rg_readdir(RG_BASE_PATH_CACHE, RG_FILES_ONLY);
+                char *name = files ? files->buffer : NULL;
+                char path[PATH_MAX + 1];
+                // Removing the ROM indexes forces a full rescan of every folder
+                for (size_t i = 0; files && i < files->count; i++, name += strlen(name) + 1)
+                {
+                    if (sel == 1 && strncmp(name, "index_", 6) != 0)
+                        continue;
+                    snprintf(path, sizeof(path), "%s/%s", RG_BASE_PATH_CACHE, name);
+                    unlink(path);
+                }
+                free(files);
                 rg_system_restart();
             }
             gui_redraw();
@@ -202,6 +224,7 @@ void retro_loop()
                 {0, "Toggle tabs", "Press A", 1, &toggle_tabs_cb},
                 {0, "Startup app", "...", 1, &startup_app_cb},
                 {0, "Disk LED   ", "...", 1, &disk_activity_cb},
+                {0, "ROM staging", "...", 1, &rom_staging_cb},
                 RG_DIALOG_CHOICE_LAST
             };
             rg_gui_settings_menu(options);
@@ -752,6 +752,47 @@ void apu_emulate(void)
    apu_process(apu.buffer, apu.samples_per_frame, apu.stereo);
 }
 
+/* Advance one frame without synthesizing any audio (fast-forward).
+** Only the state the CPU can observe is kept up to date: the length
+** counters reported by $4015 and the DMC (memory reads and irq).
+*/
+void apu_skip(void)
+{
+   int samples = apu.samples_per_frame;
+
+   for (int ch = 0; ch < 2; ch++)
+   {
+      if (apu.rectangle[ch].enabled && !apu.rectangle[ch].holdnote)
+         apu.rectangle[ch].vbl_length -= MIN(apu.rectangle[ch].vbl_length, samples);
+   }
+
+   if (apu.noise.enabled && !apu.noise.holdnote)
+      apu.noise.vbl_length -= MIN(apu.noise.vbl_length, samples);
+
+   if (apu.triangle.enabled && apu.triangle.vbl_length)
+   {
+      int remaining = samples;
+
+      if (!apu.triangle.counter_started && !apu.triangle.holdnote && apu.triangle.write_latency)
+      {
+         int latency = MIN(apu.triangle.write_latency, remaining);
+         remaining -= latency;
+         if ((apu.triangle.write_latency -= latency) == 0)
+            apu.triangle.counter_started = true;
+      }
+
+      if (apu.triangle.counter_started)
+      {
+         apu.triangle.linear_length -= MIN(apu.triangle.linear_length, remaining);
+         if (!apu.triangle.holdnote)
+            apu.triangle.vbl_length -= MIN(apu.triangle.vbl_length, remaining);
+      }
+   }
+
+   for (int i = 0; i < samples && apu.dmc.dma_length; i++)
+      apu_dmc();
+}
+
 void apu_setopt(apu_option_t n, int val)
 {
    // Some options need special care
@@ -223,6 +223,7 @@ extern void apu_shutdown(void);
 extern void apu_setext(apuext_t *ext);
 
 extern void apu_emulate(void);
+extern void apu_skip(void);
 
 extern void apu_setopt(apu_option_t n, int val);
 extern int  apu_getopt(apu_option_t n);
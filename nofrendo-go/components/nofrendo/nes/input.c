@@ -36,6 +36,9 @@ IRAM_ATTR void input_write(uint32 address, uint8 value)
 
     if (0 == value && strobe)
     {
+        /* the game is latching the pads, give the port a chance to sample them now */
+        osd_latchinput();
+
         for (int i = 0; i < INP_TYPE_MAX; ++i)
             nes_inputs[i].reads = 0;
     }
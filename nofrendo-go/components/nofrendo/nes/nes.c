@@ -104,7 +104,10 @@ void nes_emulate(void)
             nes.vidbuf = nes.framebuffers[nes.vidbuf == nes.framebuffers[0]];
         }
 
-        apu_emulate();
+        if (nes.skipaudio)
+            apu_skip();
+        else
+            apu_emulate();
 
         osd_vsync();
     }
@@ -159,6 +162,14 @@ bool nes_insertcart(const char *filename)
     nes.ppu->vram_present = (nes.cart->chr_rom == NULL);
     // nes.ppu->vram_present = (NULL != nes.cart->chr_ram); // FIX ME: This is always true?
 
+    /* CHR-ROM that is mapped from flash must never be written to */
+    nes.ppu->chr_readonly_start = nes.ppu->chr_readonly_end = NULL;
+    if (nes.cart->chr_rom && (nes.cart->flags & ROM_FLAG_MAPPED_DATA))
+    {
+        nes.ppu->chr_readonly_start = nes.cart->chr_rom;
+        nes.ppu->chr_readonly_end = nes.cart->chr_rom + nes.cart->chr_rom_banks * ROM_CHR_BANK_SIZE;
+    }
+
     nes_setregion(nes.region);
     nes_setcompathacks();
 
@@ -184,7 +195,8 @@ void nes_reset(bool hard_reset)
     {
         if (nes.cart->chr_ram_banks > 0)
             memset(nes.cart->chr_ram, 0, nes.cart->chr_ram_banks * ROM_CHR_BANK_SIZE);
-        if (nes.cart->prg_ram_banks > 0)
+        // Battery backed RAM survives a power cycle
+        if (nes.cart->prg_ram_banks > 0 && !(nes.cart->flags & ROM_FLAG_BATTERY))
             memset(nes.cart->prg_ram, 0, nes.cart->prg_ram_banks * ROM_PRG_BANK_SIZE);
     }
 
@@ -266,8 +278,8 @@ bool nes_init(region_t region, int sample_rate, bool stereo)
     // nes_setregion(region);
 
     /* Framebuffers */
-    nes.framebuffers[0] = rg_alloc(NES_SCREEN_PITCH * NES_SCREEN_HEIGHT, MEM_FAST);
-    nes.framebuffers[1] = rg_alloc(NES_SCREEN_PITCH * NES_SCREEN_HEIGHT, MEM_FAST);
+    nes.framebuffers[0] = rg_alloc_tagged(NES_SCREEN_PITCH * NES_SCREEN_HEIGHT, MEM_FAST, "framebuffer");
+    nes.framebuffers[1] = rg_alloc_tagged(NES_SCREEN_PITCH * NES_SCREEN_HEIGHT, MEM_FAST, "framebuffer");
     if (NULL == nes.framebuffers[0] || NULL == nes.framebuffers[1])
         goto _fail;
 
@@ -99,6 +99,7 @@ typedef struct
     bool poweroff;
     bool pause;
     bool drawframe;
+    bool skipaudio;
 
 } nes_t;
 
@@ -75,6 +75,16 @@ INLINE uint8 PPU_MEM_READ(uint32 x)
 }
 #endif
 
+/* CHR-ROM mapped from flash faults on writes, real carts ignore them anyway */
+INLINE bool ppu_chr_readonly(uint32 addr)
+{
+   if (addr >= 0x2000)
+      return false;
+
+   uint8 *ptr = &ppu.page[addr >> 10][addr];
+   return ptr >= ppu.chr_readonly_start && ptr < ppu.chr_readonly_end;
+}
+
 void ppu_setcontext(ppu_t *src_ppu)
 {
    ASSERT(src_ppu);
@@ -318,7 +328,11 @@ IRAM_ATTR void ppu_write(uint32 address, uint8 value)
       if (ppu.vaddr < 0x3F00)
       {
          /* VRAM only accessible during scanlines 241-260 */
-         if ((ppu.bg_on || ppu.obj_on) && !ppu.vram_accessible)
+         if (ppu_chr_readonly(ppu.vaddr))
+         {
+            MESSAGE_DEBUG("CHR-ROM write to $%04X ignored\n", ppu.vaddr);
+         }
+         else if ((ppu.bg_on || ppu.obj_on) && !ppu.vram_accessible)
          {
             MESSAGE_DEBUG("VRAM write to $%04X, scanline %d\n",
                            ppu.vaddr, NES_CURRENT_SCANLINE);
@@ -139,6 +139,9 @@ typedef struct
    bool vram_accessible;
    bool vram_present;
 
+   /* CHR-ROM mapped from flash, writes to it would fault. Empty when it's in RAM */
+   uint8 *chr_readonly_start, *chr_readonly_end;
+
    /* Misc runtime options */
    int options[16];
 } ppu_t;
@@ -182,6 +182,25 @@ rom_t *rom_loadfile(const char *filename)
    if (!filename)
       return NULL;
 
+   /* The launcher staged the ROM to flash, we can use it in place. Disks are
+      written to so FDS images still get a copy in RAM. */
+   size_t mapped_size = 0;
+   const uint8 *mapped = rg_rom_map(filename, &mapped_size);
+
+   if (mapped && mapped_size <= 0x200000 && !memcmp(mapped, ROM_INES_MAGIC, 4)
+      && rom_loadmem((uint8 *)mapped, mapped_size))
+   {
+      MESSAGE_INFO("ROM: Using staged file '%s'\n", filename);
+      strncpy(rom.filename, filename, PATH_MAX);
+      rom.flags |= ROM_FLAG_MAPPED_DATA;
+      #ifdef USE_SRAM_FILE
+         rom_loadsram();
+      #endif
+      return &rom;
+   }
+
+   rg_rom_unmap();
+
    FILE *fp = fopen(filename, "rb");
    if (!fp)
    {
@@ -203,7 +222,7 @@ rom_t *rom_loadfile(const char *filename)
    {
       MESSAGE_ERROR("ROM: Memory allocation failed\n");
    }
-   else if (fread(data, size, 1, fp) != 1)
+   else if (rg_file_read(fp, data, size) != size)
    {
       MESSAGE_ERROR("ROM: Read error\n");
    }
@@ -238,6 +257,11 @@ void rom_free(void)
       free(rom.data_ptr);
       rom.data_ptr = NULL;
    }
+   if (rom.flags & ROM_FLAG_MAPPED_DATA)
+   {
+      rg_rom_unmap();
+      rom.data_ptr = NULL;
+   }
    free(rom.prg_ram);
    rom.prg_ram = NULL;
    free(rom.chr_ram);
@@ -70,31 +70,22 @@ void state_setslot(int slot)
    }
 }
 
-int state_save(const char* fn)
+int state_write(FILE *file)
 {
    uint8 buffer[512];
    uint8 numberOfBlocks = 0;
    nes_t *machine;
-   FILE *file;
    uint16 i, temp;
 
    /* get the pointer to our NES machine context */
    machine = nes_getptr();
 
-   if (!(file = fopen(fn, "wb")))
-   {
-       MESSAGE_ERROR("state_save: file '%s' could not be opened.\n", fn);
-       return -1; //goto _error;
-   }
-
-   MESSAGE_INFO("state_save: file '%s' opened.\n", fn);
-
    _fwrite("SNSS\x00\x00\x00\x05", 8);
 
 
    /****************************************************/
 
-   MESSAGE_INFO("  - Saving base block\n");
+   MESSAGE_DEBUG("  - Saving base block\n");
 
    // SnssBlockHeader
    _fwrite("BASR\x00\x00\x00\x01\x00\x00\x19\x31", 12);
@@ -140,7 +131,7 @@ int state_save(const char* fn)
 
    if (machine->cart->chr_ram_banks > 0)
    {
-      MESSAGE_INFO("  - Saving VRAM block\n");
+      MESSAGE_DEBUG("  - Saving VRAM block\n");
 
       // SnssBlockHeader
       _fwrite("VRAM\x00\x00\x00\x01\x00\x00\x20\x00", 12);
@@ -154,7 +145,7 @@ int state_save(const char* fn)
 
    if (machine->cart->prg_ram_banks > 0)
    {
-      MESSAGE_INFO("  - Saving SRAM block\n");
+      MESSAGE_DEBUG("  - Saving SRAM block\n");
 
       // Byte 13 = SRAM enabled (unused)
       // Length is always $2001
@@ -168,7 +159,7 @@ int state_save(const char* fn)
 
    /****************************************************/
 
-   MESSAGE_INFO("  - Saving sound block\n");
+   MESSAGE_DEBUG("  - Saving sound block\n");
 
    // SnssBlockHeader
    _fwrite("SOUN\x00\x00\x00\x01\x00\x00\x00\x16", 12);
@@ -201,7 +192,7 @@ int state_save(const char* fn)
 
    if (machine->mapper->number > 0)
    {
-      MESSAGE_INFO("  - Saving mapper block\n");
+      MESSAGE_DEBUG("  - Saving mapper block\n");
 
       // SnssBlockHeader
       _fwrite("MPRD\x00\x00\x00\x01\x00\x00\x00\x98", 12);
@@ -241,24 +232,18 @@ int state_save(const char* fn)
 
    // Update number of blocks
    fseek(file, 7, SEEK_SET);
-   fwrite(&numberOfBlocks, 1, 1, file);
-
-   fclose(file);
-
-   MESSAGE_INFO("state_save: Game %d saved!\n", save_slot);
+   _fwrite(&numberOfBlocks, 1);
 
    return 0;
 
 _error:
    MESSAGE_ERROR("state_save: Save failed!\n");
-   fclose(file);
    return -1;
 }
 
-int state_load(const char* fn)
+int state_read(FILE *file)
 {
    uint8 buffer[512];
-   FILE *file;
    nes_t *machine;
    int blk, i;
 
@@ -269,23 +254,17 @@ int state_load(const char* fn)
 
    machine = nes_getptr();
 
-   if (!(file = fopen(fn, "rb")))
-   {
-       MESSAGE_ERROR("state_load: file '%s' could not be opened.\n", fn);
-       return -1; //goto _error;
-  }
-
    _fread(buffer, 8);
 
    if (memcmp(buffer, "SNSS", 4) != 0)
    {
-      MESSAGE_ERROR("state_load: file '%s' is not a save file.\n", fn);
+      MESSAGE_ERROR("state_load: not a save file.\n");
       goto _error;
    }
 
    numberOfBlocks = swap32(*((uint32*)&buffer[4]));
 
-   MESSAGE_INFO("state_load: file '%s' opened, blocks=%d.\n", fn, numberOfBlocks);
+   MESSAGE_DEBUG("state_load: blocks=%d.\n", numberOfBlocks);
 
    for (blk = 0; blk < numberOfBlocks; blk++)
    {
@@ -303,7 +282,7 @@ int state_load(const char* fn)
 
       if (memcmp(buffer, "BASR", 4) == 0)
       {
-         MESSAGE_INFO("  - Found base block\n");
+         MESSAGE_DEBUG("  - Found base block\n");
 
          _fread(buffer, 9);
 
@@ -347,7 +326,7 @@ int state_load(const char* fn)
 
       else if (memcmp(buffer, "VRAM", 4) == 0)
       {
-         MESSAGE_INFO("  - Found VRAM block\n");
+         MESSAGE_DEBUG("  - Found VRAM block\n");
 
          if (machine->cart->chr_ram_banks < (blockLength / ROM_CHR_BANK_SIZE))
          {
@@ -363,7 +342,7 @@ int state_load(const char* fn)
 
       else if (memcmp(buffer, "SRAM", 4) == 0)
       {
-         MESSAGE_INFO("  - Found SRAM block\n");
+         MESSAGE_DEBUG("  - Found SRAM block\n");
 
          if (machine->cart->prg_ram_banks < ((blockLength-1) / ROM_PRG_BANK_SIZE))
          {
@@ -380,7 +359,7 @@ int state_load(const char* fn)
 
       else if (memcmp(buffer, "MPRD", 4) == 0)
       {
-         MESSAGE_INFO("  - Found mapper block\n");
+         MESSAGE_DEBUG("  - Found mapper block\n");
 
          _fread(buffer, blockLength);
 
@@ -407,7 +386,7 @@ int state_load(const char* fn)
 
       else if (memcmp(buffer, "SOUN", 4) == 0)
       {
-         MESSAGE_INFO("  - Found sound block\n");
+         MESSAGE_DEBUG("  - Found sound block\n");
 
          _fread(buffer, 0x16);
 
@@ -426,15 +405,56 @@ int state_load(const char* fn)
       }
    }
 
-   /* close file, we're done */
-   fclose(file);
-
-   MESSAGE_INFO("state_load: Game %d restored\n", save_slot);
-
    return 0;
 
 _error:
    MESSAGE_ERROR("state_load: Load failed!\n");
-   fclose(file);
    return -1;
 }
+
+int state_save(const char* fn)
+{
+   FILE *file;
+   int ret;
+
+   if (!(file = fopen(fn, "wb")))
+   {
+       MESSAGE_ERROR("state_save: file '%s' could not be opened.\n", fn);
+       return -1;
+   }
+
+   MESSAGE_INFO("state_save: file '%s' opened.\n", fn);
+
+   ret = state_write(file);
+
+   if (fclose(file) != 0)
+      ret = -1;
+
+   if (ret == 0)
+      MESSAGE_INFO("state_save: Game %d saved!\n", save_slot);
+
+   return ret;
+}
+
+int state_load(const char* fn)
+{
+   FILE *file;
+   int ret;
+
+   if (!(file = fopen(fn, "rb")))
+   {
+       MESSAGE_ERROR("state_load: file '%s' could not be opened.\n", fn);
+       return -1;
+   }
+
+   MESSAGE_INFO("state_load: file '%s' opened.\n", fn);
+
+   ret = state_read(file);
+
+   fclose(file);
+
+   if (ret == 0)
+      MESSAGE_INFO("state_load: Game %d restored\n", save_slot);
+
+   return ret;
+}
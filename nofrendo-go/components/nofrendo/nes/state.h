@@ -24,6 +24,8 @@
 #ifndef _NESSTATE_H_
 #define _NESSTATE_H_
 
+#include <stdio.h>
+
 typedef struct
 {
     uint8  type[4];
@@ -34,5 +36,7 @@ typedef struct
 extern void state_setslot(int slot);
 extern int state_load(const char *fn);
 extern int state_save(const char *fn);
+extern int state_read(FILE *file);
+extern int state_write(FILE *file);
 
 #endif /* _NESSTATE_H_ */
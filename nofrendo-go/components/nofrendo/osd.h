@@ -39,6 +39,7 @@ extern void osd_vsync(void);
 
 /* input */
 extern void osd_getinput(void);
+extern void osd_latchinput(void);
 
 /* Log output, printf-style format */
 extern void osd_log(int type, const char *format, ...);
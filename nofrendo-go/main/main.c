@@ -103,6 +103,26 @@ static bool load_state_handler(const char *filename)
     return true;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "wb");
+    bool success = fp && state_write(fp) == 0;
+    return rg_fmemclose(fp, size) && success;
+}
+
+static bool load_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "rb");
+    bool success = fp && state_read(fp) == 0;
+
+    if (!rg_fmemclose(fp, NULL) || !success)
+    {
+        nes_reset(true);
+        return false;
+    }
+    return true;
+}
+
 static bool reset_handler(bool hard)
 {
     nes_reset(hard);
@@ -263,11 +283,14 @@ void osd_vsync()
 
     long elapsed = get_elapsed_time_since(lastSyncTime);
 
-    if (skipFrames == 0)
+    if (app->speedupEnabled)
     {
-        if (app->speedupEnabled)
-            skipFrames = app->speedupEnabled * 2;
-        else if (elapsed >= frameTime) // Frame took too long
+        // Turbo: no rendering or audio synthesis, only present a frame now and then
+        skipFrames = rg_system_turbo_draw() ? 0 : 1;
+    }
+    else if (skipFrames == 0)
+    {
+        if (elapsed >= frameTime) // Frame took too long
             skipFrames = 1;
         else if (nes->drawframe && fullFrame) // This could be avoided when scaling != full
             skipFrames = 1;
@@ -281,6 +304,7 @@ void osd_vsync()
     rg_system_tick(!nes->drawframe, fullFrame, elapsed);
 
     nes->drawframe = (skipFrames == 0);
+    nes->skipaudio = (app->speedupEnabled != 0);
 
     // Use audio to throttle emulation
     if (!app->speedupEnabled)
@@ -323,11 +347,25 @@ void osd_blitscreen(uint8 *bmp)
     currentUpdate = previousUpdate;
 }
 
-void osd_getinput(void)
+static inline uint16 gamepad_to_nes(gamepad_state_t joystick)
 {
     uint16 input = 0;
 
-    *localJoystick = rg_input_read_gamepad();
+    if (joystick & GAMEPAD_KEY_START)  input |= INP_PAD_START;
+    if (joystick & GAMEPAD_KEY_SELECT) input |= INP_PAD_SELECT;
+    if (joystick & GAMEPAD_KEY_UP)     input |= INP_PAD_UP;
+    if (joystick & GAMEPAD_KEY_RIGHT)  input |= INP_PAD_RIGHT;
+    if (joystick & GAMEPAD_KEY_DOWN)   input |= INP_PAD_DOWN;
+    if (joystick & GAMEPAD_KEY_LEFT)   input |= INP_PAD_LEFT;
+    if (joystick & GAMEPAD_KEY_A)      input |= INP_PAD_A;
+    if (joystick & GAMEPAD_KEY_B)      input |= INP_PAD_B;
+
+    return input;
+}
+
+void osd_getinput(void)
+{
+    *localJoystick = rg_input_read_frame();
 
     if (*localJoystick & GAMEPAD_KEY_MENU)
     {
@@ -346,37 +384,34 @@ void osd_getinput(void)
     if (netplay)
     {
         rg_netplay_sync(localJoystick, remoteJoystick, sizeof(gamepad_state_t));
-        if (joystick2 & GAMEPAD_KEY_START)  input |= INP_PAD_START;
-        if (joystick2 & GAMEPAD_KEY_SELECT) input |= INP_PAD_SELECT;
-        if (joystick2 & GAMEPAD_KEY_UP)     input |= INP_PAD_UP;
-        if (joystick2 & GAMEPAD_KEY_RIGHT)  input |= INP_PAD_RIGHT;
-        if (joystick2 & GAMEPAD_KEY_DOWN)   input |= INP_PAD_DOWN;
-        if (joystick2 & GAMEPAD_KEY_LEFT)   input |= INP_PAD_LEFT;
-        if (joystick2 & GAMEPAD_KEY_A)      input |= INP_PAD_A;
-        if (joystick2 & GAMEPAD_KEY_B)      input |= INP_PAD_B;
-        input_update(INP_JOYPAD1, input);
-        input = 0;
+        input_update(INP_JOYPAD1, gamepad_to_nes(joystick2));
     }
 #endif
 
-    if (joystick1 & GAMEPAD_KEY_START)  input |= INP_PAD_START;
-    if (joystick1 & GAMEPAD_KEY_SELECT) input |= INP_PAD_SELECT;
-    if (joystick1 & GAMEPAD_KEY_UP)     input |= INP_PAD_UP;
-    if (joystick1 & GAMEPAD_KEY_RIGHT)  input |= INP_PAD_RIGHT;
-    if (joystick1 & GAMEPAD_KEY_DOWN)   input |= INP_PAD_DOWN;
-    if (joystick1 & GAMEPAD_KEY_LEFT)   input |= INP_PAD_LEFT;
-    if (joystick1 & GAMEPAD_KEY_A)      input |= INP_PAD_A;
-    if (joystick1 & GAMEPAD_KEY_B)      input |= INP_PAD_B;
-
-    input_update(INP_JOYPAD0, input);
+    input_update(INP_JOYPAD0, gamepad_to_nes(joystick1));
 }
 
+void osd_latchinput(void)
+{
+    if (!rg_input_get_late_latch())
+        return;
+
+#ifdef ENABLE_NETPLAY
+    // Both players must see the same input, so netplay only syncs once per frame
+    if (netplay)
+        return;
+#endif
+
+    input_update(INP_JOYPAD0, gamepad_to_nes(rg_input_latch_gamepad() & ~GAMEPAD_KEY_MENU));
+}
 
 void app_main(void)
 {
     rg_emu_proc_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .reset = &reset_handler,
         .netplay = &netplay_handler,
         .screenshot = &screenshot_handler,
@@ -403,6 +438,15 @@ void app_main(void)
         RG_PANIC("Unsupported ROM.");
     }
 
+    // PRG-RAM is mapped for direct writes, rg_sram finds the changes by scanning it
+    rom_t *cart = nes_getptr()->cart;
+    if ((cart->flags & ROM_FLAG_BATTERY) && cart->prg_ram_banks > 0)
+    {
+        char *sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, 0);
+        rg_sram_open(sramFile, cart->prg_ram, cart->prg_ram_banks * ROM_PRG_BANK_SIZE, true);
+        free(sramFile);
+    }
+
     nes_emulate();
 
     RG_PANIC("Nofrendo died!");
@@ -31,6 +31,7 @@ PROJECT_NAME = os.path.basename(PRJ_PATH).title()
 PROJECT_VER  = shell_exec("git describe --tags --abbrev=5 --dirty --always")
 PROJECT_TILE = "icon.raw"
 PROJECT_APPS = {} # TO DO: discover subprojects automatically
+PROJECT_DATA = {}
 
 if os.path.exists("config.py"):
     exec(read_file("config.py"))
@@ -123,6 +124,9 @@ def build_firmware(targets, shrink=False):
         part = PROJECT_APPS[target]
         size = 0 if shrink else part[1]
         args += [str(0), str(part[0]), str(size), target, os.path.join(target, "build", target + ".bin")]
+    # Data partitions go after the apps so that find_app's offsets still hold
+    for label, part in PROJECT_DATA.items():
+        args += [str(part[0]), str(part[1]), str(part[2]), label, os.devnull]
 
     commandline = ' '.join(shlex.quote(arg) for arg in args[1:]) # shlex.join()
     print("Building firmware: %s\n" % commandline)
@@ -147,6 +151,7 @@ def build_app(target, build_type=None, with_netplay=False):
     os.chdir(os.path.join(PRJ_PATH, target))
     os.putenv("ENABLE_PROFILING", "1" if build_type == "profile" else "0")
     os.putenv("ENABLE_NETPLAY", "1" if with_netplay else "0")
+    os.putenv("ENABLE_DEBUG_LOG", "1" if build_type == "debug" else "0")
     os.putenv("PROJECT_VER", PROJECT_VER)
     subprocess.run("idf.py app", shell=True, check=True)
 
@@ -381,7 +381,7 @@ int load_rom(const char *filename)
 
     if (!cart.rom || !cart.sram) abort();
 
-    count = fread(cart.rom, actual_size, 1, fd);
+    count = rg_file_read(fd, cart.rom, actual_size) == actual_size;
     fclose(fd);
   }
 
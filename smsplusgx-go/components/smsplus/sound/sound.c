@@ -187,7 +187,8 @@ void sound_update(int line)
   int16 *psg[2];
   // int16 *fm[2];
 
-  if(!snd.enabled)
+  /* The PSG is write-only, nothing to keep in sync when skipping */
+  if(!snd.enabled || snd.skip)
     return;
 
   /* Finish buffers at end of frame */
@@ -41,6 +41,7 @@ typedef struct
   int16 *stream[STREAM_MAX];
   int fm_which;
   int enabled;
+  int skip;     /* Don't generate samples (fast-forward) */
   int fps;
   int buffer_size;
   int sample_count;
@@ -100,6 +100,22 @@ static bool load_state_handler(const char *filename)
     return false;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "wb");
+    if (fp)
+        system_save_state(fp);
+    return rg_fmemclose(fp, size);
+}
+
+static bool load_state_mem_handler(void *buffer, size_t *size)
+{
+    FILE *fp = rg_fmemopen(buffer, *size, "rb");
+    if (fp)
+        system_load_state(fp);
+    return rg_fmemclose(fp, NULL);
+}
+
 static bool reset_handler(bool hard)
 {
     system_reset();
@@ -111,6 +127,8 @@ void app_main(void)
     rg_emu_proc_t handlers = {
         .loadState = &load_state_handler,
         .saveState = &save_state_handler,
+        .loadStateMem = &load_state_mem_handler,
+        .saveStateMem = &save_state_mem_handler,
         .netplay = &netplay_handler,
         .reset = &reset_handler,
         .screenshot = &screenshot_handler,
@@ -122,8 +140,8 @@ void app_main(void)
     frames[0].pixel_mask = PIXEL_MASK;
     frames[1] = frames[0];
 
-    frames[0].buffer = rg_alloc(SMS_WIDTH * SMS_HEIGHT, MEM_FAST);
-    frames[1].buffer = rg_alloc(SMS_WIDTH * SMS_HEIGHT, MEM_FAST);
+    frames[0].buffer = rg_alloc_tagged(SMS_WIDTH * SMS_HEIGHT, MEM_FAST, "framebuffer");
+    frames[1].buffer = rg_alloc_tagged(SMS_WIDTH * SMS_HEIGHT, MEM_FAST, "framebuffer");
 
     frames[0].palette = (uint16_t*)&palettes[0];
     frames[1].palette = (uint16_t*)&palettes[1];
@@ -161,6 +179,15 @@ void app_main(void)
     frames[0].buffer += bitmap.viewport.x;
     frames[1].buffer += bitmap.viewport.x;
 
+    // The cartridge RAM is mapped for direct writes, rg_sram finds the changes by scanning it.
+    // Nothing is written until a game actually uses it.
+    if (!IS_TMS)
+    {
+        char *sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, 0);
+        rg_sram_open(sramFile, cart.sram, 0x8000, true);
+        free(sramFile);
+    }
+
     if (app->startAction == RG_START_ACTION_RESUME)
     {
         rg_emu_load_state(0);
@@ -171,7 +198,7 @@ void app_main(void)
 
     while (true)
     {
-        *localJoystick = rg_input_read_gamepad();
+        *localJoystick = rg_input_read_frame();
 
         if (*localJoystick & GAMEPAD_KEY_MENU) {
             rg_gui_game_menu();
@@ -291,6 +318,8 @@ void app_main(void)
             }
         }
 
+        snd.skip = app->speedupEnabled;
+
         system_frame(!drawFrame);
 
         if (drawFrame)
@@ -310,11 +339,14 @@ void app_main(void)
         long elapsed = get_elapsed_time_since(startTime);
 
         // See if we need to skip a frame to keep up
-        if (skipFrames == 0)
+        if (app->speedupEnabled)
+        {
+            // Turbo: no rendering or audio synthesis, only present a frame now and then
+            skipFrames = rg_system_turbo_draw() ? 0 : 1;
+        }
+        else if (skipFrames == 0)
         {
-            if (app->speedupEnabled)
-                skipFrames = app->speedupEnabled * 2.5;
-            else if (elapsed >= frameTime) // Frame took too long
+            if (elapsed >= frameTime) // Frame took too long
                 skipFrames = 1;
             else if (drawFrame && fullFrame) // This could be avoided when scaling != full
                 skipFrames = 1;
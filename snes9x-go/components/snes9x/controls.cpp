@@ -399,6 +399,7 @@ void S9xSetJoypadLatch (bool latch)
 {
 	if (latch && !FLAG_LATCH)
 	{
+		S9xOnJoypadLatch();
 		joypads[0].read_idx = 0;
 		joypads[1].read_idx = 0;
 	}
@@ -53,4 +53,9 @@ void S9xSetJoypadLatch (bool latch);
 
 uint8 S9xReadJOYSERn (int n);
 
+// Implemented by the port. Called right before the joypads are latched (manually or by auto-read),
+// the port may call S9xReportButton to provide fresher input than the per-frame poll.
+
+void S9xOnJoypadLatch (void);
+
 #endif
@@ -1539,12 +1539,12 @@ bool8 S9xGraphicsInit (void)
 
 	S9xInitTileRenderer();
 
-	GFX.SubScreen  = (uint16 *) rg_alloc(GFX.ScreenSize * 2, MEM_SLOW);
-	GFX.ZBuffer    = (uint8 *)  rg_alloc(GFX.ScreenSize, MEM_FAST);
-	GFX.SubZBuffer = (uint8 *)  rg_alloc(GFX.ScreenSize, MEM_FAST);
+	GFX.SubScreen  = (uint16 *) rg_alloc_tagged(GFX.ScreenSize * 2, MEM_SLOW, "GFX.SubScreen");
+	GFX.ZBuffer    = (uint8 *)  rg_alloc_tagged(GFX.ScreenSize, MEM_FAST, "GFX.ZBuffer");
+	GFX.SubZBuffer = (uint8 *)  rg_alloc_tagged(GFX.ScreenSize, MEM_FAST, "GFX.SubZBuffer");
 	GFX.ZERO       = (uint16 *) GFX.SubScreen; // This will cause garbage but for now it's okay
 	// GFX.ZERO = (uint16 *) malloc(0x10000, sizeof(uint16));
-	IPPU.TileCacheData = (uint8 *) rg_alloc(4096 * 64, MEM_SLOW);
+	IPPU.TileCacheData = (uint8 *) rg_alloc_tagged(4096 * 64, MEM_SLOW, "IPPU.TileCacheData");
 
 	if (!GFX.SubScreen || !GFX.ZBuffer || !GFX.SubZBuffer || !IPPU.TileCacheData)
 	{
@@ -13,6 +13,10 @@
 CMemory		Memory;
 uint32		OpenBus = 0;
 
+// Base and length of the staged ROM mapping, Memory.ROM points into it. NULL when the ROM is in RAM.
+static uint8	*ROMMapped = NULL;
+static uint32	ROMMappedSpan = 0;
+
 #define match_nn(str) (strncmp(Memory.ROMName, (str), strlen((str))) == 0)
 extern uint32 crc32_le(uint32 crc, uint8 const * buf, uint32 len);
 
@@ -470,12 +474,28 @@ static bool8 InitROM ()
 	if ((Memory.ROM_SIZE & 0x7FF) == 512 || First512BytesCountZeroes() > 400)
 	{
 		printf("Found ROM file header (and ignored it).\n");
-		memmove(Memory.ROM, Memory.ROM + 512, Memory.ROM_SIZE - 512);
+		if (ROMMapped)
+			Memory.ROM += 512;
+		else
+			memmove(Memory.ROM, Memory.ROM + 512, Memory.ROM_SIZE - 512);
 		Memory.ROM_SIZE -= 512;
 	}
 
 	Memory.CalculatedSize = ((Memory.ROM_SIZE + 0x1fff) / 0x2000) * 0x2000;
 
+	// The checksums and mirrors read up to CalculatedSize, past the end of the mapping is a fault
+	if (ROMMapped && Memory.ROM + Memory.CalculatedSize > ROMMapped + ROMMappedSpan)
+	{
+		printf("Staged ROM mapping is too short, copying it to RAM.\n");
+		uint8 *copy = (uint8 *) calloc(1, Memory.CalculatedSize);
+		if (!copy)
+			return (FALSE);
+		memcpy(copy, Memory.ROM, Memory.ROM_SIZE);
+		rg_rom_unmap();
+		ROMMapped = NULL;
+		Memory.ROM = copy;
+	}
+
 	//// these two games fail to be detected
 	if (strncmp((char *) &Memory.ROM[0x7fc0], "YUYU NO QUIZ DE GO!GO!", 22) == 0 ||
 		(strncmp((char *) &Memory.ROM[0xffc0], "BATMAN--REVENGE JOKER",  21) == 0))
@@ -640,7 +660,12 @@ void S9xMemoryDeinit (void)
 	free(Memory.RAM);
 	free(Memory.SRAM);
 	free(Memory.VRAM);
-	free(Memory.ROM);
+
+	if (ROMMapped)
+		rg_rom_unmap();
+	else
+		free(Memory.ROM);
+	ROMMapped = NULL;
 
 	Memory.RAM = NULL;
 	Memory.SRAM = NULL;
@@ -650,6 +675,27 @@ void S9xMemoryDeinit (void)
 
 bool8 S9xLoadROM (const char *filename)
 {
+	size_t mapped_size = 0;
+	uint8 *mapped = (uint8 *) rg_rom_map(filename, &mapped_size);
+
+	// The launcher staged the ROM to flash, we read it in place and the buffer isn't needed
+	if (mapped && mapped_size <= ROM_MAX_SIZE)
+	{
+		free(Memory.ROM);
+		Memory.ROM = ROMMapped = mapped;
+		Memory.ROM_SIZE = mapped_size;
+		ROMMappedSpan = (mapped_size + 0xFFFF) & ~0xFFFF;
+		return InitROM();
+	}
+
+	// The usual reason is a ROM larger than what is left of the flash cache's data window
+	if (mapped)
+		printf("Staged ROM is larger than %d bytes, loading it to RAM instead.\n", ROM_MAX_SIZE);
+	else if (rg_rom_get_staging())
+		printf("ROM staging is enabled but the ROM couldn't be mapped, loading it to RAM instead.\n");
+
+	rg_rom_unmap();
+
 	FILE *stream = fopen(filename, "rb");
 	if (!stream)
 		return (FALSE);
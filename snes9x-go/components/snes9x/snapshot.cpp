@@ -570,6 +570,19 @@ int S9xFreezeGame (const char *filename)
 		return (FILE_NOT_FOUND);
 	}
 
+	S9xFreezeToStream(stream);
+
+	if (fclose(stream) != 0)
+		return (FILE_NOT_FOUND);
+
+	sprintf(String, SAVE_INFO_SNAPSHOT " %s", S9xBasename(filename));
+	S9xMessage(S9X_INFO, S9X_FREEZE_FILE_INFO, String);
+
+	return (SUCCESS);
+}
+
+void S9xFreezeToStream (FILE *stream)
+{
 	// We don't have enough RAM to fit the sound snapshot at the moment
 	// So we're naughty and used the tile cache data which is about 256K.
 	uint8 *soundsnapshot = (uint8 *)IPPU.TileCacheData; // new uint8[SPC_SAVE_STATE_BLOCK_SIZE];
@@ -610,13 +623,6 @@ int S9xFreezeGame (const char *filename)
 
 	if (Settings.DSP == 2)
 		FreezeStruct(stream, "DP2", &DSP2, SnapDSP2, COUNT(SnapDSP2));
-
-	fclose(stream);
-
-	sprintf(String, SAVE_INFO_SNAPSHOT " %s", S9xBasename(filename));
-	S9xMessage(S9X_INFO, S9X_FREEZE_FILE_INFO, String);
-
-	return (SUCCESS);
 }
 
 // QuickLoad
@@ -632,6 +638,40 @@ int S9xUnfreezeGame (const char *filename)
 		return (FILE_NOT_FOUND);
 	}
 
+	int result = S9xUnfreezeFromStream(stream);
+
+	fclose(stream);
+
+	if (result != SUCCESS)
+	{
+		switch (result)
+		{
+			case WRONG_FORMAT:
+				S9xMessage(S9X_ERROR, S9X_WRONG_FORMAT, SAVE_ERR_WRONG_FORMAT);
+				break;
+
+			case WRONG_VERSION:
+				S9xMessage(S9X_ERROR, S9X_WRONG_VERSION, SAVE_ERR_WRONG_VERSION);
+				break;
+
+			case FILE_NOT_FOUND:
+			default:
+				sprintf(String, SAVE_ERR_ROM_NOT_FOUND, S9xBasename(filename));
+				S9xMessage(S9X_ERROR, S9X_ROM_NOT_FOUND, String);
+				break;
+		}
+
+		return (FALSE);
+	}
+
+	sprintf(String, SAVE_INFO_LOAD " %s", S9xBasename(filename));
+	S9xMessage(S9X_INFO, S9X_FREEZE_FILE_INFO, String);
+
+	return (SUCCESS);
+}
+
+int S9xUnfreezeFromStream (FILE *stream)
+{
 	int		result = SUCCESS;
 	int		version, len;
 	char	buffer[PATH_MAX + 1];
@@ -739,34 +779,7 @@ int S9xUnfreezeGame (const char *filename)
 		S9xGraphicsScreenResize();
 	}
 
-	fclose(stream);
-
-	if (result != SUCCESS)
-	{
-		switch (result)
-		{
-			case WRONG_FORMAT:
-				S9xMessage(S9X_ERROR, S9X_WRONG_FORMAT, SAVE_ERR_WRONG_FORMAT);
-				break;
-
-			case WRONG_VERSION:
-				S9xMessage(S9X_ERROR, S9X_WRONG_VERSION, SAVE_ERR_WRONG_VERSION);
-				break;
-
-			case FILE_NOT_FOUND:
-			default:
-				sprintf(String, SAVE_ERR_ROM_NOT_FOUND, S9xBasename(filename));
-				S9xMessage(S9X_ERROR, S9X_ROM_NOT_FOUND, String);
-				break;
-		}
-
-		return (FALSE);
-	}
-
-	sprintf(String, SAVE_INFO_LOAD " %s", S9xBasename(filename));
-	S9xMessage(S9X_INFO, S9X_FREEZE_FILE_INFO, String);
-
-	return (SUCCESS);
+	return (result);
 }
 
 static int FreezeSize (int size, int type)
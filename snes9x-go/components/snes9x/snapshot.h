@@ -19,5 +19,7 @@ enum
 
 int S9xFreezeGame (const char *);
 int S9xUnfreezeGame (const char *);
+void S9xFreezeToStream (FILE *);
+int S9xUnfreezeFromStream (FILE *);
 
 #endif
@@ -80,6 +80,23 @@ void S9xExit(void)
 	exit(0);
 }
 
+static inline void report_buttons(uint32_t joystick, bool menuPressed)
+{
+	for (int i = 0; i < keymap.size; i++)
+	{
+		S9xReportButton(i, (joystick & (keymap.keys[i].key_id)) && keymap.keys[i].mod1 == menuPressed);
+	}
+}
+
+void S9xOnJoypadLatch(void)
+{
+	if (rg_input_get_late_latch())
+	{
+		uint32_t joystick = rg_input_latch_gamepad();
+		report_buttons(joystick, joystick & GAMEPAD_KEY_MENU);
+	}
+}
+
 static void update_keymap(int id)
 {
 	keymap_id = id % KEYMAPS_COUNT;
@@ -174,6 +191,21 @@ static bool load_state_handler(const char *filename)
 	return ret;
 }
 
+static bool save_state_mem_handler(void *buffer, size_t *size)
+{
+	FILE *fp = rg_fmemopen(buffer, *size, "wb");
+	if (fp)
+		S9xFreezeToStream(fp);
+	return rg_fmemclose(fp, size);
+}
+
+static bool load_state_mem_handler(void *buffer, size_t *size)
+{
+	FILE *fp = rg_fmemopen(buffer, *size, "rb");
+	bool ret = fp && S9xUnfreezeFromStream(fp) == SUCCESS;
+	return rg_fmemclose(fp, NULL) && ret;
+}
+
 static bool reset_handler(bool hard)
 {
 	if (hard)
@@ -229,7 +261,7 @@ static void snes9x_task(void *arg)
 
 	while (1)
 	{
-		uint32_t joystick = rg_input_read_gamepad();
+		uint32_t joystick = rg_input_read_frame();
 
 		if (menuPressed && !(joystick & GAMEPAD_KEY_MENU))
 		{
@@ -257,10 +289,7 @@ static void snes9x_task(void *arg)
 			menuCancelled = true;
 		}
 
-		for (int i = 0; i < keymap.size; i++)
-		{
-			S9xReportButton(i, (joystick & (keymap.keys[i].key_id)) && keymap.keys[i].mod1 == menuPressed);
-		}
+		report_buttons(joystick, menuPressed);
 
 		S9xMainLoop();
 
@@ -275,7 +304,11 @@ static void snes9x_task(void *arg)
 
 		rg_system_tick(IPPU.RenderThisFrame, fullFrame, elapsed);
 
-		IPPU.RenderThisFrame = (((++frames_counter) & 3) == 3);
+		// Turbo: only present a frame now and then (there is no audio to skip yet)
+		if (app->speedupEnabled)
+			IPPU.RenderThisFrame = rg_system_turbo_draw();
+		else
+			IPPU.RenderThisFrame = (((++frames_counter) & 3) == 3);
 		GFX.Screen = (uint16*)currentUpdate->buffer;
 	}
 
@@ -287,6 +320,8 @@ extern "C" void app_main(void)
 	rg_emu_proc_t handlers = {
 		.loadState = &load_state_handler,
 		.saveState = &save_state_handler,
+		.loadStateMem = &load_state_mem_handler,
+		.saveStateMem = &save_state_mem_handler,
 		.reset = &reset_handler,
 		.netplay = NULL,
 		.screenshot = &screenshot_handler,
@@ -300,8 +335,8 @@ extern "C" void app_main(void)
 	frames[0].stride = SNES_WIDTH * 2;
 	frames[1] = frames[0];
 
-	frames[0].buffer = rg_alloc(SNES_WIDTH * SNES_HEIGHT_EXTENDED * 2, MEM_SLOW);
-	frames[1].buffer = rg_alloc(SNES_WIDTH * SNES_HEIGHT_EXTENDED * 2, MEM_SLOW);
+	frames[0].buffer = rg_alloc_tagged(SNES_WIDTH * SNES_HEIGHT_EXTENDED * 2, MEM_SLOW, "framebuffer");
+	frames[1].buffer = rg_alloc_tagged(SNES_WIDTH * SNES_HEIGHT_EXTENDED * 2, MEM_SLOW, "framebuffer");
 
 	snes9x_task(NULL);
 }